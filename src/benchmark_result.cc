@@ -0,0 +1,260 @@
+/*
+ * 技巧 (Gikou), a USI shogi (Japanese chess) playing engine.
+ * Copyright (C) 2016-2017 Yosuke Demura
+ * except where otherwise indicated.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "benchmark_result.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <fstream>
+#include <numeric>
+
+namespace {
+
+/**
+ * 自由度dfのt分布の、両側5%点を返します.
+ * 自由度が整数でない場合は、切り捨てた自由度の値を用います（保守的な判定になる）。
+ */
+double StudentTCriticalValue(double df) {
+  static const double kTable[] = {
+      12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+      2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+      2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+  };
+  const int n = static_cast<int>(std::floor(df));
+  if (n < 1) {
+    return kTable[0];
+  } else if (n <= 30) {
+    return kTable[n - 1];
+  } else if (n <= 60) {
+    return 2.000;
+  } else if (n <= 120) {
+    return 1.980;
+  } else {
+    return 1.960;
+  }
+}
+
+/**
+ * JSONの１行から、"key": "value" 形式の文字列値を取り出します.
+ */
+bool ExtractString(const std::string& line, const std::string& key,
+                   std::string* value) {
+  const std::string pattern = "\"" + key + "\": \"";
+  size_t begin = line.find(pattern);
+  if (begin == std::string::npos) {
+    return false;
+  }
+  begin += pattern.size();
+  size_t end = line.find('"', begin);
+  if (end == std::string::npos) {
+    return false;
+  }
+  *value = line.substr(begin, end - begin);
+  return true;
+}
+
+/**
+ * JSONの１行から、"key": [1.0, 2.0, ...] 形式の数値の配列を取り出します.
+ */
+bool ExtractNumbers(const std::string& line, const std::string& key,
+                    std::vector<double>* values) {
+  const std::string pattern = "\"" + key + "\": [";
+  size_t begin = line.find(pattern);
+  if (begin == std::string::npos) {
+    return false;
+  }
+  const char* p = line.c_str() + begin + pattern.size();
+  while (*p != ']' && *p != '\0') {
+    char* end;
+    double value = std::strtod(p, &end);
+    if (end == p) {
+      break;
+    }
+    values->push_back(value);
+    p = end;
+    while (*p == ',' || *p == ' ') {
+      ++p;
+    }
+  }
+  return *p == ']';
+}
+
+} // namespace
+
+double BenchmarkResult::Metric::Mean() const {
+  if (samples.empty()) {
+    return 0.0;
+  }
+  return std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+}
+
+double BenchmarkResult::Metric::StandardDeviation() const {
+  if (samples.size() <= 1) {
+    return 0.0;
+  }
+  const double mean = Mean();
+  double sum = 0.0;
+  for (double x : samples) {
+    sum += (x - mean) * (x - mean);
+  }
+  return std::sqrt(sum / (samples.size() - 1));
+}
+
+double BenchmarkResult::Metric::ConfidenceInterval() const {
+  if (samples.size() <= 1) {
+    return 0.0;
+  }
+  const double n = static_cast<double>(samples.size());
+  return StudentTCriticalValue(n - 1.0) * StandardDeviation() / std::sqrt(n);
+}
+
+void BenchmarkResult::AddSample(const std::string& name,
+                                const std::string& unit,
+                                bool higher_is_better, double value) {
+  auto it = std::find_if(metrics_.begin(), metrics_.end(), [&](const Metric& m) {
+    return m.name == name;
+  });
+  if (it == metrics_.end()) {
+    metrics_.push_back(Metric{name, unit, higher_is_better, {}});
+    it = metrics_.end() - 1;
+  }
+  it->samples.push_back(value);
+}
+
+void BenchmarkResult::PrintSummary() const {
+  std::printf("Summary:\n");
+  for (const Metric& m : metrics_) {
+    std::printf("  %-32s %14.2f +- %-12.2f %-6s (n=%d, sd=%.2f)\n",
+                m.name.c_str(), m.Mean(), m.ConfidenceInterval(),
+                m.unit.c_str(), static_cast<int>(m.samples.size()),
+                m.StandardDeviation());
+  }
+}
+
+bool BenchmarkResult::WriteToFile(const char* file_name) const {
+  std::FILE* file = std::fopen(file_name, "w");
+  if (file == nullptr) {
+    return false;
+  }
+  std::fprintf(file, "{\n");
+  std::fprintf(file, "  \"command\": \"%s\",\n", command_.c_str());
+  std::fprintf(file, "  \"metrics\": [\n");
+  for (size_t i = 0; i < metrics_.size(); ++i) {
+    const Metric& m = metrics_[i];
+    std::fprintf(file, "    {\"name\": \"%s\", \"unit\": \"%s\", "
+                 "\"higher_is_better\": %s, \"samples\": [",
+                 m.name.c_str(), m.unit.c_str(),
+                 m.higher_is_better ? "true" : "false");
+    for (size_t j = 0; j < m.samples.size(); ++j) {
+      std::fprintf(file, "%s%.6g", j == 0 ? "" : ", ", m.samples[j]);
+    }
+    std::fprintf(file, "]}%s\n", i + 1 < metrics_.size() ? "," : "");
+  }
+  std::fprintf(file, "  ]\n");
+  std::fprintf(file, "}\n");
+  std::fclose(file);
+  return true;
+}
+
+bool BenchmarkResult::ReadFromFile(const char* file_name) {
+  std::ifstream ifs(file_name);
+  if (!ifs) {
+    return false;
+  }
+  command_.clear();
+  metrics_.clear();
+  for (std::string line; std::getline(ifs, line);) {
+    Metric m;
+    if (ExtractString(line, "name", &m.name)) {
+      if (   !ExtractString(line, "unit", &m.unit)
+          || !ExtractNumbers(line, "samples", &m.samples)) {
+        return false;
+      }
+      m.higher_is_better = line.find("\"higher_is_better\": true") != std::string::npos;
+      metrics_.push_back(m);
+    } else {
+      ExtractString(line, "command", &command_);
+    }
+  }
+  return true;
+}
+
+int BenchmarkResult::Compare(const BenchmarkResult& baseline,
+                             const BenchmarkResult& candidate,
+                             double tolerance) {
+  int num_regressions = 0;
+
+  std::printf("%-32s %14s %14s %9s %s\n", "metric", "baseline", "candidate",
+              "better by", "verdict");
+  for (const Metric& b : candidate.metrics_) {
+    auto it = std::find_if(baseline.metrics_.begin(), baseline.metrics_.end(),
+                           [&](const Metric& m) { return m.name == b.name; });
+    if (it == baseline.metrics_.end()) {
+      std::printf("%-32s %14s %14.2f %9s %s\n", b.name.c_str(), "-", b.Mean(),
+                  "-", "(not in baseline)");
+      continue;
+    }
+    const Metric& a = *it;
+
+    // 変化率を求める（正ならば改善、負ならば悪化）
+    const double mean_a = a.Mean(), mean_b = b.Mean();
+    double change = mean_a != 0.0 ? (mean_b - mean_a) / std::abs(mean_a) : 0.0;
+    if (!b.higher_is_better) {
+      change = -change;
+    }
+
+    // Welchのt検定を行う
+    const char* verdict;
+    const double na = a.samples.size(), nb = b.samples.size();
+    if (na < 2 || nb < 2) {
+      verdict = "insufficient trials";
+    } else {
+      const double va = a.StandardDeviation() * a.StandardDeviation() / na;
+      const double vb = b.StandardDeviation() * b.StandardDeviation() / nb;
+      const double se = std::sqrt(va + vb);
+      bool significant;
+      if (se == 0.0) {
+        significant = mean_a != mean_b;
+      } else {
+        const double t = std::abs(mean_b - mean_a) / se;
+        const double df = (va + vb) * (va + vb)
+                        / (va * va / (na - 1) + vb * vb / (nb - 1));
+        significant = t > StudentTCriticalValue(df);
+      }
+      if (!significant) {
+        verdict = "no significant change";
+      } else if (change >= 0.0) {
+        verdict = "improvement";
+      } else if (-change <= tolerance) {
+        verdict = "slower (within tolerance)";
+      } else {
+        verdict = "REGRESSION";
+        ++num_regressions;
+      }
+    }
+
+    std::printf("%-32s %14.2f %14.2f %+8.2f%% %s\n", b.name.c_str(), mean_a,
+                mean_b, 100.0 * change, verdict);
+  }
+
+  std::printf("%d regression(s) found.\n", num_regressions);
+  return num_regressions;
+}
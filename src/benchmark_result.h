@@ -0,0 +1,116 @@
+/*
+ * 技巧 (Gikou), a USI shogi (Japanese chess) playing engine.
+ * Copyright (C) 2016-2017 Yosuke Demura
+ * except where otherwise indicated.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BENCHMARK_RESULT_H_
+#define BENCHMARK_RESULT_H_
+
+#include <string>
+#include <vector>
+
+/**
+ * ベンチマークの結果を、複数回の試行にわたって記録・集計するためのクラスです.
+ *
+ * 結果はJSONファイルに保存でき、保存した２つの結果を比較して、統計的に有意な性能低下（リグレッション）が
+ * あるかどうかを判定できます。
+ *
+ * JSONファイルの形式（１行に１つの計測項目）：
+ * @code
+ * {
+ *   "command": "--bench-movegen",
+ *   "metrics": [
+ *     {"name": "movegen startpos", "unit": "ns/op", "higher_is_better": false, "samples": [101.2, 99.8]}
+ *   ]
+ * }
+ * @endcode
+ */
+class BenchmarkResult {
+ public:
+  /**
+   * 計測項目です.
+   */
+  struct Metric {
+    /** 計測項目の名前（例："movegen startpos"） */
+    std::string name;
+
+    /** 単位（例："ns/op", "nps"） */
+    std::string unit;
+
+    /** 値が大きいほど良い場合はtrue（NPSなど）、小さいほど良い場合はfalse（実行時間など） */
+    bool higher_is_better;
+
+    /** 各試行で得られた値 */
+    std::vector<double> samples;
+
+    double Mean() const;
+
+    /** 標本標準偏差（試行が１回のみの場合は、0） */
+    double StandardDeviation() const;
+
+    /** 平均値の95%信頼区間の半幅（t分布を用いる。試行が１回のみの場合は、0） */
+    double ConfidenceInterval() const;
+  };
+
+  explicit BenchmarkResult(const std::string& command = "")
+      : command_(command) {
+  }
+
+  /**
+   * 計測値を１つ追加します.
+   * 同じ名前の計測項目が既にある場合は、その計測項目の試行結果として追加されます。
+   */
+  void AddSample(const std::string& name, const std::string& unit,
+                 bool higher_is_better, double value);
+
+  /**
+   * 計測項目ごとに、平均値と95%信頼区間を表示します.
+   */
+  void PrintSummary() const;
+
+  /**
+   * 結果をJSONファイルに書き出します.
+   * @return 書き出しに成功した場合は、true
+   */
+  bool WriteToFile(const char* file_name) const;
+
+  /**
+   * WriteToFile()で書き出したJSONファイルから、結果を読み込みます.
+   * @return 読み込みに成功した場合は、true
+   */
+  bool ReadFromFile(const char* file_name);
+
+  /**
+   * ２つのベンチマーク結果を比較し、計測項目ごとに、Welchのt検定（有意水準5%）による判定結果を表示します.
+   * @param baseline  比較の基準となる結果（例：前回のリリース）
+   * @param candidate 比較対象の結果（例：今回のビルド）
+   * @param tolerance 許容する性能低下の割合（例：0.01ならば1%）。これ以下の低下はリグレッションとみなさない。
+   * @return 統計的に有意なリグレッションが見つかった計測項目の数
+   */
+  static int Compare(const BenchmarkResult& baseline,
+                     const BenchmarkResult& candidate, double tolerance);
+
+  const std::vector<Metric>& metrics() const {
+    return metrics_;
+  }
+
+ private:
+  std::string command_;
+  std::vector<Metric> metrics_;
+};
+
+#endif /* BENCHMARK_RESULT_H_ */
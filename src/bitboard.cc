@@ -21,6 +21,7 @@
 
 #include <vector>
 #include "common/array.h"
+#include "large_page.h"
 
 namespace {
 
@@ -306,6 +307,11 @@ void Bitboard::Init() {
       }
 
   // 6. マジックナンバー
+  // 利きのテーブル（特に飛車）は大きいので、書き込む前にラージページを要求しておく
+  LargePageAllocator::Advise(bishop_attacks_bb_.begin(), sizeof(bishop_attacks_bb_),
+                             "Bitboard::bishop_attacks_bb_");
+  LargePageAllocator::Advise(rook_attacks_bb_.begin(), sizeof(rook_attacks_bb_),
+                             "Bitboard::rook_attacks_bb_");
   Bitboard* bishop_ptr = bishop_attacks_bb_.begin();
   Bitboard* rook_ptr   = rook_attacks_bb_.begin();
   for (Square sq : Square::all_squares()) {
@@ -20,12 +20,15 @@
 #include "book.h"
 
 #include <cstdio>
+#include <cstdlib>
 #include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <memory>
+#include <queue>
 #include <random>
 #include <vector>
 #include <unordered_map>
@@ -40,9 +43,6 @@
 
 namespace {
 
-// 初手から何手目までを定跡として登録するか
-const int kMaxBookPly = 50; // 初手から最大50手まで定跡として登録する
-
 // 急戦定跡を除外するか
 const int kRemoveQuickAttackOpening = false;
 
@@ -96,6 +96,45 @@ const std::unordered_map<std::string, std::string> g_opening_strategy_aliases{
   {"ダイレクト向かい飛車", "向飛車"},
 };
 
+// 圧縮形式の定跡ファイルの先頭に置く識別子
+const char kCompressedBookMagic[8] = {'G', 'K', 'B', 'O', 'O', 'K', 'C', '1'};
+
+/**
+ * 可変長整数（下位から７ビットずつ、続きがあれば最上位ビットを立てる形式）を書き込みます.
+ */
+inline void WriteVarint(uint64_t value, std::vector<uint8_t>* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<uint8_t>(value));
+}
+
+/**
+ * 可変長整数を読み込み、読み込んだ分だけポインタを進めます.
+ */
+inline uint64_t ReadVarint(const uint8_t** p) {
+  uint64_t value = 0;
+  for (int shift = 0; ; shift += 7) {
+    uint8_t byte = *(*p)++;
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return value;
+    }
+  }
+}
+
+/**
+ * 符号付き整数を、絶対値が小さいほど短い可変長整数になるように変換します（ZigZag符号化）.
+ */
+inline uint64_t ZigZagEncode(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t ZigZagDecode(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
 } // namespace
 
 // 戦型の日本語名
@@ -219,17 +258,33 @@ Key64 Book::ComputeKey(const Position& original_pos) const {
   return key;
 }
 
-BookMoves Book::Probe(const Position& pos) const {
+std::vector<Book::Entry> Book::FindEntries(const Position& pos) const {
   assert(std::is_sorted(entries_.begin(), entries_.end()));
 
-  // 1. 与えられた局面の定跡手を探す
+  // 定跡データベースの定跡手は、すべて先手番の手として登録されているので、先手番に揃えてから探す
+  Position black_pos = pos;
+  if (black_pos.side_to_move() == kWhite) {
+    black_pos.Flip();
+  }
   Entry key;
-  key.key = ComputeKey(pos);
+  key.key = ComputeKey(black_pos);
+
+  // 圧縮形式の定跡を読み込んでいる場合は、該当するブロックだけを復号する
+  if (!compressed_entries_.empty()) {
+    return compressed_entries_.Find(key.key, black_pos);
+  }
+
   auto range = std::equal_range(entries_.begin(), entries_.end(), key);
+  return std::vector<Entry>(range.first, range.second);
+}
+
+BookMoves Book::Probe(const Position& pos) const {
+  // 1. 与えられた局面の定跡手を探す
+  const std::vector<Entry> entries = FindEntries(pos);
 
   // 2. 定跡手をBookMovesクラスに登録していく
   BookMoves book_moves;
-  for (auto it = range.first; it != range.second; ++it) {
+  for (auto it = entries.begin(); it != entries.end(); ++it) {
     BookMove bm;
     bm.move      = it->move;
     bm.frequency = it->frequency;
@@ -394,6 +449,40 @@ Move Book::GetOneBookMove(const Position& pos, const UsiOptions& usi_options) co
   return book_move;
 }
 
+bool Book::ProbeBestScoredMove(const Position& pos, Move* const move,
+                               Score* const score) const {
+  assert(move != nullptr && score != nullptr);
+
+  // 定跡が読み込まれていなければ、局面のハッシュ値を計算するまでもない
+  if (entries_.empty() && compressed_entries_.empty()) {
+    return false;
+  }
+
+  bool found = false;
+  for (const Entry& entry : FindEntries(pos)) {
+    // 探索によって評価値が付けられていない手は使わない
+    if (entry.score == kScoreNone) {
+      continue;
+    }
+
+    // 後手番の局面の場合は、指し手及びその評価値を反転させる
+    Move book_move = entry.move;
+    Score book_score = entry.score;
+    if (pos.side_to_move() == kWhite) {
+      book_move.Flip();
+      book_score = -book_score;
+    }
+
+    if ((!found || book_score > *score) && pos.MoveIsLegal(book_move)) {
+      *move = book_move;
+      *score = book_score;
+      found = true;
+    }
+  }
+
+  return found;
+}
+
 OpeningStrategySet Book::DetermineOpeningStrategy(const Position& pos) const {
   BookMoves bookmoves = Probe(pos);
   OpeningStrategySet opening_strategies;
@@ -411,23 +500,91 @@ void Book::ReadFromFile(const char* file_name) {
     return;
   }
 
-  // 2. ハッシュ関数のシードを読み込む
+  // 2. 圧縮形式のファイルであるかを調べる
+  char magic[sizeof(kCompressedBookMagic)];
+  bool compressed = std::fread(magic, sizeof(magic), 1, file) == 1
+                 && std::equal(magic, magic + sizeof(magic), kCompressedBookMagic);
+  if (!compressed) {
+    std::rewind(file);
+  }
+  entries_.clear();
+  compressed_entries_ = CompressedEntries();
+
+  // 3. ハッシュ関数のシードを読み込む
   if (std::fread(&hash_seeds_, sizeof(hash_seeds_), 1, file) < 1) {
     std::printf("info string Failed to read the hash seeds of the book.\n");
     std::fclose(file);
     return;
   }
 
-  // 3. 定跡手のエントリを読み込む
-  entries_.clear();
-  for (Entry buf; std::fread(&buf, sizeof(buf), 1, file);) {
-    entries_.push_back(buf);
+  // 4. 定跡手のエントリを読み込む
+  if (compressed) {
+    if (!compressed_entries_.Read(file)) {
+      std::printf("info string Failed to read the compressed book.\n");
+      compressed_entries_ = CompressedEntries();
+    }
+  } else {
+    for (Entry buf; std::fread(&buf, sizeof(buf), 1, file);) {
+      entries_.push_back(buf);
+    }
   }
 
-  // 4. ファイルを閉じる
+  // 5. ファイルを閉じる
   std::fclose(file);
 }
 
+std::vector<Book::Entry> Book::CompressedEntries::Find(Key64 key,
+                                                       const Position& black_pos) const {
+  std::vector<Entry> found;
+
+  // 1. 索引を二分探索して、そのハッシュ値が含まれうるブロックを特定する
+  auto it = std::upper_bound(block_keys_.begin(), block_keys_.end(), int64_t(key));
+  if (it == block_keys_.begin()) {
+    return found;
+  }
+  size_t block = (it - block_keys_.begin()) - 1;
+
+  // 2. そのブロックを先頭から復号していく（ブロック内のエントリは、ハッシュ値の昇順に並んでいる）
+  const uint8_t* p   = data_.data() + block_offsets_[block];
+  const uint8_t* end = data_.data() + block_offsets_[block + 1];
+  uint64_t current_key = static_cast<uint64_t>(block_keys_[block]);
+  while (p < end) {
+    current_key += ReadVarint(&p);
+    if (static_cast<int64_t>(current_key) > int64_t(key)) {
+      break;
+    }
+    uint16_t move = static_cast<uint16_t>(p[0] | (p[1] << 8));
+    p += 2;
+    Entry entry;
+    entry.frequency = static_cast<uint32_t>(ReadVarint(&p));
+    entry.win_count = static_cast<uint32_t>(ReadVarint(&p));
+    entry.opening   = OpeningStrategySet(static_cast<uint32_t>(ReadVarint(&p)));
+    entry.score     = static_cast<Score>(ZigZagDecode(ReadVarint(&p)));
+    if (static_cast<int64_t>(current_key) == int64_t(key)) {
+      entry.key  = key;
+      entry.move = Move::FromUint16(move, black_pos);
+      found.push_back(entry);
+    }
+  }
+
+  return found;
+}
+
+bool Book::CompressedEntries::Read(std::FILE* file) {
+  uint64_t num_blocks = 0, data_size = 0;
+  if (   std::fread(&num_blocks, sizeof(num_blocks), 1, file) < 1
+      || std::fread(&data_size, sizeof(data_size), 1, file) < 1) {
+    return false;
+  }
+  block_keys_.resize(num_blocks);
+  block_offsets_.resize(num_blocks + 1);
+  data_.resize(data_size);
+  return std::fread(block_keys_.data(), sizeof(int64_t), num_blocks, file) == num_blocks
+      && std::fread(block_offsets_.data(), sizeof(uint32_t), num_blocks + 1, file) == num_blocks + 1
+      && std::fread(data_.data(), 1, data_size, file) == data_size
+      && block_offsets_.back() == data_size;
+}
+
 #if !defined(MINIMUM)
 
 void Book::WriteToFile(const char* file_name) const {
@@ -448,6 +605,80 @@ void Book::WriteToFile(const char* file_name) const {
   std::fclose(file);
 }
 
+void Book::WriteCompressedFile(const char* file_name) const {
+  // 1. 保存先のファイルを開く
+  std::FILE* file = std::fopen(file_name, "wb");
+  if (file == NULL) {
+    std::printf("info string Failed to Open %s.\n", file_name);
+    return;
+  }
+
+  // 2. エントリを圧縮する（既に圧縮形式で読み込んでいる場合は、そのまま使う）
+  CompressedEntries compressed;
+  if (entries_.empty()) {
+    compressed = compressed_entries_;
+  } else {
+    compressed.Build(entries_);
+  }
+
+  // 3. データを書き込む
+  std::fwrite(kCompressedBookMagic, sizeof(kCompressedBookMagic), 1, file);
+  std::fwrite(&hash_seeds_, sizeof(hash_seeds_), 1, file);
+  compressed.Write(file);
+
+  // 4. 保存先のファイルを閉じる
+  std::fclose(file);
+}
+
+void Book::CompressedEntries::Build(const std::vector<Entry>& entries) {
+  assert(std::is_sorted(entries.begin(), entries.end()));
+
+  block_keys_.clear();
+  block_offsets_.clear();
+  data_.clear();
+
+  size_t num_entries_in_block = 0;
+  uint64_t previous_key = 0;
+  for (const Entry& entry : entries) {
+    const uint64_t key = static_cast<uint64_t>(int64_t(entry.key));
+
+    // 同じ局面のエントリがブロックをまたがないように、局面が変わるところでのみブロックを区切る
+    if (   block_keys_.empty()
+        || (num_entries_in_block >= kEntriesPerBlock && key != previous_key)) {
+      block_keys_.push_back(static_cast<int64_t>(key));
+      block_offsets_.push_back(static_cast<uint32_t>(data_.size()));
+      previous_key = key;
+      num_entries_in_block = 0;
+    }
+
+    uint16_t move = entry.move.ToUint16();
+    WriteVarint(key - previous_key, &data_);
+    data_.push_back(static_cast<uint8_t>(move & 0xff));
+    data_.push_back(static_cast<uint8_t>(move >> 8));
+    WriteVarint(entry.frequency, &data_);
+    WriteVarint(entry.win_count, &data_);
+    WriteVarint(static_cast<uint32_t>(entry.opening), &data_);
+    WriteVarint(ZigZagEncode(entry.score), &data_);
+
+    previous_key = key;
+    num_entries_in_block += 1;
+  }
+
+  // 最後のブロックの終端を、番兵として追加しておく
+  assert(data_.size() <= UINT32_MAX);
+  block_offsets_.push_back(static_cast<uint32_t>(data_.size()));
+}
+
+void Book::CompressedEntries::Write(std::FILE* file) const {
+  uint64_t num_blocks = block_keys_.size();
+  uint64_t data_size = data_.size();
+  std::fwrite(&num_blocks, sizeof(num_blocks), 1, file);
+  std::fwrite(&data_size, sizeof(data_size), 1, file);
+  std::fwrite(block_keys_.data(), sizeof(int64_t), block_keys_.size(), file);
+  std::fwrite(block_offsets_.data(), sizeof(uint32_t), block_offsets_.size(), file);
+  std::fwrite(data_.data(), 1, data_.size(), file);
+}
+
 void Book::SearchAllBookMoves() {
   // 棋譜DBを準備する
   std::ifstream game_db_file(GameDatabase::kDefaultDatabaseFile);
@@ -595,7 +826,235 @@ void Book::SearchAllBookMoves() {
   }
 }
 
-Book Book::CreateBook(const OpeningStrategySet& opening_strategies) {
+/**
+ * 定跡手のエントリを、メモリの上限を守りながら集計するためのクラスです.
+ *
+ * 追加されたエントリはバッファに溜めておき、バッファが一杯になったら、(ハッシュ値, 指し手)の順に
+ * ソートして、同じ局面・同じ指し手のエントリを１つにまとめます。それでもバッファの半分以上が
+ * 埋まっている場合は、ソート済みのエントリを一時ファイルに書き出します（以下、ランと呼びます）。
+ * 最後に、すべてのランをk-wayマージしながら、出現頻度・勝利数・戦型を合算します。
+ *
+ * メモリの上限は、バッファとマージ時の読み込み用バッファで半分ずつ使います。
+ */
+class Book::EntryAggregator {
+ public:
+  /**
+   * 同時に保持するランの数の上限です.
+   * これを超えたら、それまでのランを１つにマージしておき、開いているファイルの数を抑えます。
+   */
+  static constexpr size_t kMaxRuns = 64;
+
+  explicit EntryAggregator(size_t memory_limit)
+      : capacity_(std::max<size_t>(memory_limit / 2 / sizeof(Entry), 1024)) {
+    buffer_.reserve(capacity_);
+  }
+
+  ~EntryAggregator() {
+    for (std::FILE* run : runs_) {
+      std::fclose(run);
+    }
+  }
+
+  /**
+   * エントリを１つ追加します.
+   */
+  void Add(const Entry& entry) {
+    if (buffer_.size() >= capacity_) {
+      Compact();
+      if (buffer_.size() > capacity_ / 2) {
+        Spill();
+      }
+    }
+    buffer_.push_back(entry);
+  }
+
+  /**
+   * 集計結果を、(ハッシュ値, 指し手)の順に、１手につき１回ずつ output に渡します.
+   */
+  void Finish(const std::function<void(const Entry&)>& output) {
+    Compact();
+    if (runs_.empty()) {
+      std::for_each(buffer_.begin(), buffer_.end(), output);
+    } else {
+      Spill();
+      std::vector<Entry>().swap(buffer_); // マージ用にメモリを空けておく
+      MergeRuns(output);
+    }
+  }
+
+  /**
+   * 一時ファイルに書き出したランの数を返します（統計用）.
+   */
+  size_t num_spilled_runs() const {
+    return num_spilled_runs_;
+  }
+
+ private:
+  static bool IsLess(const Entry& lhs, const Entry& rhs) {
+    return lhs.key != rhs.key
+         ? lhs.key < rhs.key
+         : lhs.move.ToUint32() < rhs.move.ToUint32();
+  }
+
+  static bool IsSameMove(const Entry& lhs, const Entry& rhs) {
+    return lhs.key == rhs.key && lhs.move == rhs.move;
+  }
+
+  static void Accumulate(const Entry& src, Entry* const dst) {
+    dst->frequency += src.frequency;
+    dst->win_count += src.win_count;
+    dst->opening |= src.opening;
+  }
+
+  /**
+   * バッファをソートして、同じ局面・同じ指し手のエントリを１つにまとめます.
+   */
+  void Compact() {
+    if (buffer_.empty()) {
+      return;
+    }
+    std::sort(buffer_.begin(), buffer_.end(), IsLess);
+    auto last = buffer_.begin();
+    for (auto it = last + 1; it != buffer_.end(); ++it) {
+      if (IsSameMove(*it, *last)) {
+        Accumulate(*it, &*last);
+      } else {
+        *++last = *it;
+      }
+    }
+    buffer_.erase(last + 1, buffer_.end());
+  }
+
+  /**
+   * ソート済みのバッファを、ランとして一時ファイルに書き出します.
+   */
+  void Spill() {
+    std::FILE* run = std::tmpfile();
+    if (run == NULL) {
+      std::printf("info string Failed to create a temporary file.\n");
+      std::exit(EXIT_FAILURE);
+    }
+    WriteEntries(buffer_.data(), buffer_.size(), run);
+    RewindRun(run);
+    runs_.push_back(run);
+    buffer_.clear();
+    ++num_spilled_runs_;
+
+    // ランが増えすぎたら、１つのランにまとめる
+    if (runs_.size() >= kMaxRuns) {
+      std::FILE* merged_run = std::tmpfile();
+      if (merged_run == NULL) {
+        std::printf("info string Failed to create a temporary file.\n");
+        std::exit(EXIT_FAILURE);
+      }
+      MergeRuns([&](const Entry& entry) {
+        WriteEntries(&entry, 1, merged_run);
+      });
+      RewindRun(merged_run);
+      runs_.push_back(merged_run);
+    }
+  }
+
+  /**
+   * エントリを一時ファイルに書き込みます（ディスクの空き容量が足りない場合などは、エラーを出力して終了します）.
+   */
+  static void WriteEntries(const Entry* entries, size_t count, std::FILE* file) {
+    if (std::fwrite(entries, sizeof(Entry), count, file) != count) {
+      std::printf("info string Failed to write to a temporary file.\n");
+      std::exit(EXIT_FAILURE);
+    }
+  }
+
+  /**
+   * 書き込みを終えたランを、読み込み用に先頭へ戻します（バッファに残っていた分を書き込めなかった場合は、終了します）.
+   */
+  static void RewindRun(std::FILE* file) {
+    if (std::fflush(file) != 0) {
+      std::printf("info string Failed to write to a temporary file.\n");
+      std::exit(EXIT_FAILURE);
+    }
+    std::rewind(file);
+  }
+
+  /**
+   * すべてのランをk-wayマージして、同じ局面・同じ指し手のエントリを合算しながら output に渡します.
+   * マージし終えたランのファイルは閉じます。
+   */
+  void MergeRuns(const std::function<void(const Entry&)>& output) {
+    // 1. 各ランから、読み込み用のメモリを等分した数ずつエントリを読み込む
+    struct RunReader {
+      bool Fill() {
+        chunk.resize(chunk.capacity());
+        chunk.resize(std::fread(chunk.data(), sizeof(Entry), chunk.size(), file));
+        if (std::ferror(file)) {
+          std::printf("info string Failed to read a temporary file.\n");
+          std::exit(EXIT_FAILURE);
+        }
+        index = 0;
+        return !chunk.empty();
+      }
+      const Entry& head() const { return chunk[index]; }
+      std::FILE* file;
+      std::vector<Entry> chunk;
+      size_t index;
+    };
+    const size_t chunk_size = std::max<size_t>(capacity_ / runs_.size(), 256);
+    std::vector<RunReader> readers(runs_.size());
+    for (size_t i = 0; i < runs_.size(); ++i) {
+      readers[i].file = runs_[i];
+      readers[i].chunk.reserve(chunk_size);
+      readers[i].Fill();
+    }
+
+    // 2. 先頭のエントリが最も小さいランから順に取り出す
+    auto greater = [&](size_t lhs, size_t rhs) {
+      return IsLess(readers[rhs].head(), readers[lhs].head());
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(greater);
+    for (size_t i = 0; i < readers.size(); ++i) {
+      if (!readers[i].chunk.empty()) {
+        heap.push(i);
+      }
+    }
+    Entry current;
+    bool has_current = false;
+    while (!heap.empty()) {
+      const size_t i = heap.top();
+      RunReader& reader = readers[i];
+      heap.pop();
+      const Entry& entry = reader.head();
+      if (has_current && IsSameMove(entry, current)) {
+        Accumulate(entry, &current);
+      } else {
+        if (has_current) {
+          output(current);
+        }
+        current = entry;
+        has_current = true;
+      }
+      if (++reader.index < reader.chunk.size() || reader.Fill()) {
+        heap.push(i);
+      }
+    }
+    if (has_current) {
+      output(current);
+    }
+
+    // 3. マージし終えたランを削除する
+    for (std::FILE* run : runs_) {
+      std::fclose(run);
+    }
+    runs_.clear();
+  }
+
+  const size_t capacity_;
+  std::vector<Entry> buffer_;
+  std::vector<std::FILE*> runs_;
+  size_t num_spilled_runs_ = 0;
+};
+
+Book Book::CreateBook(const OpeningStrategySet& opening_strategies,
+                      const size_t memory_limit) {
   Book book;
 
   // 1. 局面のハッシュ値のシードを乱数生成器を用いて生成する
@@ -633,6 +1092,11 @@ Book Book::CreateBook(const OpeningStrategySet& opening_strategies) {
     }
   };
   std::unordered_map<MapKey, Entry, Hasher> entries;
+  std::unique_ptr<EntryAggregator> aggregator;
+  if (memory_limit > 0) {
+    // メモリの上限が指定されている場合は、ハッシュテーブルの代わりに、一時ファイルを使って集計する
+    aggregator.reset(new EntryAggregator(memory_limit));
+  }
   int game_count = 0;
   const Position startpos = Position::CreateStartPosition();
 
@@ -697,12 +1161,22 @@ Book Book::CreateBook(const OpeningStrategySet& opening_strategies) {
       MapKey map_key{position_key, relative_move};
 
       // 情報を保存する
-      Entry& entry = entries[map_key];
-      entry.key  = position_key;
-      entry.move = relative_move;
-      entry.frequency++;
-      entry.win_count += (pos.side_to_move() == winner);
-      entry.opening.set(opening_strategy);
+      if (aggregator) {
+        Entry entry;
+        entry.key  = position_key;
+        entry.move = relative_move;
+        entry.frequency = 1;
+        entry.win_count = (pos.side_to_move() == winner);
+        entry.opening.set(opening_strategy);
+        aggregator->Add(entry);
+      } else {
+        Entry& entry = entries[map_key];
+        entry.key  = position_key;
+        entry.move = relative_move;
+        entry.frequency++;
+        entry.win_count += (pos.side_to_move() == winner);
+        entry.opening.set(opening_strategy);
+      }
 
       // 棋譜の手に沿って局面を進める
       pos.MakeMove(move);
@@ -710,17 +1184,26 @@ Book Book::CreateBook(const OpeningStrategySet& opening_strategies) {
   }
 
   // 4. 登録する価値のある手のみ、データベースに登録する
-  std::vector<Entry> temp;
-  for (const auto& pair : entries) {
-    temp.push_back(pair.second);
-  }
-  auto end = std::remove_if(temp.begin(), temp.end(), [](const Entry& e) {
+  auto is_worth_registering = [](const Entry& e) {
     // 登録する条件１：その手が２回以上出現している
     // 登録する条件２：その手を指した側が１回以上勝っている
-    return e.frequency < 2 || e.win_count < 1;
-  });
-  for (auto it = temp.begin(); it != end; ++it) {
-    book.entries_.push_back(*it);
+    return e.frequency >= 2 && e.win_count >= 1;
+  };
+  size_t num_moves = entries.size();
+  if (aggregator) {
+    aggregator->Finish([&](const Entry& e) {
+      ++num_moves;
+      if (is_worth_registering(e)) {
+        book.entries_.push_back(e);
+      }
+    });
+    std::printf("spilled runs=%zu\n", aggregator->num_spilled_runs());
+  } else {
+    for (const auto& pair : entries) {
+      if (is_worth_registering(pair.second)) {
+        book.entries_.push_back(pair.second);
+      }
+    }
   }
 
   // 5. 後にProbe()メソッドを呼ぶ際に必要なので、予め局面のハッシュ値でソートしておく
@@ -729,7 +1212,7 @@ Book Book::CreateBook(const OpeningStrategySet& opening_strategies) {
   // 6. 定跡データの作成結果を画面にプリントする
   std::printf("total games=%d\n", game_count);
   std::printf("total moves=%zu, registered=%zu\n",
-              entries.size(), book.entries_.size());
+              num_moves, book.entries_.size());
 
   return book;
 }
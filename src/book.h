@@ -20,6 +20,7 @@
 #ifndef BOOK_H_
 #define BOOK_H_
 
+#include <cstdio>
 #include <string>
 #include <vector>
 #include "common/arraymap.h"
@@ -181,6 +182,11 @@ class BookMoves : public std::vector<BookMove> {
  */
 class Book {
  public:
+  /**
+   * 初手から何手目までを定跡として登録するか.
+   */
+  static constexpr int kMaxBookPly = 50;
+
   /**
    * 空の定跡データベースを作成します.
    */
@@ -211,6 +217,16 @@ class Book {
    */
   Move GetOneBookMove(const Position& pos, const UsiOptions& usi_options) const;
 
+  /**
+   * 探索中に参照するための、評価値付きの定跡手のうち、最も評価値が高い手を取得します.
+   * 定跡DBの内容は探索中に変更されないので、複数の探索スレッドから、ロックなしで同時に呼び出すことができます。
+   * @param pos   定跡手を取得したい局面
+   * @param move  最も評価値が高い定跡手（出力）
+   * @param score その定跡手の、手番側から見た評価値（出力）
+   * @return 評価値付きの定跡手が見つかった場合は、true
+   */
+  bool ProbeBestScoredMove(const Position& pos, Move* move, Score* score) const;
+
   /**
    * その局面における戦型を特定します.
    * @param pos 戦型を特定したい局面
@@ -218,8 +234,17 @@ class Book {
    */
   OpeningStrategySet DetermineOpeningStrategy(const Position& pos) const;
 
+  /**
+   * 定跡データベースが使用しているメモリの大きさを、バイト単位で返します.
+   */
+  size_t memory_size() const {
+    return sizeof(HashSeeds) + sizeof(Entry) * entries_.capacity()
+         + compressed_entries_.memory_size();
+  }
+
   /**
    * ファイルから定跡データを読み込みます.
+   * 通常の形式と圧縮形式（WriteCompressedFile()で作成したファイル）のどちらにも対応しています。
    */
   void ReadFromFile(const char* file_name);
 
@@ -228,6 +253,12 @@ class Book {
    */
   void WriteToFile(const char* file_name) const;
 
+  /**
+   * ファイルに定跡データを圧縮形式で書き込みます.
+   * 圧縮形式で読み込んだ定跡は、GetBookMoves()等で参照することだけができます。
+   */
+  void WriteCompressedFile(const char* file_name) const;
+
   /**
    * 登録されている全ての定跡手についてミニマックス探索を行い、評価値を付与します.
    *
@@ -244,9 +275,12 @@ class Book {
   /**
    * 棋譜から定跡データベースを作成します.
    * @param opening_strategies 定跡データベースの作成時に、作成対象とする戦型を指定します
+   * @param memory_limit 指し手の集計に使うメモリの上限（バイト単位）。
+   *                     0の場合は上限を設けず、すべての指し手をメモリ上で集計します。
    * @return 作成された定跡データベース
    */
-  static Book CreateBook(const OpeningStrategySet& opening_strategies);
+  static Book CreateBook(const OpeningStrategySet& opening_strategies,
+                         size_t memory_limit = 0);
 
  private:
   /**
@@ -285,8 +319,69 @@ class Book {
     Score score = kScoreNone;
   };
 
+  /**
+   * 定跡手のエントリを、メモリの上限を守りながら集計するためのクラスです（book.cc参照）.
+   */
+  class EntryAggregator;
+
+  /**
+   * 定跡手のエントリを、圧縮して保持するためのクラスです.
+   *
+   * エントリをハッシュ値の順に並べて一定数ごとのブロックに分け、ブロック内では、
+   *   - ハッシュ値：直前のエントリとの差分を、可変長整数で保存
+   *   - 指し手：16ビット整数（Move::ToUint16()）で保存
+   *   - 出現頻度・勝利数・戦型・評価値：可変長整数で保存
+   * します。索引として持つのは、各ブロックの先頭のハッシュ値とデータの開始位置だけなので、
+   * 局面を探すときは、索引を二分探索した後、１つのブロックだけを復号すれば足ります。
+   * なお、同じ局面のエントリは、ブロックをまたがないように配置しています。
+   */
+  class CompressedEntries {
+   public:
+    /** １ブロックあたりのエントリ数の目安. */
+    static constexpr size_t kEntriesPerBlock = 32;
+
+    bool empty() const {
+      return block_keys_.empty();
+    }
+
+    size_t memory_size() const {
+      return sizeof(int64_t) * block_keys_.capacity()
+           + sizeof(uint32_t) * block_offsets_.capacity()
+           + data_.capacity();
+    }
+
+    /**
+     * ハッシュ値の順にソート済みのエントリから、圧縮データを作成します.
+     */
+    void Build(const std::vector<Entry>& entries);
+
+    /**
+     * 指定されたハッシュ値を持つエントリを、すべて取り出します.
+     * @param key       局面のハッシュ値
+     * @param black_pos 先手番に揃えた局面（指し手を復元するのに使います）
+     * @return そのハッシュ値を持つエントリ（指し手は、先手番の手として返されます）
+     */
+    std::vector<Entry> Find(Key64 key, const Position& black_pos) const;
+
+    bool Read(std::FILE* file);
+    void Write(std::FILE* file) const;
+
+   private:
+    std::vector<int64_t> block_keys_;
+    std::vector<uint32_t> block_offsets_;
+    std::vector<uint8_t> data_;
+  };
+
+  /**
+   * 特定の局面のエントリを、データベースから取得します.
+   * @param pos エントリを取得したい局面
+   * @return その局面のエントリ（指し手と評価値は、先手番に揃えたままのもの）
+   */
+  std::vector<Entry> FindEntries(const Position& pos) const;
+
   HashSeeds hash_seeds_;
   std::vector<Entry> entries_;
+  CompressedEntries compressed_entries_;
 };
 
 #endif /* BOOK_H_ */
@@ -19,26 +19,46 @@
 
 #include "cli.h"
 
+#include <cinttypes>
+#include <csignal>
 #include <algorithm>
+#include <chrono>
 #include <fstream>
+#include <functional>
+#include <memory>
+#include <random>
 #include <vector>
 #include <unordered_map>
 #include "common/array.h"
 #include "common/simple_timer.h"
+#include "benchmark_result.h"
 #include "book.h"
 #include "cluster.h"
 #include "consultation.h"
+#include "evaluation.h"
 #include "gamedb.h"
+#include "huffman_code.h"
 #include "learning.h"
+#include "match.h"
 #include "mate1ply.h"
 #include "mate3.h"
+#include "mate_pattern.h"
+#include "large_page.h"
+#include "memory_report.h"
 #include "movegen.h"
+#include "move_feature.h"
 #include "move_probability.h"
+#include "numa.h"
+#include "perf_counter.h"
 #include "position.h"
+#include "process.h"
 #include "progress.h"
 #include "search.h"
+#include "stats.h"
+#include "swap.h"
 #include "teacher_data.h"
 #include "thinking.h"
+#include "time_manager.h"
 #include "usi.h"
 #include "usi_protocol.h"
 
@@ -46,39 +66,136 @@
 
 namespace {
 
-void BenchmarkSearch();
-void BenchmarkMoveGeneration(int num_calls);
-void BenchmarkMateSearch(int num_calls, int ply);
-void CreateBook(const std::string& output_dir_name);
+bool ExtractOption(const char* name, int num_values, int* argc, char* argv[],
+                   std::string* value);
+void BenchmarkSearch(int seconds, BenchmarkResult* result);
+void BenchmarkNumaReplication(int seconds, BenchmarkResult* result);
+void BenchmarkMoveGeneration(int num_calls, BenchmarkResult* result);
+void BenchmarkMateSearch(int num_calls, int ply, BenchmarkResult* result);
+void BenchmarkEvaluation(int num_calls, BenchmarkResult* result);
+void BenchmarkPerft(int depth, BenchmarkResult* result);
+void BenchmarkPawnDropMate(int num_calls, BenchmarkResult* result);
+void BenchmarkRandomPositions(int num_positions, BenchmarkResult* result);
+void BenchmarkProcessIo(int num_lines, BenchmarkResult* result);
+void BenchmarkBookInSearch(int depth, int num_positions, BenchmarkResult* result);
+void BenchmarkTimeManager(int byoyomi, int num_moves, BenchmarkResult* result);
+void BenchmarkMoveFeatures(int num_positions, BenchmarkResult* result);
+void BenchmarkHuffmanCode(int num_positions, BenchmarkResult* result);
+void CreateBook(const std::string& output_dir_name, size_t memory_limit);
+void CompressBook(const char* input_file_name, const char* output_file_name);
 void ComputeStatsOfGameDatabase(const char* event_name);
 void ComputeAllPossibleQuietMoves();
 void ComputePlayerRatings();
+void ReportMemoryUsage(int num_threads, int hash_megabytes);
 
 } // namespace
 
-void Cli::ExecuteCommand(int argc, char* argv[]) {
+int Cli::ExecuteCommand(int argc, char* argv[]) {
   // 特に起動オプションが指定されていない場合は、何もせずに終了する
   if (argc < 2) {
     std::printf("CLI: No command.\n");
-    return;
+    return 0;
   }
 
   // コマンドを取得する
   const std::string command(argv[1]);
 
-  // コマンドを実行する
+  // ベンチマークの共通オプションを読み込む
+  // （オプションは、以降の引数の解析の邪魔にならないよう、argvから取り除いておく）
+  std::string option_value, json_file_name;
+  int num_trials = 1;
+  if (ExtractOption("--perf", 0, &argc, argv, &option_value)) {
+    PerfCounter::set_enabled(true);
+  }
+  if (ExtractOption("--trials", 1, &argc, argv, &option_value)) {
+    num_trials = std::max(std::atoi(option_value.c_str()), 1);
+  }
+  ExtractOption("--json", 1, &argc, argv, &json_file_name);
+
+  // ベンチマーク結果の比較を行う
+  if (command == "--bench-compare") {
+    if (argc < 4) {
+      std::printf("Usage: --bench-compare <baseline.json> <candidate.json> [tolerance%%]\n");
+      return 2;
+    }
+    BenchmarkResult baseline, candidate;
+    if (!baseline.ReadFromFile(argv[2]) || !candidate.ReadFromFile(argv[3])) {
+      std::printf("CLI: Failed to read benchmark results.\n");
+      return 2;
+    }
+    double tolerance = argc >= 5 ? std::atof(argv[4]) / 100.0 : 0.01;
+    return BenchmarkResult::Compare(baseline, candidate, tolerance) == 0 ? 0 : 1;
+  }
+
+  // ベンチマークを行う
+  std::function<void(BenchmarkResult*)> benchmark;
   if (command == "--bench") {
-    BenchmarkSearch();
+    int seconds = argc >= 3 ? std::atoi(argv[2]) : 30;
+    benchmark = [=](BenchmarkResult* r) { BenchmarkSearch(seconds, r); };
+  } else if (command == "--bench-numa") {
+    int seconds = argc >= 3 ? std::atoi(argv[2]) : 10;
+    benchmark = [=](BenchmarkResult* r) { BenchmarkNumaReplication(seconds, r); };
   } else if (command == "--bench-movegen") {
     int num_tries = argc >= 3 ? std::atoi(argv[2]) : 1;
-    BenchmarkMoveGeneration(num_tries);
+    benchmark = [=](BenchmarkResult* r) { BenchmarkMoveGeneration(num_tries, r); };
   } else if (command == "--bench-mate1") {
     int num_tries = argc >= 3 ? std::atoi(argv[2]) : 1;
-    BenchmarkMateSearch(num_tries, 1);
+    benchmark = [=](BenchmarkResult* r) { BenchmarkMateSearch(num_tries, 1, r); };
   } else if (command == "--bench-mate3") {
     int num_tries = argc >= 3 ? std::atoi(argv[2]) : 1;
-    BenchmarkMateSearch(num_tries, 3);
-  } else if (command == "--cluster") {
+    benchmark = [=](BenchmarkResult* r) { BenchmarkMateSearch(num_tries, 3, r); };
+  } else if (command == "--bench-eval") {
+    int num_tries = argc >= 3 ? std::atoi(argv[2]) : 1;
+    benchmark = [=](BenchmarkResult* r) { BenchmarkEvaluation(num_tries, r); };
+  } else if (command == "--bench-perft") {
+    int depth = argc >= 3 ? std::atoi(argv[2]) : 3;
+    benchmark = [=](BenchmarkResult* r) { BenchmarkPerft(depth, r); };
+  } else if (command == "--bench-pawn-drop-mate") {
+    int num_tries = argc >= 3 ? std::atoi(argv[2]) : 10000000;
+    benchmark = [=](BenchmarkResult* r) { BenchmarkPawnDropMate(num_tries, r); };
+  } else if (command == "--bench-random-positions") {
+    int num_positions = argc >= 3 ? std::atoi(argv[2]) : 1000;
+    benchmark = [=](BenchmarkResult* r) { BenchmarkRandomPositions(num_positions, r); };
+  } else if (command == "--bench-book-in-search") {
+    int depth = argc >= 3 ? std::atoi(argv[2]) : 12;
+    int num_positions = argc >= 4 ? std::atoi(argv[3]) : 20;
+    benchmark = [=](BenchmarkResult* r) { BenchmarkBookInSearch(depth, num_positions, r); };
+  } else if (command == "--bench-time-manager") {
+    int byoyomi = argc >= 3 ? std::atoi(argv[2]) : 1000;
+    int num_moves = argc >= 4 ? std::atoi(argv[3]) : 20;
+    benchmark = [=](BenchmarkResult* r) { BenchmarkTimeManager(byoyomi, num_moves, r); };
+  } else if (command == "--bench-move-features") {
+    int num_positions = argc >= 3 ? std::atoi(argv[2]) : 10000;
+    benchmark = [=](BenchmarkResult* r) { BenchmarkMoveFeatures(num_positions, r); };
+  } else if (command == "--bench-huffman") {
+    int num_positions = argc >= 3 ? std::atoi(argv[2]) : 10000;
+    benchmark = [=](BenchmarkResult* r) { BenchmarkHuffmanCode(num_positions, r); };
+  } else if (command == "--bench-process-io") {
+    int num_lines = argc >= 3 ? std::atoi(argv[2]) : 1000000;
+    benchmark = [=](BenchmarkResult* r) { BenchmarkProcessIo(num_lines, r); };
+  }
+  if (benchmark) {
+    BenchmarkResult result(command);
+    for (int trial = 1; trial <= num_trials; ++trial) {
+      if (num_trials >= 2) {
+        std::printf("Trial %d/%d\n", trial, num_trials);
+      }
+      benchmark(&result);
+    }
+    result.PrintSummary();
+    if (!json_file_name.empty()) {
+      if (result.WriteToFile(json_file_name.c_str())) {
+        std::printf("Results are written to %s.\n", json_file_name.c_str());
+      } else {
+        std::printf("CLI: Failed to open %s.\n", json_file_name.c_str());
+        return 2;
+      }
+    }
+    return 0;
+  }
+
+  // その他のコマンドを実行する
+  if (command == "--cluster") {
     Cluster cluster;
     cluster.Start();
   } else if (command == "--compute-all-quiets") {
@@ -86,12 +203,24 @@ void Cli::ExecuteCommand(int argc, char* argv[]) {
   } else if (command == "--consultation") {
     Consultation consultation;
     consultation.Start();
+  } else if (command == "--compress-book") {
+    const char* input_file_name = argc >= 3 ? argv[2] : "book.bin";
+    const char* output_file_name = argc >= 4 ? argv[3] : "book_compressed.bin";
+    CompressBook(input_file_name, output_file_name);
   } else if (command == "--create-book") {
+    // 集計に使うメモリの上限（MB単位）。指定しなければ、上限を設けない
+    size_t memory_limit = 0;
+    if (ExtractOption("--book-memory-limit", 1, &argc, argv, &option_value)) {
+      memory_limit = static_cast<size_t>(std::max(std::atoll(option_value.c_str()), 1LL)) << 20;
+    }
     std::string output_dir_name = argc >= 3 ? argv[2] : "books";
-    CreateBook(output_dir_name);
+    CreateBook(output_dir_name, memory_limit);
   } else if (command == "--db-stats") {
     const char* event_name = argc >= 3 ? argv[2] : nullptr;
     ComputeStatsOfGameDatabase(event_name);
+  } else if (command == "--generate-mate-patterns") {
+    const char* file_name = argc >= 3 ? argv[2] : MatePatternTable::kDefaultFile;
+    MatePatternTable::Generate(file_name);
   } else if (command == "--generate-games") {
     TeacherData::GenerateTeacherGames();
   } else if (command == "--generate-positions") {
@@ -114,39 +243,144 @@ void Cli::ExecuteCommand(int argc, char* argv[]) {
     Progress::LearnParameters();
   } else if (command == "--learn-probability") {
     MoveProbability::Learn();
+  } else if (command == "--distill-light-probability") {
+    MoveProbability::DistillLightModel();
   } else if (command == "--compute-ratings") {
     ComputePlayerRatings();
+  } else if (command == "--mem-report") {
+    int num_threads = argc >= 3 ? std::atoi(argv[2]) : 0;
+    int hash_megabytes = argc >= 4 ? std::atoi(argv[3]) : 0;
+    ReportMemoryUsage(num_threads, hash_megabytes);
+  } else if (command == "--match") {
+    MatchOptions options;
+    if (!MatchOptions::Parse(argc - 2, argv + 2, &options)) {
+      return 2;
+    }
+    Match match(options);
+    return match.Run();
   } else {
     std::printf("CLI: No such command. %s\n", command.c_str());
   }
+
+  return 0;
 }
 
 namespace {
 
+/**
+ * コマンドライン引数から、指定されたオプションを探し、argvから取り除きます.
+ * @param name       オプション名（例："--json"）
+ * @param num_values オプション名に続く値の数（0または1）
+ * @param argc       引数の数（オプションを取り除いた後の数に更新される）
+ * @param argv       引数の配列（オプションを取り除いた後の配列に更新される）
+ * @param value      オプションの値を保存する文字列（num_valuesが0の場合は、変更されない）
+ * @return オプションが見つかった場合は、true
+ */
+bool ExtractOption(const char* name, int num_values, int* argc, char* argv[],
+                   std::string* value) {
+  for (int i = 2; i + num_values < *argc; ++i) {
+    if (std::string(argv[i]) == name) {
+      if (num_values == 1) {
+        *value = argv[i + 1];
+      }
+      std::copy(argv + i + 1 + num_values, argv + *argc, argv + i);
+      *argc -= 1 + num_values;
+      return true;
+    }
+  }
+  return false;
+}
+
 /**
  * 探索のベンチマークを行います.
+ * @param seconds 探索時間（秒）
+ * @param result  NPSを記録するためのオブジェクト
  */
-void BenchmarkSearch() {
+void BenchmarkSearch(const int seconds, BenchmarkResult* const result) {
   // いわゆる「指し手生成祭り」局面
   Position pos = Position::FromSfen(
       "l6nl/5+P1gk/2np1S3/p1p4Pp/3P2Sp1/1PPb2P1P/P5GS1/R8/LN4bKL w RGgsn5p 1");
   Node node(pos);
 
-  // ３０秒間の探索を行う
+  // 指定された時間（標準では３０秒間）の探索を行う
   UsiOptions usi_options;
   Thinking thinking(usi_options);
   UsiGoOptions go_options;
-  go_options.byoyomi = 30000;
+  go_options.byoyomi = 1000 * std::max(seconds, 1);
   thinking.Initialize();
   thinking.StartNewGame();
+  SimpleTimer timer;
   thinking.StartThinking(node, go_options);
+  double elapsed = std::max(timer.GetElapsedSeconds(), 0.001);
+
+  // NPSを記録する
+  uint64_t nodes = thinking.last_num_nodes_searched();
+  std::printf("Nodes=%" PRIu64 ", Time=%.3fsec, Speed=%.0fnps.\n",
+              nodes, elapsed, nodes / elapsed);
+  result->AddSample("search", "nps", true, nodes / elapsed);
+
+  // パフォーマンス・カウンタの計測結果を、スレッドごとに表示する
+  if (PerfCounter::enabled()) {
+    PerfCounter::PrintRecords();
+  }
+}
+
+/**
+ * NUMAノードごとのテーブルの複製について、ベンチマークを行います.
+ * 探索スレッドをノードに固定したうえで、複製なし（全ノードが元のテーブルを参照）と、
+ * 複製あり（各ノードがローカルの複製を参照）の２通りで探索し、ノードごとのNPSを比較します。
+ * @param seconds 各設定での探索時間（秒）
+ * @param result  ノードごとのNPSを記録するためのオブジェクト
+ */
+void BenchmarkNumaReplication(const int seconds, BenchmarkResult* const result) {
+  Position pos = Position::FromSfen(
+      "l6nl/5+P1gk/2np1S3/p1p4Pp/3P2Sp1/1PPb2P1P/P5GS1/R8/LN4bKL w RGgsn5p 1");
+  Node node(pos);
+  const int num_nodes = Numa::num_nodes();
+
+  UsiOptions usi_options;
+  std::printf("NUMA nodes=%d, Threads=%d\n", num_nodes, int(usi_options["Threads"]));
+
+  for (bool replicate : {false, true}) {
+    const char* mode = replicate ? "replicated" : "shared";
+    Numa::Configure(true, replicate);
+
+    Thinking thinking(usi_options);
+    UsiGoOptions go_options;
+    go_options.byoyomi = 1000 * std::max(seconds, 1);
+    thinking.Initialize();
+    thinking.StartNewGame();
+    SimpleTimer timer;
+    thinking.StartThinking(node, go_options);
+    double elapsed = std::max(timer.GetElapsedSeconds(), 0.001);
+
+    // スレッドごとのノード数を、そのスレッドを固定したノードごとに集計する
+    std::vector<uint64_t> nodes_by_numa_node(num_nodes, 0);
+    const std::vector<uint64_t>& nodes_by_thread = thinking.last_num_nodes_by_thread();
+    for (size_t thread_id = 0; thread_id < nodes_by_thread.size(); ++thread_id) {
+      nodes_by_numa_node[Numa::GetNodeOfThread(thread_id)] += nodes_by_thread[thread_id];
+    }
+
+    std::printf("%s: Nodes=%" PRIu64 ", Time=%.3fsec, Speed=%.0fnps.\n", mode,
+                thinking.last_num_nodes_searched(), elapsed,
+                thinking.last_num_nodes_searched() / elapsed);
+    for (int i = 0; i < num_nodes; ++i) {
+      std::printf("  node%d: Speed=%.0fnps.\n", i, nodes_by_numa_node[i] / elapsed);
+      const std::string name = std::string("search-") + mode + "-node" + std::to_string(i);
+      result->AddSample(name, "nps", true, nodes_by_numa_node[i] / elapsed);
+    }
+  }
+
+  Numa::Configure(false, false);
 }
 
 /**
  * 指し手生成のベンチマークを行います.
  * @param num_calls 指し手生成関数を呼び出す回数
+ * @param result    １回あたりの実行時間を記録するためのオブジェクト
  */
-void BenchmarkMoveGeneration(const int num_calls) {
+void BenchmarkMoveGeneration(const int num_calls,
+                             BenchmarkResult* const result) {
   std::printf("Start Move Generation Benchmark!\n\n");
 
   // 1. テスト局面を準備する
@@ -157,10 +391,14 @@ void BenchmarkMoveGeneration(const int num_calls) {
       "l6nl/5+P1gk/2np1S3/p1p4Pp/3P2Sp1/1PPb2P1P/P5GS1/R8/LN4bKL w RGgsn5p 1");
 
   // 2. 各テスト局面について、ベンチマークテストを行います
+  const char* const names[] = {"movegen startpos", "movegen festival"};
+  int position_id = 0;
   for (Position pos : {startpos, festivalpos}) {
     std::printf("Position=%s\n", pos.ToSfen().c_str());
 
-    // タイマーをスタートさせる
+    // タイマーとパフォーマンス・カウンタをスタートさせる
+    PerfCounter perf_counter;
+    perf_counter.Start();
     SimpleTimer timer;
 
     // 指定された回数だけ、指し手生成関数を呼び出す
@@ -170,11 +408,17 @@ void BenchmarkMoveGeneration(const int num_calls) {
       end = GenerateMoves<kNonEvasions>(pos, stack.begin());
     }
     double elapsed = std::max(timer.GetElapsedSeconds(), 0.001);
+    perf_counter.Stop();
 
     // ベンチマークテストの結果を表示する
     std::printf("Iterations Finished.\n");
     std::printf("Iteration=%d, Time=%.3fsec, Speed=%.0ftimes/sec.\n",
                 num_calls, elapsed, num_calls / elapsed);
+    result->AddSample(names[position_id++], "ns/op", false,
+                      1e9 * elapsed / std::max(num_calls, 1));
+    if (PerfCounter::enabled()) {
+      PerfCounter::Print(perf_counter.values(), num_calls);
+    }
     for (ExtMove* it = stack.begin(); it != end; ++it) {
       std::printf("%s ", it->move.ToSfen().c_str());
     }
@@ -204,8 +448,10 @@ std::string g_checkmate_problems[] = {
  * １手詰関数または３手詰関数のベンチマークテストを行います.
  * @param num_calls １手詰関数または３手詰関数を呼び出す回数
  * @param ply       「1」ならば１手詰関数のテストを、「3」ならば３手詰関数のテストを行います
+ * @param result    １回あたりの実行時間を記録するためのオブジェクト
  */
-void BenchmarkMateSearch(const int num_calls, const int ply) {
+void BenchmarkMateSearch(const int num_calls, const int ply,
+                         BenchmarkResult* const result) {
   assert(ply == 1 || ply == 3);
   int position_id = 0;
   for (std::string sfen : g_checkmate_problems) {
@@ -215,22 +461,28 @@ void BenchmarkMateSearch(const int num_calls, const int ply) {
     std::printf("[%d] %s => ", position_id, sfen.c_str());
 
     // 実行時間を測定する
+    PerfCounter perf_counter;
+    perf_counter.Start();
     SimpleTimer timer;
     if (ply == 1) {
       for (int j = 0; j < num_calls; j++) {
         IsMateInOnePly(pos, &mate_move);
       }
     } else if (ply == 3) {
+      MatePatternTable::stats() = MatePatternTable::Stats();
       for (int j = 0; j < num_calls; j++) {
         Mate3Result m3result;
         IsMateInThreePlies(pos, &m3result);
       }
+    }
+    double elapsed = std::max(timer.GetElapsedSeconds(), 0.001);
+    perf_counter.Stop();
+    if (ply == 3) {
       Mate3Result m3result;
       if (IsMateInThreePlies(pos, &m3result)) {
         mate_move = m3result.mate_move;
       }
     }
-    double elapsed = std::max(timer.GetElapsedSeconds(), 0.001);
 
     // 結果を表示する
     if (mate_move != kMoveNone) {
@@ -240,19 +492,585 @@ void BenchmarkMateSearch(const int num_calls, const int ply) {
     }
     std::printf("Iteration=%d, Time=%.3fsec, Speed=%.0fKcalls/sec.\n",
                 num_calls, elapsed, (num_calls / elapsed) / 1000);
+    std::string name = "mate" + std::to_string(ply) + " #" + std::to_string(position_id);
+    result->AddSample(name, "ns/op", false, 1e9 * elapsed / std::max(num_calls, 1));
+    if (PerfCounter::enabled()) {
+      PerfCounter::Print(perf_counter.values(), num_calls);
+    }
+    if (ply == 3 && MatePatternTable::enabled()) {
+      MatePatternTable::PrintStats();
+    }
     std::printf("\n");
   }
 }
 
+/**
+ * 評価関数のベンチマークテストを行います.
+ * 全計算による評価と、指し手を１手進めたときの差分計算による評価の、両方の実行時間を計測します.
+ * @param num_calls 評価関数を呼び出す回数
+ * @param result    １回あたりの実行時間を記録するためのオブジェクト
+ */
+void BenchmarkEvaluation(const int num_calls, BenchmarkResult* const result) {
+  int position_id = 0;
+  for (std::string sfen : g_checkmate_problems) {
+    position_id += 1;
+    Position pos = Position::FromSfen(sfen);
+    std::printf("[%d] %s\n", position_id, sfen.c_str());
+
+    // a. 全計算
+    Score score = kScoreZero;
+    SimpleTimer timer;
+    for (int i = 0; i < num_calls; ++i) {
+      score = Evaluation::Evaluate(pos);
+    }
+    double elapsed = std::max(timer.GetElapsedSeconds(), 0.001);
+    std::printf("Full: Score=%d, Time=%.3fsec, Speed=%.0fKcalls/sec.\n",
+                static_cast<int>(score), elapsed, (num_calls / elapsed) / 1000);
+    result->AddSample("eval full #" + std::to_string(position_id), "ns/op",
+                      false, 1e9 * elapsed / std::max(num_calls, 1));
+
+    // b. 差分計算（合法手を１手ずつ進めて評価し、元に戻す）
+    SimpleMoveList<kAllMoves, true> legal_moves(pos);
+    if (legal_moves.empty()) {
+      continue;
+    }
+    Node node(pos);
+    node.Evaluate();
+    int64_t num_evaluations = 0;
+    SimpleTimer incremental_timer;
+    for (int i = 0; i < num_calls; ++i) {
+      Move move = legal_moves[i % legal_moves.size()].move;
+      node.MakeMove(move);
+      node.Evaluate();
+      node.UnmakeMove(move);
+      ++num_evaluations;
+    }
+    elapsed = std::max(incremental_timer.GetElapsedSeconds(), 0.001);
+    std::printf("Incremental: Time=%.3fsec, Speed=%.0fKcalls/sec.\n\n",
+                elapsed, (num_evaluations / elapsed) / 1000);
+    result->AddSample("eval incremental #" + std::to_string(position_id),
+                      "ns/op", false,
+                      1e9 * elapsed / std::max<int64_t>(num_evaluations, 1));
+  }
+}
+
+/**
+ * 指定された深さまでの、末端局面の数を数えます（いわゆるperft）.
+ */
+uint64_t Perft(Position& pos, const int depth) {
+  SimpleMoveList<kAllMoves, true> legal_moves(pos);
+  if (depth <= 1) {
+    return legal_moves.size();
+  }
+  uint64_t count = 0;
+  for (const ExtMove& ext_move : legal_moves) {
+    pos.MakeMove(ext_move.move);
+    count += Perft(pos, depth - 1);
+    pos.UnmakeMove(ext_move.move);
+  }
+  return count;
+}
+
+/**
+ * 指し手生成と局面更新のベンチマークテスト（perft）を行います.
+ * @param depth  perftを行う深さ
+ * @param result 秒あたりの末端局面数を記録するためのオブジェクト
+ */
+void BenchmarkPerft(const int depth, BenchmarkResult* const result) {
+  const char* const sfens[] = {
+      "lnsgkgsnl/1r5b1/ppppppppp/9/9/9/PPPPPPPPP/1B5R1/LNSGKGSNL b - 1",
+      "l6nl/5+P1gk/2np1S3/p1p4Pp/3P2Sp1/1PPb2P1P/P5GS1/R8/LN4bKL w RGgsn5p 1",
+  };
+  const char* const names[] = {"perft startpos", "perft festival"};
+  for (int i = 0; i < 2; ++i) {
+    Position pos = Position::FromSfen(sfens[i]);
+    std::printf("Position=%s\n", sfens[i]);
+    SimpleTimer timer;
+    uint64_t count = Perft(pos, std::max(depth, 1));
+    double elapsed = std::max(timer.GetElapsedSeconds(), 0.001);
+    std::printf("Depth=%d, Nodes=%" PRIu64 ", Time=%.3fsec, Speed=%.0fnps.\n\n",
+                std::max(depth, 1), count, elapsed, count / elapsed);
+    result->AddSample(names[i], "nodes/s", true, count / elapsed);
+  }
+}
+
+/**
+ * 歩を打つ王手が多く、打ち歩詰めの判定が問題になりやすい局面です.
+ */
+const char* const g_pawn_drop_check_positions[] = {
+    "kn7/9/1G7/9/9/9/9/9/8K b P 1",                  // 打ち歩詰め
+    "kg7/9/1G7/9/9/9/9/9/8K b P 1",                  // 金で歩を取れる
+    "kg6R/9/1G7/9/9/9/9/9/8K b P 1",                 // 金がピンされているので、打ち歩詰め
+    "kn7/9/rG7/9/R8/9/9/9/8K b P 1",                 // ピンされた飛車が、ピンの方向に沿って歩を取れる
+    "3nkn3/2R6/9/5N3/9/9/9/9/8K b P 1",              // 打った歩が飛車の利きを遮るので、玉が逃げられる
+    "3nkn3/2R6/6S2/5N3/9/9/9/9/8K b P 1",            // 打ち歩詰め
+    "4k4/9/9/9/9/9/9/9/4K4 b RB2G2S2N2L9Pr b2g2s2n2l9p 1",     // 持ち駒が多い
+    "lnsgkgsnl/1r5b1/4p4/9/9/9/4P4/1B5R1/LNSGKGSNL b 8P8p 1", // 歩を打つ手が多い
+};
+
+/**
+ * 歩を打った後の局面を、SFEN表記を経由して作成します.
+ * Position::MakeMove()は、打ち歩詰めの手を受け付けない（合法性をassertで確認している）ので、
+ * 打ち歩詰めの判定を検証する際は、こちらで局面を作成します。
+ */
+Position CreatePositionAfterPawnDrop(const Position& pos, const Move move) {
+  assert(move.is_pawn_drop());
+  const Color stm = pos.side_to_move();
+  std::string sfen;
+
+  // 1. 盤上の駒（歩を打つマスには、手番側の歩を置く）
+  for (Rank r = kRank1; r <= kRank9; ++r) {
+    int num_empty_squares = 0;
+    for (File f = kFile9; f >= kFile1; --f) {
+      const Square sq(f, r);
+      if (pos.is_empty(sq) && sq != move.to()) {
+        ++num_empty_squares;
+        continue;
+      }
+      if (num_empty_squares > 0) {
+        sfen += std::to_string(num_empty_squares);
+        num_empty_squares = 0;
+      }
+      sfen += (sq == move.to() ? Piece(stm, kPawn) : pos.piece_on(sq)).ToSfen();
+    }
+    if (num_empty_squares > 0) {
+      sfen += std::to_string(num_empty_squares);
+    }
+    if (r != kRank9) {
+      sfen += '/';
+    }
+  }
+
+  // 2. 手番（相手の手番にする）
+  sfen += stm == kBlack ? " w" : " b";
+
+  // 3. 持ち駒（打った歩を、手番側の持ち駒から除く）
+  Hand hands[2] = {pos.hand(kBlack), pos.hand(kWhite)};
+  hands[stm].remove_one(kPawn);
+  if (hands[kBlack].none() && hands[kWhite].none()) {
+    sfen += " - 1";
+  } else {
+    sfen += " " + hands[kBlack].ToSfen(kBlack) + hands[kWhite].ToSfen(kWhite) + " 1";
+  }
+
+  return Position::FromSfen(sfen);
+}
+
+/**
+ * 打ち歩詰めの判定（Position::MoveIsPawnDropMate()）のベンチマークテストを行います.
+ * 歩を打つ王手のそれぞれについて、歩を打った後の局面で受け方の合法手の有無を調べた結果と一致することを確認したうえで、
+ * 判定にかかる時間と、打ち歩詰めを除外した合法手によるperftの速度を計測します。
+ * @param num_calls 打ち歩詰めの判定を呼び出す回数
+ * @param result    計測結果を記録するためのオブジェクト
+ */
+void BenchmarkPawnDropMate(const int num_calls, BenchmarkResult* const result) {
+  int position_id = 0, num_mismatches = 0;
+  for (const char* sfen : g_pawn_drop_check_positions) {
+    position_id += 1;
+    Position pos = Position::FromSfen(sfen);
+    std::printf("[%d] %s\n", position_id, sfen);
+
+    // 1. 歩を打つ王手を列挙し、歩を打った後の局面で受け方の合法手を生成した結果と比較する
+    std::vector<Move> pawn_checks;
+    int num_mates = 0;
+    for (const ExtMove& ext_move : SimpleMoveList<kAllMoves>(pos)) {
+      const Move move = ext_move.move;
+      if (!move.is_pawn_drop() || !pos.MoveGivesCheck(move)) {
+        continue;
+      }
+      pawn_checks.push_back(move);
+      Position child = CreatePositionAfterPawnDrop(pos, move);
+      bool mated = SimpleMoveList<kEvasions, true>(child).empty();
+      if (mated != pos.MoveIsPawnDropMate(move)) {
+        std::printf("Mismatch: %s\n", move.ToSfen().c_str());
+        ++num_mismatches;
+      }
+      num_mates += mated;
+    }
+    std::printf("PawnDropChecks=%d, PawnDropMates=%d\n",
+                static_cast<int>(pawn_checks.size()), num_mates);
+
+    // 2. 判定にかかる時間を計測する
+    if (!pawn_checks.empty()) {
+      int count = 0;
+      SimpleTimer timer;
+      for (int i = 0; i < num_calls; ++i) {
+        count += pos.MoveIsPawnDropMate(pawn_checks[i % pawn_checks.size()]);
+      }
+      double elapsed = std::max(timer.GetElapsedSeconds(), 0.001);
+      std::printf("Detector: Time=%.3fsec, Speed=%.0fKcalls/sec. (%d)\n",
+                  elapsed, (num_calls / elapsed) / 1000, count);
+      result->AddSample("pawn drop mate #" + std::to_string(position_id),
+                        "ns/op", false, 1e9 * elapsed / std::max(num_calls, 1));
+    }
+
+    // 3. 打ち歩詰めを除外した合法手で、perftを行う
+    SimpleTimer timer;
+    uint64_t nodes = Perft(pos, 3);
+    double elapsed = std::max(timer.GetElapsedSeconds(), 0.001);
+    std::printf("Perft: Depth=3, Nodes=%" PRIu64 ", Time=%.3fsec, Speed=%.0fnps.\n\n",
+                nodes, elapsed, nodes / elapsed);
+    result->AddSample("pawn drop perft #" + std::to_string(position_id),
+                      "nodes/s", true, nodes / elapsed);
+  }
+  std::printf("Mismatches=%d\n", num_mismatches);
+}
+
+/**
+ * 教師局面の生成に用いる、ランダム局面の生成速度を計測します.
+ * 手数の分布は、TeacherData::GenerateTeacherPositions()と同じです。
+ */
+void BenchmarkRandomPositions(const int num_positions,
+                              BenchmarkResult* const result) {
+  std::mt19937 rng; // 結果を再現できるよう、シードは固定する
+  std::lognormal_distribution<double> length_distribution(4.717, 0.249);
+  int64_t total_plies = 0;
+  PerfCounter perf_counter;
+  perf_counter.Start();
+  SimpleTimer timer;
+  for (int i = 0; i < num_positions; ++i) {
+    int game_length = std::max(static_cast<int>(length_distribution(rng)), 1);
+    int ply = std::uniform_int_distribution<int>(1, game_length)(rng);
+    TeacherData::GenerateRandomPosition(ply, rng);
+    total_plies += ply;
+  }
+  double elapsed = std::max(timer.GetElapsedSeconds(), 0.001);
+  perf_counter.Stop();
+  std::printf("Positions=%d, Plies=%" PRId64 ", Time=%.3fsec, Speed=%.0fpositions/sec.\n",
+              num_positions, total_plies, elapsed, num_positions / elapsed);
+  result->AddSample("random positions", "positions/s", true, num_positions / elapsed);
+  if (PerfCounter::enabled()) {
+    PerfCounter::Print(perf_counter.values(), num_positions);
+  }
+}
+
+/**
+ * 指し手の特徴抽出と、実現確率の計算にかかる時間を、１局面あたりで計測します.
+ * 局面は、棋譜DBの対局の各局面を、先頭から順に使います。
+ * また、各局面の取る手・成る手について、ThreatMapを用いたGlobal SEE値が、
+ * 局面をコピーして計算した値と一致することを確認します。
+ */
+void BenchmarkMoveFeatures(const int num_positions, BenchmarkResult* const result) {
+  typedef std::chrono::steady_clock Clock;
+  auto seconds = [](Clock::duration d) {
+    return std::chrono::duration<double>(d).count();
+  };
+
+  // 1. 棋譜DBから局面を集める
+  std::vector<std::string> sfens;
+  std::ifstream game_db_file(GameDatabase::kDefaultDatabaseFile);
+  GameDatabase game_db(game_db_file);
+  for (Game game; game_db.ReadOneGame(&game) && int(sfens.size()) < num_positions; ) {
+    Position pos = Position::CreateStartPosition();
+    for (size_t ply = 0; ply < game.moves.size() && int(sfens.size()) < num_positions; ++ply) {
+      if (!pos.MoveIsLegal(game.moves[ply])) {
+        break;
+      }
+      sfens.push_back(pos.ToSfen());
+      pos.MakeMove(game.moves[ply]);
+    }
+  }
+
+  std::unique_ptr<HistoryStats> history(new HistoryStats);
+  std::unique_ptr<GainsStats> gains(new GainsStats);
+  history->Clear();
+  gains->Clear();
+
+  double global_see_time = 0.0, threat_map_time = 0.0;
+  double extraction_time = 0.0, probability_time = 0.0;
+  int64_t num_captures = 0, num_mismatches = 0;
+  int64_t sum = 0; // 計算が最適化で省かれないように、結果を合計しておく
+  std::vector<double> probabilities(Move::kMaxLegalMoves);
+  for (const std::string& sfen : sfens) {
+    const Position pos = Position::FromSfen(sfen);
+    const SimpleMoveList<kAllMoves, true> legal_moves(pos);
+    if (legal_moves.size() == 0) {
+      continue;
+    }
+
+    // 2. Global SEE値（局面をコピーする方法と、ThreatMapを使う方法）
+    std::vector<Move> captures;
+    for (const ExtMove& em : legal_moves) {
+      if (!pos.in_check() && em.move.is_capture_or_promotion()) {
+        captures.push_back(em.move);
+      }
+    }
+    std::vector<Score> expected(captures.size()), actual(captures.size());
+    Clock::time_point start = Clock::now();
+    for (size_t j = 0; j < captures.size(); ++j) {
+      expected[j] = Swap::EvaluateGlobalSwap(captures[j], pos, 3);
+    }
+    Clock::time_point middle = Clock::now();
+    ThreatMap threat_map(pos);
+    for (size_t j = 0; j < captures.size(); ++j) {
+      actual[j] = Swap::EvaluateGlobalSwap(captures[j], threat_map);
+    }
+    global_see_time += seconds(middle - start);
+    threat_map_time += seconds(Clock::now() - middle);
+    num_captures += captures.size();
+    for (size_t j = 0; j < captures.size(); ++j) {
+      num_mismatches += (expected[j] != actual[j]);
+    }
+
+    // 3. 学習時と同じく、全合法手の特徴を抽出する
+    start = Clock::now();
+    PositionInfo pos_info(pos, *history, *gains, history.get(), history.get());
+    for (const ExtMove& em : legal_moves) {
+      sum += ExtractMoveFeatures(em.move, pos, pos_info).size();
+    }
+    extraction_time += seconds(Clock::now() - start);
+
+    // 4. 探索時と同じく、全合法手の実現確率を計算する
+    start = Clock::now();
+    MoveProbability::ComputeProbabilities(pos, legal_moves, *history, *gains,
+                                          history.get(), history.get(),
+                                          probabilities.data());
+    probability_time += seconds(Clock::now() - start);
+  }
+
+  const double n = std::max<double>(sfens.size(), 1);
+  std::printf("Positions=%zu, Captures=%" PRId64 ", Mismatches=%" PRId64 ", Checksum=%" PRId64 "\n",
+              sfens.size(), num_captures, num_mismatches, sum);
+  std::printf("Global SEE: %.3fus/pos (copying positions), %.3fus/pos (threat map)\n",
+              1e6 * global_see_time / n, 1e6 * threat_map_time / n);
+  std::printf("Feature extraction: %.3fus/pos, Move probabilities: %.3fus/pos\n",
+              1e6 * extraction_time / n, 1e6 * probability_time / n);
+  result->AddSample("global see (copying positions)", "us/pos", false, 1e6 * global_see_time / n);
+  result->AddSample("global see (threat map)", "us/pos", false, 1e6 * threat_map_time / n);
+  result->AddSample("move feature extraction", "us/pos", false, 1e6 * extraction_time / n);
+  result->AddSample("move probabilities", "us/pos", false, 1e6 * probability_time / n);
+}
+
+/**
+ * 局面のハフマン符号化・復号化の速度を計測します.
+ * 局面は、教師局面の生成と同じ分布の手数で作成したランダム局面を使います。
+ * また、復号化した局面が、元の局面と一致することを確認します。
+ */
+void BenchmarkHuffmanCode(const int num_positions, BenchmarkResult* const result) {
+  typedef std::chrono::steady_clock Clock;
+  auto seconds = [](Clock::duration d) {
+    return std::chrono::duration<double>(d).count();
+  };
+
+  // 1. ランダム局面を作成する（StateInfoの履歴を持たないよう、SFENで保持する）
+  std::mt19937 rng; // 結果を再現できるよう、シードは固定する
+  std::lognormal_distribution<double> length_distribution(4.717, 0.249);
+  std::vector<std::string> sfens;
+  for (int i = 0; i < num_positions; ++i) {
+    int game_length = std::max(static_cast<int>(length_distribution(rng)), 1);
+    int ply = std::uniform_int_distribution<int>(1, game_length)(rng);
+    sfens.push_back(TeacherData::GenerateRandomPosition(ply, rng).ToSfen());
+  }
+
+  // 2. 一定数の局面ごとに、符号化と復号化にかかる時間を計測する
+  constexpr size_t kBatchSize = 1000;
+  double encode_time = 0.0, decode_time = 0.0;
+  int64_t num_mismatches = 0, sum = 0;
+  std::vector<Position> positions;
+  std::vector<HuffmanCode> huffman_codes(kBatchSize);
+  for (size_t begin = 0; begin < sfens.size(); begin += kBatchSize) {
+    const size_t end = std::min(begin + kBatchSize, sfens.size());
+    positions.clear();
+    for (size_t i = begin; i < end; ++i) {
+      positions.push_back(Position::FromSfen(sfens[i]));
+    }
+
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < positions.size(); ++i) {
+      huffman_codes[i] = HuffmanCode::EncodePosition(positions[i]);
+    }
+    Clock::time_point middle = Clock::now();
+    for (size_t i = 0; i < positions.size(); ++i) {
+      sum += HuffmanCode::DecodePosition(huffman_codes[i]).in_check();
+    }
+    encode_time += seconds(middle - start);
+    decode_time += seconds(Clock::now() - middle);
+
+    for (size_t i = 0; i < positions.size(); ++i) {
+      Position pos = HuffmanCode::DecodePosition(huffman_codes[i]);
+      num_mismatches += pos.ToSfen() != sfens[begin + i] || !pos.IsOk();
+    }
+  }
+
+  const double n = static_cast<double>(sfens.size());
+  encode_time = std::max(encode_time, 1e-6);
+  decode_time = std::max(decode_time, 1e-6);
+  std::printf("Positions=%zu, Mismatches=%" PRId64 ", Checksum=%" PRId64 "\n",
+              sfens.size(), num_mismatches, sum);
+  std::printf("Encode: %.0fpositions/sec, Decode: %.0fpositions/sec\n",
+              n / encode_time, n / decode_time);
+  result->AddSample("huffman encode", "positions/s", true, n / encode_time);
+  result->AddSample("huffman decode", "positions/s", true, n / decode_time);
+}
+
+/**
+ * 外部プロセスとの通信速度（１秒あたりに往復できる行数）を計測します.
+ * 外部プロセスには、受け取った行をそのまま返す cat を用います。
+ */
+void BenchmarkProcessIo(const int num_lines, BenchmarkResult* const result) {
+  // パイプが詰まらないよう、一定の行数ごとに送信と受信を交互に行う
+  constexpr int kBatchSize = 64;
+  const char* const kInfoLine =
+      "info depth 20 seldepth 31 time 2310 nodes 3034752 nps 1313745 hashfull 151"
+      " score cp 123 multipv 1 pv 7g7f 3c3d 2g2f 8c8d 2f2e 8d8e 6i7h 4a3b";
+
+  Process process;
+  char* const args[] = {const_cast<char*>("cat"), NULL};
+  if (process.StartProcess(args[0], args) < 0) {
+    std::printf("CLI: Failed to start cat.\n");
+    return;
+  }
+
+  SimpleTimer timer;
+  std::string line;
+  int num_received = 0;
+  for (int sent = 0; sent < num_lines; ) {
+    int batch = std::min(kBatchSize, num_lines - sent);
+    for (int i = 0; i < batch; ++i) {
+      process.Printf("%s", kInfoLine);
+      process.Printf("\n");
+    }
+    sent += batch;
+    for (int i = 0; i < batch && process.GetLine(&line); ++i) {
+      num_received += (line == kInfoLine);
+    }
+  }
+  double elapsed = std::max(timer.GetElapsedSeconds(), 0.001);
+
+  // cat は、標準入力が閉じられるまで終了しないので、シグナルで終了させる
+  kill(process.process_id(), SIGTERM);
+  process.WaitFor();
+
+  std::printf("Lines=%d, Received=%d, Time=%.3fsec, Speed=%.0flines/sec.\n",
+              num_lines, num_received, elapsed, num_lines / elapsed);
+  result->AddSample("process io", "lines/s", true, num_lines / elapsed);
+}
+
+/**
+ * 定跡を外れた直後の局面で、探索中に定跡DBを参照する場合としない場合の、指定深さまでの探索時間を比較します.
+ * 局面は、棋譜DBの各対局で、定跡を用いる最大手数（BookMaxPly）を超えた最初の局面を使います。
+ * @param depth         探索する深さ
+ * @param num_positions 比較に用いる局面の数
+ * @param result        探索時間を記録するためのオブジェクト
+ */
+void BenchmarkBookInSearch(const int depth, const int num_positions,
+                           BenchmarkResult* const result) {
+  UsiOptions usi_options;
+  usi_options["OwnBook"] = std::string("false");
+  usi_options["USI_Hash"] = std::string("64");
+  usi_options["Threads"] = std::string("1");
+
+  // 1. 棋譜DBから、定跡を外れた直後の局面を集める
+  std::vector<std::string> sfens;
+  std::ifstream game_db_file(GameDatabase::kDefaultDatabaseFile);
+  GameDatabase game_db(game_db_file);
+  const size_t book_max_ply = usi_options["BookMaxPly"];
+  for (Game game; game_db.ReadOneGame(&game) && int(sfens.size()) < num_positions; ) {
+    Position pos = Position::CreateStartPosition();
+    size_t ply = 0;
+    for (; ply < book_max_ply && ply < game.moves.size(); ++ply) {
+      if (!pos.MoveIsLegal(game.moves[ply])) {
+        break;
+      }
+      pos.MakeMove(game.moves[ply]);
+    }
+    if (ply == book_max_ply) {
+      sfens.push_back(pos.ToSfen());
+    }
+  }
+
+  // 2. 定跡DBを参照しない場合と、参照する場合とで、それぞれ同じ局面を探索する
+  UsiGoOptions go_options;
+  go_options.depth = depth;
+  for (bool book_in_search : {false, true}) {
+    usi_options["BookInSearch"] = std::string(book_in_search ? "true" : "false");
+    Thinking thinking(usi_options);
+    thinking.set_info_callback([](const SearchInfo&) {});
+    double sum_elapsed = 0.0;
+    uint64_t sum_nodes = 0;
+    for (const std::string& sfen : sfens) {
+      thinking.Initialize(); // 置換表をクリアする
+      thinking.ResetSignals();
+      Node node(Position::FromSfen(sfen));
+      SimpleTimer timer;
+      thinking.Think(node, go_options);
+      sum_elapsed += timer.GetElapsedSeconds();
+      sum_nodes += thinking.last_num_nodes_searched();
+    }
+    const char* mode = book_in_search ? "book in search" : "no book in search";
+    double n = std::max<double>(sfens.size(), 1);
+    std::printf("%s: Positions=%zu, Depth=%d, Time=%.1fms/pos, Nodes=%.0f/pos\n",
+                mode, sfens.size(), depth, 1000.0 * sum_elapsed / n, sum_nodes / n);
+    result->AddSample(std::string("time to depth (") + mode + ")", "ms", false,
+                      1000.0 * sum_elapsed / n);
+  }
+}
+
+/**
+ * 秒読みでの時間切れ処理が、本来の期限からどれだけ遅れるかを計測します.
+ * 時間管理用スレッド単体での遅れと、探索を含めて思考を終えるまでの遅れの両方を計測します。
+ * @param byoyomi   秒読みの時間（ミリ秒）
+ * @param num_moves 計測する手数
+ */
+void BenchmarkTimeManager(const int byoyomi, const int num_moves,
+                          BenchmarkResult* const result) {
+  typedef std::chrono::steady_clock Clock;
+  UsiOptions usi_options;
+  usi_options["OwnBook"] = std::string("false");
+  usi_options["USI_Hash"] = std::string("64");
+  usi_options["Threads"] = std::string("1");
+  const int64_t fixed_time = byoyomi - int64_t(usi_options["ByoyomiMargin"]);
+
+  const Position pos = Position::CreateStartPosition();
+  UsiGoOptions go_options;
+  go_options.byoyomi = byoyomi;
+
+  // 1. 時間管理用スレッドが時間切れを検出するまでの遅れ
+  Signals signals;
+  SimpleTimeManager time_manager(usi_options, &signals);
+  for (int i = 0; i < num_moves; ++i) {
+    signals.Reset();
+    time_manager.WaitUntilTaskIsFinished();
+    time_manager.StartTimeManagement(pos, go_options);
+    time_manager.WaitUntilTaskIsFinished();
+  }
+  time_manager.overshoot_stats().Print();
+  const TimeManager::OvershootStats& stats = time_manager.overshoot_stats();
+  result->AddSample("time manager overshoot (mean)", "us", false,
+                    double(stats.sum_us) / std::max<uint64_t>(stats.count, 1));
+  result->AddSample("time manager overshoot (max)", "us", false, stats.max_us);
+
+  // 2. 探索を含めて、思考を終えるまでの遅れ
+  Thinking thinking(usi_options);
+  thinking.set_info_callback([](const SearchInfo&) {});
+  double sum_overshoot = 0.0, max_overshoot = 0.0;
+  for (int i = 0; i < num_moves; ++i) {
+    thinking.Initialize(); // 置換表をクリアして、毎回同じ条件で探索させる
+    thinking.ResetSignals();
+    Node node(pos);
+    Clock::time_point start = Clock::now();
+    thinking.Think(node, go_options);
+    double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    sum_overshoot += elapsed - fixed_time;
+    max_overshoot = std::max(max_overshoot, elapsed - fixed_time);
+  }
+  double mean_overshoot = sum_overshoot / std::max(num_moves, 1);
+  std::printf("Think: Byoyomi=%dms, Moves=%d, Overshoot=%.2fms (mean) %.2fms (max)\n",
+              byoyomi, num_moves, mean_overshoot, max_overshoot);
+  result->AddSample("think overshoot (mean)", "ms", false, mean_overshoot);
+  result->AddSample("think overshoot (max)", "ms", false, max_overshoot);
+}
+
 /**
  * 定跡DBファイルを作成します.
  * @param output_dir_name 定跡データの出力先のディレクトリ名
+ * @param memory_limit    指し手の集計に使うメモリの上限（バイト単位、0であれば上限なし）
  */
-void CreateBook(const std::string& output_dir_name) {
+void CreateBook(const std::string& output_dir_name, const size_t memory_limit) {
   //
   // Step 1. 全戦型対応の定跡DBファイルを用意する
   //
-  Book default_book = Book::CreateBook(OpeningStrategy::all_strategies());
+  Book default_book = Book::CreateBook(OpeningStrategy::all_strategies(), memory_limit);
   default_book.WriteToFile((output_dir_name + "/00_全戦型.bin").c_str());
   std::printf("00_全戦型.bin is created!\n");
 
@@ -261,7 +1079,7 @@ void CreateBook(const std::string& output_dir_name) {
   //
   for (OpeningStrategy opening_strategy : OpeningStrategy::all_strategies()) {
     // 棋譜DBから定跡データを作る
-    Book book = Book::CreateBook(OpeningStrategySet(opening_strategy));
+    Book book = Book::CreateBook(OpeningStrategySet(opening_strategy), memory_limit);
 
     // ファイルに書き出す
     int book_id = opening_strategy.id() + 1; // 1から32まで
@@ -274,6 +1092,65 @@ void CreateBook(const std::string& output_dir_name) {
   }
 }
 
+/**
+ * 定跡DBファイルを圧縮形式に変換します.
+ * 変換後に、棋譜DBの各局面で、元の定跡と圧縮した定跡から同じ定跡手が得られることを確認します。
+ * @param input_file_name  変換元の定跡DBファイル
+ * @param output_file_name 圧縮形式の定跡DBファイルの出力先
+ */
+void CompressBook(const char* input_file_name, const char* output_file_name) {
+  // 1. 圧縮形式に変換する
+  Book original_book(input_file_name);
+  original_book.WriteCompressedFile(output_file_name);
+  Book compressed_book(output_file_name);
+  std::printf("Memory: original=%zu bytes, compressed=%zu bytes (%.1f%%)\n",
+              original_book.memory_size(), compressed_book.memory_size(),
+              100.0 * compressed_book.memory_size() / std::max<size_t>(original_book.memory_size(), 1));
+
+  // 2. 棋譜DBの局面で、両者から得られる定跡手を比較する
+  std::ifstream game_db_file(GameDatabase::kDefaultDatabaseFile);
+  GameDatabase game_db(game_db_file);
+  UsiOptions usi_options;
+  uint64_t num_positions = 0, num_book_moves = 0, num_mismatches = 0;
+  double original_time = 0.0, compressed_time = 0.0;
+  for (Game game; game_db.ReadOneGame(&game); ) {
+    Position pos = Position::CreateStartPosition();
+    for (size_t ply = 0; ply < game.moves.size() && ply < 60; ++ply) {
+      // １回の呼び出しはミリ秒よりずっと短いので、SimpleTimerではなくsteady_clockで直接測る
+      auto t0 = std::chrono::steady_clock::now();
+      BookMoves original_moves = original_book.GetBookMoves(pos, usi_options);
+      auto t1 = std::chrono::steady_clock::now();
+      BookMoves compressed_moves = compressed_book.GetBookMoves(pos, usi_options);
+      auto t2 = std::chrono::steady_clock::now();
+      original_time += std::chrono::duration<double>(t1 - t0).count();
+      compressed_time += std::chrono::duration<double>(t2 - t1).count();
+
+      bool match = original_moves.size() == compressed_moves.size();
+      for (size_t i = 0; match && i < original_moves.size(); ++i) {
+        const BookMove& lhs = original_moves[i];
+        const BookMove& rhs = compressed_moves[i];
+        match = lhs.move == rhs.move && lhs.importance == rhs.importance
+             && lhs.frequency == rhs.frequency && lhs.win_count == rhs.win_count
+             && lhs.score == rhs.score && lhs.opening == rhs.opening;
+      }
+      num_positions += 1;
+      num_book_moves += original_moves.size();
+      num_mismatches += !match;
+
+      Move move = game.moves[ply];
+      if (!pos.MoveIsLegal(move)) {
+        break;
+      }
+      pos.MakeMove(move);
+    }
+  }
+  std::printf("Positions=%" PRIu64 " BookMoves=%" PRIu64 " Mismatches=%" PRIu64 "\n",
+              num_positions, num_book_moves, num_mismatches);
+  std::printf("Probe: original=%.2fus, compressed=%.2fus\n",
+              1e6 * original_time / std::max<uint64_t>(num_positions, 1),
+              1e6 * compressed_time / std::max<uint64_t>(num_positions, 1));
+}
+
 /**
  * 棋譜DBファイルの統計データを計算して、画面に表示します.
  * @param event_name 統計データを取得する対象の棋戦名（例："名人戦"など）
@@ -482,6 +1359,33 @@ void ComputePlayerRatings() {
   }
 }
 
+/**
+ * エンジンの各テーブルのメモリ使用量を表示します.
+ * @param num_threads    探索スレッド数（0以下ならば、USIオプションの初期値を用いる）
+ * @param hash_megabytes 置換表の大きさ（0以下ならば、USIオプションの初期値を用いる）
+ */
+void ReportMemoryUsage(int num_threads, int hash_megabytes) {
+  UsiOptions usi_options;
+  if (num_threads > 0) {
+    usi_options["Threads"] = std::to_string(num_threads);
+  }
+  if (hash_megabytes > 0) {
+    usi_options["USI_Hash"] = std::to_string(hash_megabytes);
+  }
+  std::printf("Threads=%d, USI_Hash=%dMB\n", int(usi_options["Threads"]),
+              int(usi_options["USI_Hash"]));
+
+  // 思考部を初期化して、各テーブルを確保する
+  Thinking thinking(usi_options);
+  thinking.Initialize();
+
+  // メモリ使用量を表示する
+  MemoryReport report;
+  thinking.ReportMemoryUsage(&report);
+  report.Print();
+  LargePageAllocator::Print();
+}
+
 } // namespace
 
 #endif // !defined(MINIMUM)
@@ -32,10 +32,14 @@ class Cli {
    * @param argv main()関数に渡された引数
    *
    * コマンドの一覧：
-   *   - --bench              探索のベンチマークを行う
+   *   - --bench              探索のベンチマークを行う（引数：[探索秒数]）
    *   - --bench-movegen      指し手生成のベンチマークテストを行う
    *   - --bench-mate1        １手詰関数のベンチマークテストを行う
    *   - --bench-mate3        ３手詰関数のベンチマークテストを行う
+   *   - --bench-eval         評価関数（全計算・差分計算）のベンチマークテストを行う
+   *   - --bench-perft        perftによる指し手生成・局面更新のベンチマークテストを行う（引数：[深さ]）
+   *   - --bench-compare      ２つのベンチマーク結果（JSON）を比較し、性能の劣化を検出する
+   *                          （引数：<基準.json> <比較対象.json> [許容範囲%]）
    *   - --cluster            疎結合並列探索（GPS将棋風クラスタ）のマスターを起動する
    *   - --compute-all-quiets すべてのquiet movesを列挙する
    *   - --consultation       合議アルゴリズムを用いたクラスタのマスターを起動する
@@ -45,8 +49,19 @@ class Cli {
    *   - --learn-progress     進行度推定関数の学習を行う
    *   - --learn-probability  指し手の実現確率の学習を行う
    *   - --compute-ratings    棋譜DBファイルに登場するプレイヤーのレーティングを計算する
+   *   - --mem-report         各テーブルのメモリ使用量を表示する（引数：[スレッド数] [置換表のMB数]）
+   *   - --match              ２つのエンジンを連続対局させ、レーティング差を測定する
+   *                          （引数：<エンジン1> <エンジン2> [オプション]。詳細はmatch.hを参照）
+   *
+   * ベンチマーク用のオプション：
+   *   - --perf               ハードウェア・パフォーマンス・カウンタの計測結果も表示する（Linuxのみ）
+   *   - --trials N           ベンチマークをN回繰り返し、平均値と95%信頼区間を表示する
+   *   - --json FILE          ベンチマーク結果をJSON形式でファイルに保存する
+   *
+   * @return 終了コード（--bench-compareで性能の劣化が検出された場合や、
+   *         --matchのSPRTでエンジン1の方が弱いと判定された場合は、0以外）
    */
-  static void ExecuteCommand(int argc, char* argv[]);
+  static int ExecuteCommand(int argc, char* argv[]);
 };
 
 #endif /* CLI_H_ */
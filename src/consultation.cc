@@ -364,6 +364,7 @@ void Consultation::UpdateInfo() {
   // 時間管理に必要な情報をTimeManagerに送る
   if (best_vote != votes.end()) {
     time_manager_.stats().agreement_rate = best_vote->second.count / double(num_workers_);
+    time_manager_.NotifyDeadlineChanged();
   }
 }
 
@@ -0,0 +1,94 @@
+/*
+ * 技巧 (Gikou), a USI shogi (Japanese chess) playing engine.
+ * Copyright (C) 2016-2017 Yosuke Demura
+ * except where otherwise indicated.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "engine.h"
+
+#include <cassert>
+#include <cstdio>
+#include <mutex>
+#include "bitboard.h"
+#include "evaluation.h"
+#include "extended_board.h"
+#include "huffman_code.h"
+#include "mate1ply.h"
+#include "mate_pattern.h"
+#include "material.h"
+#include "move_probability.h"
+#include "progress.h"
+#include "psq.h"
+#include "search.h"
+#include "square.h"
+#include "zobrist.h"
+
+void Engine::Init() {
+  static std::once_flag once_flag;
+  std::call_once(once_flag, []() {
+    Square::Init();
+    Bitboard::Init();
+    ExtendedBoard::Init();
+    Zobrist::Init();
+    HuffmanCode::Init();
+    InitMateInOnePly();
+    MatePatternTable::Init();
+    Search::Init();
+    PsqPair::Init();
+    Progress::ReadWeightsFromFile();
+    Evaluation::Init();
+    Material::Init();
+    MoveProbability::Init();
+  });
+}
+
+Engine::Engine()
+    : thinking_(usi_options_) {
+  // 標準出力には何も出力しないようにするため、何もしないコールバック関数を設定しておく
+  set_info_callback(nullptr);
+}
+
+void Engine::Initialize(const char* const params_file) {
+  // 評価パラメータは全Engineで共有されるので、最初に指定されたファイルのみを読み込む
+  // （他のEngineが探索中の可能性があるので、後から別のファイルを読み直すことはしない）
+  static std::mutex mutex;
+  static std::string loaded_file;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (loaded_file.empty()) {
+      Evaluation::ReadParametersFromFile(params_file);
+      loaded_file = params_file;
+    } else if (loaded_file != params_file) {
+      std::fprintf(stderr, "Engine: %s is ignored because %s has already been loaded.\n",
+                   params_file, loaded_file.c_str());
+      assert(false);
+    }
+  }
+  thinking_.Initialize();
+}
+
+ThinkingResult Engine::Search(const Node& root, const UsiGoOptions& limits) {
+  thinking_.ResetSignals();
+  return thinking_.Think(root, limits);
+}
+
+void Engine::set_info_callback(const InfoCallback& callback) {
+  if (callback) {
+    thinking_.set_info_callback(callback);
+  } else {
+    thinking_.set_info_callback([](const SearchInfo&) {});
+  }
+}
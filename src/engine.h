@@ -0,0 +1,129 @@
+/*
+ * 技巧 (Gikou), a USI shogi (Japanese chess) playing engine.
+ * Copyright (C) 2016-2017 Yosuke Demura
+ * except where otherwise indicated.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENGINE_H_
+#define ENGINE_H_
+
+#include <functional>
+#include <string>
+#include "node.h"
+#include "shared_data.h"
+#include "thinking.h"
+#include "usi.h"
+#include "usi_protocol.h"
+
+/**
+ * 技巧を、他のプログラムから直接呼び出すためのクラスです.
+ *
+ * USIプロトコルのテキストをパイプ経由でやり取りする代わりに、関数呼び出しで探索を行うので、
+ * 解析ツールや教師データの生成ツールなどで、大量の局面を高速に探索させたい場合に使用します。
+ * 探索の途中経過はコールバック関数で受け取ることができ、標準出力には何も出力されません。
+ *
+ * 使用例：
+ * @code
+ * Engine::Init();
+ * Engine engine;
+ * engine.SetOption("Threads", "1");
+ * engine.Initialize();
+ * UsiGoOptions limits;
+ * limits.depth = 8;
+ * ThinkingResult result = engine.Search(Position::CreateStartPosition(), limits);
+ * std::printf("%s %d\n", result.best_move.ToSfen().c_str(), int(result.score));
+ * @endcode
+ *
+ * ライブラリとしてビルドするには、"make library"を実行してください（bin/libgikou.aと
+ * bin/libgikou.soが作成されます）。
+ */
+class Engine {
+ public:
+  typedef std::function<void(const SearchInfo&)> InfoCallback;
+
+  /**
+   * 盤面や評価関数などの、プロセス全体で共有されるテーブルを初期化します.
+   * Engineオブジェクトを作成する前に、必ず１回呼んでください（２回目以降の呼び出しは無視されます）。
+   */
+  static void Init();
+
+  Engine();
+
+  /**
+   * USIオプションを設定します（USIのsetoptionコマンドに相当）.
+   * Initialize()を呼ぶ前に設定してください。
+   */
+  void SetOption(const std::string& name, const std::string& value) {
+    usi_options_[name] = value;
+  }
+
+  /**
+   * USIオプションを返します.
+   */
+  const UsiOptions& options() const {
+    return usi_options_;
+  }
+
+  /**
+   * 評価関数の読み込みや、置換表の確保を行います（USIのisreadyコマンドに相当）.
+   * 評価関数のパラメータはプロセス全体で共有されるため、ファイルの読み込みは最初の１回だけ行われます。
+   * 最初の呼び出しと異なるファイルを指定することはできません（開発版ではassertに失敗し、
+   * リリース版では警告を表示したうえで、最初に読み込んだパラメータを使い続けます）。
+   * @param params_file 評価関数のパラメータファイル（プロセス内で、１種類のみ指定可能）
+   */
+  void Initialize(const char* params_file = "params.bin");
+
+  /**
+   * 新しい対局を開始します（USIのusinewgameコマンドに相当）.
+   */
+  void NewGame() {
+    thinking_.StartNewGame();
+  }
+
+  /**
+   * 探索を行い、最善手を求めます.
+   * @param root   探索を行う局面（千日手の検出に、それまでの手順を用いたい場合は、Nodeを渡してください）
+   * @param limits 探索の制限（時間、深さ、ノード数など）
+   * @return 探索結果
+   */
+  ThinkingResult Search(const Node& root, const UsiGoOptions& limits);
+
+  /**
+   * 探索中のエンジンに対し、探索を停止するよう指示します（別スレッドから呼び出します）.
+   */
+  void Stop() {
+    thinking_.StopThinking();
+  }
+
+  /**
+   * 探索の途中経過を受け取るコールバック関数を設定します.
+   * コールバック関数は、探索スレッドから呼び出されます。
+   */
+  void set_info_callback(const InfoCallback& callback);
+
+  /**
+   * 直前の探索で、全スレッドが探索したノード数の合計を返します.
+   */
+  uint64_t last_num_nodes_searched() const {
+    return thinking_.last_num_nodes_searched();
+  }
+
+ private:
+  UsiOptions usi_options_;
+  Thinking thinking_;
+};
+
+#endif /* ENGINE_H_ */
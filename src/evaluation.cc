@@ -19,16 +19,40 @@
 
 #include "evaluation.h"
 
+#include <string>
+#include <vector>
+#include "common/array.h"
 #include "common/arraymap.h"
 #include "common/math.h"
 #include "material.h"
+#include "numa.h"
 #include "position.h"
 #include "progress.h"
 
-std::unique_ptr<EvalParameters> g_eval_params(new EvalParameters);
+LargePagePtr<EvalParameters> g_eval_params(
+    MakeRequiredLargePageObject<EvalParameters>("EvalParameters (g_eval_params)"));
+
+namespace {
+
+/**
+ * このスレッドで用いる評価パラメータです（nullptrの場合は、g_eval_paramsを用いる）.
+ */
+thread_local const EvalParameters* t_eval_params = nullptr;
+
+/**
+ * NUMAノードごとの、g_eval_paramsの複製です.
+ */
+std::vector<LargePagePtr<EvalParameters>> g_eval_replicas;
+
+inline const EvalParameters& eval_params() {
+  return t_eval_params != nullptr ? *t_eval_params : *g_eval_params;
+}
+
+} // namespace
 
 Score EvalDetail::ComputeFinalScore(Color side_to_move,
                                     double* const progress_output) const {
+  const EvalParameters& params = eval_params();
 
   PackedScore kp_total = kp[kBlack] + kp[kWhite];
   PackedScore others = controls + two_pieces + king_safety + sliders;
@@ -55,12 +79,12 @@ Score EvalDetail::ComputeFinalScore(Color side_to_move,
     int64_t opening     = -2 * progress + 1 * kScale;
     int64_t middle_game = +2 * progress             ;
     sum += (opening * kp_total[0]) + (middle_game * kp_total[1]);
-    tempo = (opening * g_eval_params->tempo[0]) + (middle_game * g_eval_params->tempo[1]);
+    tempo = (opening * params.tempo[0]) + (middle_game * params.tempo[1]);
   } else {
     int64_t middle_game = -2 * progress + 2 * kScale;
     int64_t end_game    = +2 * progress - 1 * kScale;
     sum += (middle_game * kp_total[1]) + (end_game * kp_total[2]);
-    tempo = (middle_game * g_eval_params->tempo[1]) + (end_game * g_eval_params->tempo[2]);
+    tempo = (middle_game * params.tempo[1]) + (end_game * params.tempo[2]);
   }
 
   // 3. KP以外のパラメータについて内分を取る
@@ -116,18 +140,19 @@ inline PackedScore FlipScores2x2(PackedScore s) {
 /**
  * 特定の１駒について、位置評価の合計値を計算します.
  */
-inline EvalDetail SumPositionalScore(const PsqPair psq, const PsqList& list,
+inline EvalDetail SumPositionalScore(const EvalParameters& params,
+                                     const PsqPair psq, const PsqList& list,
                                      const Position& pos) {
   // 1. KP
   Square bk = pos.king_square(kBlack);
   Square wk = Square::rotate180(pos.king_square(kWhite));
-  PackedScore kp_black = g_eval_params->king_piece[bk][psq.black()];
-  PackedScore kp_white = g_eval_params->king_piece[wk][psq.white()];
+  PackedScore kp_black = params.king_piece[bk][psq.black()];
+  PackedScore kp_white = params.king_piece[wk][psq.white()];
 
   // 2. PP
   PackedScore two_pieces(0);
   for (const PsqPair& i : list) {
-    two_pieces += g_eval_params->two_pieces[psq.black()][i.black()];
+    two_pieces += params.two_pieces[psq.black()][i.black()];
   }
 
   EvalDetail sum;
@@ -141,25 +166,26 @@ inline EvalDetail SumPositionalScore(const PsqPair psq, const PsqList& list,
 /**
  * 特定の２駒について、位置評価の合計値を計算します.
  */
-inline EvalDetail SumPositionalScore(const PsqPair psq1, const PsqPair psq2,
+inline EvalDetail SumPositionalScore(const EvalParameters& params,
+                                     const PsqPair psq1, const PsqPair psq2,
                                      const PsqList& list, const Position& pos) {
   // 1. KP
   Square bk = pos.king_square(kBlack);
   Square wk = Square::rotate180(pos.king_square(kWhite));
-  PackedScore kp_black = g_eval_params->king_piece[bk][psq1.black()]
-                       + g_eval_params->king_piece[bk][psq2.black()];
-  PackedScore kp_white = g_eval_params->king_piece[wk][psq1.white()]
-                       + g_eval_params->king_piece[wk][psq2.white()];
+  PackedScore kp_black = params.king_piece[bk][psq1.black()]
+                       + params.king_piece[bk][psq2.black()];
+  PackedScore kp_white = params.king_piece[wk][psq1.white()]
+                       + params.king_piece[wk][psq2.white()];
 
   // 2. PP
   PackedScore two_pieces(0);
   for (const PsqPair& i : list) {
-    two_pieces += g_eval_params->two_pieces[psq1.black()][i.black()];
-    two_pieces += g_eval_params->two_pieces[psq2.black()][i.black()];
+    two_pieces += params.two_pieces[psq1.black()][i.black()];
+    two_pieces += params.two_pieces[psq2.black()][i.black()];
   }
 
   // 3. PP計算で重複して加算されてしまった部分を補正する
-  two_pieces -= g_eval_params->two_pieces[psq1.black()][psq2.black()];
+  two_pieces -= params.two_pieces[psq1.black()][psq2.black()];
 
   EvalDetail sum;
   sum.kp[kBlack] = kp_black;
@@ -172,7 +198,8 @@ inline EvalDetail SumPositionalScore(const PsqPair psq1, const PsqPair psq2,
 /**
  * すべての駒について、位置評価の評価値を計算します.
  */
-inline EvalDetail EvaluatePositionalAdvantage(const Position& pos,
+inline EvalDetail EvaluatePositionalAdvantage(const EvalParameters& params,
+                                              const Position& pos,
                                               const PsqList& list) {
   const Square bk = pos.king_square(kBlack);
   const Square wk = Square::rotate180(pos.king_square(kWhite));
@@ -180,11 +207,11 @@ inline EvalDetail EvaluatePositionalAdvantage(const Position& pos,
   PackedScore kp_black(0), kp_white(0), two_pieces(0);
   for (const PsqPair* i = list.begin(); i != list.end(); ++i) {
     // 1. KP
-    kp_black += g_eval_params->king_piece[bk][i->black()];
-    kp_white += g_eval_params->king_piece[wk][i->white()];
+    kp_black += params.king_piece[bk][i->black()];
+    kp_white += params.king_piece[wk][i->white()];
     // 2. PP
     for (const PsqPair* j = list.begin(); j <= i; ++j) {
-      two_pieces += g_eval_params->two_pieces[i->black()][j->black()];
+      two_pieces += params.two_pieces[i->black()][j->black()];
     }
   }
 
@@ -202,7 +229,8 @@ inline EvalDetail EvaluatePositionalAdvantage(const Position& pos,
  * （参考文献）
  *   - 竹内章: 習甦の誕生, 『人間に勝つコンピュータ将棋の作り方』, pp.171-190, 技術評論社, 2012.
  */
-PackedScore EvaluateControls(const Position& pos, const PsqControlList& list) {
+PackedScore EvaluateControls(const EvalParameters& params, const Position& pos,
+                             const PsqControlList& list) {
   PackedScore sum(0);
   const Square bk = pos.king_square(kBlack);
   const Square wk = pos.king_square(kWhite);
@@ -210,12 +238,12 @@ PackedScore EvaluateControls(const Position& pos, const PsqControlList& list) {
   for (const Square s : Square::all_squares()) {
     PsqControlIndex index = list[s];
     // 1. 先手玉との関係
-    sum += g_eval_params->controls[kBlack][bk][index];
+    sum += params.controls[kBlack][bk][index];
     // 2. 後手玉との関係
     // 注：KPとは異なり、インデックスの反転処理に時間がかかるため、インデックスと符号の反転処理は行わず、
     // 先手玉用・後手玉用の２つのテーブルを用意することで対応している。
     // その代わり、次元下げを行う段階で、インデックスと符号の反転処理を行っている。
-    sum += g_eval_params->controls[kWhite][wk][index];
+    sum += params.controls[kWhite][wk][index];
   }
 
   return sum;
@@ -224,10 +252,10 @@ PackedScore EvaluateControls(const Position& pos, const PsqControlList& list) {
 /**
  * 各マスの利きについて、評価値を差分計算します.
  */
-PackedScore EvaluateDifferenceOfControls(const Position& pos,
+PackedScore EvaluateDifferenceOfControls(const EvalParameters& params,
+                                         const Position& pos,
                                          const PsqControlList& previous_list,
                                          const PsqControlList& current_list) {
-
   PackedScore diff(0);
   const Square bk = pos.king_square(kBlack);
   const Square wk = pos.king_square(kWhite);
@@ -239,12 +267,12 @@ PackedScore EvaluateDifferenceOfControls(const Position& pos,
   difference.ForEach([&](Square sq) {
     // 1. 古い特徴を削除する
     PsqControlIndex old_index = previous_list[sq];
-    diff -= g_eval_params->controls[kBlack][bk][old_index];
-    diff -= g_eval_params->controls[kWhite][wk][old_index];
+    diff -= params.controls[kBlack][bk][old_index];
+    diff -= params.controls[kWhite][wk][old_index];
     // 2. 新しい特徴を追加する
     PsqControlIndex new_index = current_list[sq];
-    diff += g_eval_params->controls[kBlack][bk][new_index];
-    diff += g_eval_params->controls[kWhite][wk][new_index];
+    diff += params.controls[kBlack][bk][new_index];
+    diff += params.controls[kWhite][wk][new_index];
   });
 
   return diff;
@@ -268,7 +296,7 @@ PackedScore EvaluateDifferenceOfControls(const Position& pos,
  *     共立出版, 2005.
  */
 template<Color kKingColor, bool kMirrorHorizontally>
-FORCE_INLINE PackedScore EvaluateKingSafety(const Position& pos) {
+FORCE_INLINE PackedScore EvaluateKingSafety(const EvalParameters& params, const Position& pos) {
   assert(pos.king_square(kKingColor).relative_square(kKingColor).file() >= kFile5 || kMirrorHorizontally);
 
   const Square ksq = pos.king_square(kKingColor);
@@ -309,7 +337,7 @@ FORCE_INLINE PackedScore EvaluateKingSafety(const Position& pos) {
     int attackers = attacks.at(dir_m);
     int defenders = defenses.at(dir_m);
     // テーブルから評価値を参照する
-    return g_eval_params->king_safety[hs][dir][piece][attackers][defenders];
+    return params.king_safety[hs][dir][piece][attackers][defenders];
   };
 
   // 5. 玉の周囲8マスについて、玉の安全度評価の合計値を求める
@@ -328,19 +356,19 @@ FORCE_INLINE PackedScore EvaluateKingSafety(const Position& pos) {
 }
 
 template<Color kKingColor>
-PackedScore EvaluateKingSafety(const Position& pos) {
+PackedScore EvaluateKingSafety(const EvalParameters& params, const Position& pos) {
   // 玉が右側にいる場合は、左右反転させて、将棋盤の左側にあるものとして評価する
   // これにより、「玉の左か右か」という観点でなく、「盤の端か中央か」という観点での評価を行うことができる
   if (pos.king_square(kKingColor).relative_square(kKingColor).file() <= kFile4) {
-    return EvaluateKingSafety<kKingColor, true>(pos);
+    return EvaluateKingSafety<kKingColor, true>(params, pos);
   } else {
-    return EvaluateKingSafety<kKingColor, false>(pos);
+    return EvaluateKingSafety<kKingColor, false>(params, pos);
   }
 }
 
-inline PackedScore EvaluateKingSafety(const Position& pos) {
-  PackedScore score_black = EvaluateKingSafety<kBlack>(pos);
-  PackedScore score_white = EvaluateKingSafety<kWhite>(pos);
+inline PackedScore EvaluateKingSafety(const EvalParameters& params, const Position& pos) {
+  PackedScore score_black = EvaluateKingSafety<kBlack>(params, pos);
+  PackedScore score_white = EvaluateKingSafety<kWhite>(params, pos);
   return score_black + score_white;
 }
 
@@ -352,7 +380,7 @@ inline PackedScore EvaluateKingSafety(const Position& pos) {
  *     http://www.computer-shogi.org/wcsc25/appeal/NineDayFever/NDF-2015.txt, 2015.
  */
 template<Color kColor>
-FORCE_INLINE PackedScore EvaluateSlidingPieces(const Position& pos) {
+FORCE_INLINE PackedScore EvaluateSlidingPieces(const EvalParameters& params, const Position& pos) {
   PackedScore sum(0);
 
   Square own_ksq = pos.king_square(kColor);
@@ -376,9 +404,9 @@ FORCE_INLINE PackedScore EvaluateSlidingPieces(const Position& pos) {
         to = Square::rotate180(to);
         if (threatened != kNoPiece) threatened = threatened.opponent_piece();
       }
-      sum += g_eval_params->rook_control[kBlack][own_ksq][from][to];
-      sum += g_eval_params->rook_control[kWhite][opp_ksq][from][to];
-      sum += g_eval_params->rook_threat[opp_ksq][to][threatened];
+      sum += params.rook_control[kBlack][own_ksq][from][to];
+      sum += params.rook_control[kWhite][opp_ksq][from][to];
+      sum += params.rook_threat[opp_ksq][to][threatened];
     });
   });
 
@@ -397,9 +425,9 @@ FORCE_INLINE PackedScore EvaluateSlidingPieces(const Position& pos) {
         to = Square::rotate180(to);
         if (threatened != kNoPiece) threatened = threatened.opponent_piece();
       }
-      sum += g_eval_params->bishop_control[kBlack][own_ksq][from][to];
-      sum += g_eval_params->bishop_control[kWhite][opp_ksq][from][to];
-      sum += g_eval_params->bishop_threat[opp_ksq][to][threatened];
+      sum += params.bishop_control[kBlack][own_ksq][from][to];
+      sum += params.bishop_control[kWhite][opp_ksq][from][to];
+      sum += params.bishop_threat[opp_ksq][to][threatened];
     });
   });
 
@@ -416,25 +444,26 @@ FORCE_INLINE PackedScore EvaluateSlidingPieces(const Position& pos) {
         to = Square::rotate180(to);
         if (threatened != kNoPiece) threatened = threatened.opponent_piece();
       }
-      sum += g_eval_params->lance_control[kBlack][own_ksq][from][to];
-      sum += g_eval_params->lance_control[kWhite][opp_ksq][from][to];
-      sum += g_eval_params->lance_threat[opp_ksq][to][threatened];
+      sum += params.lance_control[kBlack][own_ksq][from][to];
+      sum += params.lance_control[kWhite][opp_ksq][from][to];
+      sum += params.lance_threat[opp_ksq][to][threatened];
     }
   });
 
   return kColor == kBlack ? sum : FlipScores2x2(sum);
 }
 
-PackedScore EvaluateSlidingPieces(const Position& pos) {
-  PackedScore score_black = EvaluateSlidingPieces<kBlack>(pos);
-  PackedScore score_white = EvaluateSlidingPieces<kWhite>(pos);
+PackedScore EvaluateSlidingPieces(const EvalParameters& params, const Position& pos) {
+  PackedScore score_black = EvaluateSlidingPieces<kBlack>(params, pos);
+  PackedScore score_white = EvaluateSlidingPieces<kWhite>(params, pos);
   return score_black + score_white;
 }
 
 /**
  * 評価関数の差分計算を行います（玉の移動手の場合）.
  */
-EvalDetail EvaluateDifferenceForKingMove(const Position& pos,
+EvalDetail EvaluateDifferenceForKingMove(const EvalParameters& params,
+                                         const Position& pos,
                                          const EvalDetail& previous_eval,
                                          PsqList* const list) {
   assert(list != nullptr);
@@ -452,14 +481,14 @@ EvalDetail EvaluateDifferenceForKingMove(const Position& pos,
     Piece captured = move.captured_piece();
     // a. KP・PPスコアから古い特徴を除外する
     PsqPair old_psq = PsqPair::OfBoard(captured, to);
-    diff -= SumPositionalScore(old_psq, *list, pos);
+    diff -= SumPositionalScore(params, old_psq, *list, pos);
     // b. インデックスリストを更新する
     list->MakeMove(move);
     // c. KP・PPスコアに新しい特徴を追加する
     PieceType hand_type = captured.hand_type();
     int num = pos.hand(king_color).count(hand_type);
     PsqPair new_psq = PsqPair::OfHand(king_color, hand_type, num);
-    diff += SumPositionalScore(new_psq, *list, pos);
+    diff += SumPositionalScore(params, new_psq, *list, pos);
   }
 
   // 2. 移動した玉に関するKPスコアを再計算する
@@ -467,13 +496,13 @@ EvalDetail EvaluateDifferenceForKingMove(const Position& pos,
   if (king_color == kBlack) {
     Square king_square = to;
     for (const PsqPair& i : *list) {
-      sum_of_kp += g_eval_params->king_piece[king_square][i.black()];
+      sum_of_kp += params.king_piece[king_square][i.black()];
     }
     diff.kp[kBlack] = sum_of_kp - previous_eval.kp[kBlack];
   } else {
     Square king_square = Square::rotate180(to);
     for (const PsqPair& i : *list) {
-      sum_of_kp += g_eval_params->king_piece[king_square][i.white()];
+      sum_of_kp += params.king_piece[king_square][i.white()];
     }
     diff.kp[kWhite] = FlipScores3x1(sum_of_kp) - previous_eval.kp[kWhite];
   }
@@ -484,7 +513,8 @@ EvalDetail EvaluateDifferenceForKingMove(const Position& pos,
 /**
  * 評価関数の差分計算を行います（玉の移動手以外の手を指した場合）.
  */
-EvalDetail EvaluateDifferenceForNonKingMove(const Position& pos,
+EvalDetail EvaluateDifferenceForNonKingMove(const EvalParameters& params,
+                                            const Position& pos,
                                             PsqList* const list) {
   assert(list != nullptr);
   assert(pos.last_move().piece_type() != kKing);
@@ -501,19 +531,19 @@ EvalDetail EvaluateDifferenceForNonKingMove(const Position& pos,
     // 1. 古い特徴を除外する
     int num = pos.hand(side_to_move).count(pt) + 1;
     PsqPair old_psq = PsqPair::OfHand(side_to_move, pt, num);
-    diff -= SumPositionalScore(old_psq, *list, pos);
+    diff -= SumPositionalScore(params, old_psq, *list, pos);
     // 2. インデックスリストを更新する
     list->MakeMove(move);
     // 3. 新しい特徴を追加する
     PsqPair new_psq = PsqPair::OfBoard(piece, to);
-    diff += SumPositionalScore(new_psq, *list, pos);
+    diff += SumPositionalScore(params, new_psq, *list, pos);
   } else if (move.is_capture()) {
     Piece captured = move.captured_piece();
     Square from = move.from();
     // 1. 古い特徴を除外する
     PsqPair old_psq1 = PsqPair::OfBoard(piece, from);
     PsqPair old_psq2 = PsqPair::OfBoard(captured, to);
-    diff -= SumPositionalScore(old_psq1, old_psq2, *list, pos);
+    diff -= SumPositionalScore(params, old_psq1, old_psq2, *list, pos);
     // 2. インデックスリストを更新する
     list->MakeMove(move);
     // 3. 新しい特徴を追加する
@@ -521,22 +551,42 @@ EvalDetail EvaluateDifferenceForNonKingMove(const Position& pos,
     int num = pos.hand(side_to_move).count(hand_type);
     PsqPair new_psq1 = PsqPair::OfBoard(move.piece_after_move(), to);
     PsqPair new_psq2 = PsqPair::OfHand(side_to_move, hand_type, num);
-    diff += SumPositionalScore(new_psq1, new_psq2, *list, pos);
+    diff += SumPositionalScore(params, new_psq1, new_psq2, *list, pos);
   } else {
     Square from = move.from();
     // 1. 古い特徴を除外する
     PsqPair old_psq = PsqPair::OfBoard(piece, from);
-    diff -= SumPositionalScore(old_psq, *list, pos);
+    diff -= SumPositionalScore(params, old_psq, *list, pos);
     // 2. インデックスリストを更新する
     list->MakeMove(move);
     // 3. 新しい特徴を増加する
     PsqPair new_psq = PsqPair::OfBoard(move.piece_after_move(), to);
-    diff += SumPositionalScore(new_psq, *list, pos);
+    diff += SumPositionalScore(params, new_psq, *list, pos);
   }
 
   return diff;
 }
 
+/**
+ * 評価パラメータのテーブルを、要素ごとに混合します.
+ * @param other   混合するテーブル
+ * @param weights 各要素の４個の値それぞれについての、混合する側の比率（パーセント単位）
+ * @param table   混合されるテーブル
+ */
+template<typename T>
+void BlendTable(const T& other, const Array<int64_t, 4>& weights, T* const table) {
+  static_assert(sizeof(T) % sizeof(PackedScore) == 0, "");
+  const size_t size = sizeof(T) / sizeof(PackedScore);
+  const PackedScore* src = reinterpret_cast<const PackedScore*>(&other);
+  PackedScore* dst = reinterpret_cast<PackedScore*>(table);
+  for (size_t i = 0; i < size; ++i) {
+    for (size_t j = 0; j < 4; ++j) {
+      int64_t blended = (100 - weights[j]) * dst[i][j] + weights[j] * src[i][j];
+      dst[i][j] = static_cast<int32_t>(blended / 100);
+    }
+  }
+}
+
 } // namespace
 
 Score Evaluation::Evaluate(const Position& pos) {
@@ -556,18 +606,21 @@ EvalDetail Evaluation::EvaluateAll(const Position& pos,
     return sum;
   }
 
+  // 評価パラメータは、スレッドごとに切り替わりうるので、最初に一度だけ読み出しておく
+  const EvalParameters& params = eval_params();
+
   // 1. 駒の位置評価
-  sum += EvaluatePositionalAdvantage(pos, psq_list);
+  sum += EvaluatePositionalAdvantage(params, pos, psq_list);
 
   // 2. 各マスの利き
   PsqControlList psq_control_list = pos.extended_board().GetPsqControlList();
-  sum.controls = EvaluateControls(pos, psq_control_list);
+  sum.controls = EvaluateControls(params, pos, psq_control_list);
 
   // 3. 玉の安全度
-  sum.king_safety = EvaluateKingSafety(pos);
+  sum.king_safety = EvaluateKingSafety(params, pos);
 
   // 4. 飛車・角・香車の利き
-  sum.sliders = EvaluateSlidingPieces(pos);
+  sum.sliders = EvaluateSlidingPieces(params, pos);
 
   return sum;
 }
@@ -596,26 +649,29 @@ EvalDetail Evaluation::EvaluateDifference(const Position& pos,
   }
 #endif
 
+  // 評価パラメータは、スレッドごとに切り替わりうるので、最初に一度だけ読み出しておく
+  const EvalParameters& params = eval_params();
+
   // 1. 駒の位置評価と、各マスの利き評価（差分計算）
   if (pos.last_move().piece().is(kKing)) {
     // a. 駒の位置評価
-    diff = EvaluateDifferenceForKingMove(pos, previous_eval, psq_list);
+    diff = EvaluateDifferenceForKingMove(params, pos, previous_eval, psq_list);
     // b. 各マスの利き評価（ここについては、再計算）
-    diff.controls = EvaluateControls(pos, current_list) - previous_eval.controls;
+    diff.controls = EvaluateControls(params, pos, current_list) - previous_eval.controls;
   } else {
     // a. 駒の位置評価
-    diff = EvaluateDifferenceForNonKingMove(pos, psq_list);
+    diff = EvaluateDifferenceForNonKingMove(params, pos, psq_list);
     // b. 各マスの利き評価
-    diff.controls = EvaluateDifferenceOfControls(pos, previous_list, current_list);
+    diff.controls = EvaluateDifferenceOfControls(params, pos, previous_list, current_list);
   }
   // 差分計算の途中で、PsqListの差分計算が正しく行われたかをチェック
   assert(PsqList::TwoListsHaveSameItems(*psq_list, PsqList(pos)));
 
   // 2. 玉の安全度（末端評価）
-  diff.king_safety = EvaluateKingSafety(pos) - previous_eval.king_safety;
+  diff.king_safety = EvaluateKingSafety(params, pos) - previous_eval.king_safety;
 
   // 3. 飛車・角・香車の利き（末端評価）
-  diff.sliders = EvaluateSlidingPieces(pos) - previous_eval.sliders;
+  diff.sliders = EvaluateSlidingPieces(params, pos) - previous_eval.sliders;
 
   return diff;
 }
@@ -625,16 +681,108 @@ void Evaluation::Init() {
 }
 
 void Evaluation::ReadParametersFromFile(const char* file_name) {
+  ReadParametersFromFile(file_name, g_eval_params.get());
+}
+
+bool Evaluation::ReadParametersFromFile(const char* file_name,
+                                        EvalParameters* const params) {
+  assert(params != nullptr);
+
   // Read parameters from file.
   std::FILE* fp = std::fopen(file_name, "rb");
   if (fp == nullptr) {
     std::printf("info string Failed to open %s.\n", file_name);
-    return;
+    return false;
   }
-  if (std::fread(g_eval_params.get(), sizeof(EvalParameters), 1, fp) != 1) {
+  if (std::fread(params, sizeof(EvalParameters), 1, fp) != 1) {
     std::printf("info string Failed to read %s.\n", file_name);
     std::fclose(fp);
-    return;
+    return false;
   }
   std::fclose(fp);
+  return true;
+}
+
+void Evaluation::BlendParameters(const EvalParameters& other,
+                                 const EvalEnsembleWeights& weights,
+                                 EvalParameters* const params) {
+  assert(params != nullptr);
+  assert(0 <= weights.opening_component && weights.opening_component <= 100);
+  assert(0 <= weights.middle_game_component && weights.middle_game_component <= 100);
+  assert(0 <= weights.end_game_component && weights.end_game_component <= 100);
+
+  // KPと手番の重みは、序盤・中盤・終盤・進行度計算用の重み（進行度は混合しない）
+  const Array<int64_t, 4> weights_3x1 = {
+      weights.opening_component, weights.middle_game_component,
+      weights.end_game_component, 0
+  };
+  // KP以外の重みは、序盤・手番（序盤用）・終盤・手番（終盤用）
+  const Array<int64_t, 4> weights_2x2 = {
+      weights.opening_component, weights.opening_component,
+      weights.end_game_component, weights.end_game_component
+  };
+
+  // 1. 駒の価値（進行度によらないので、中盤の比率を用いる）
+  for (PieceType pt : Piece::all_piece_types()) {
+    int64_t blended = (100 - weights.middle_game_component) * int64_t(params->material[pt])
+                    + weights.middle_game_component * int64_t(other.material[pt]);
+    params->material[pt] = static_cast<Score>(blended / 100);
+  }
+
+  // 2. ２駒の位置関係
+  BlendTable(other.king_piece, weights_3x1, &params->king_piece);
+  BlendTable(other.two_pieces, weights_2x2, &params->two_pieces);
+
+  // 3. 各マスの利き
+  BlendTable(other.controls, weights_2x2, &params->controls);
+
+  // 4. 玉の安全度
+  BlendTable(other.king_safety, weights_2x2, &params->king_safety);
+
+  // 5. 飛車・角・香車の利き
+  BlendTable(other.rook_control, weights_2x2, &params->rook_control);
+  BlendTable(other.bishop_control, weights_2x2, &params->bishop_control);
+  BlendTable(other.lance_control, weights_2x2, &params->lance_control);
+  BlendTable(other.rook_threat, weights_2x2, &params->rook_threat);
+  BlendTable(other.bishop_threat, weights_2x2, &params->bishop_threat);
+  BlendTable(other.lance_threat, weights_2x2, &params->lance_threat);
+
+  // 6. 手番
+  BlendTable(other.tempo, weights_3x1, &params->tempo);
+}
+
+bool Evaluation::BlendParametersFromFile(const char* file_name,
+                                         const EvalEnsembleWeights& weights) {
+  std::unique_ptr<EvalParameters> other(new EvalParameters);
+  if (!ReadParametersFromFile(file_name, other.get())) {
+    return false;
+  }
+  BlendParameters(*other, weights, g_eval_params.get());
+  return true;
+}
+
+void Evaluation::SetThreadParameters(const EvalParameters* const params) {
+  t_eval_params = params;
+}
+
+void Evaluation::ReplicateParameters(const int num_replicas) {
+  g_eval_replicas.clear();
+  g_eval_replicas.resize(num_replicas);
+  for (int node = 0; node < num_replicas; ++node) {
+    // ノード上のスレッドで確保・コピーすることにより、ノードのローカルメモリに配置する
+    Numa::RunOnNode(node, [&]() {
+      const std::string name = "EvalParameters (NUMA node " + std::to_string(node) + ")";
+      g_eval_replicas[node] = MakeLargePageObject<EvalParameters>(name.c_str());
+      if (g_eval_replicas[node]) {
+        *g_eval_replicas[node] = *g_eval_params;
+      }
+    });
+  }
+}
+
+const EvalParameters* Evaluation::GetReplica(const int replica_id) {
+  if (replica_id < 0 || replica_id >= static_cast<int>(g_eval_replicas.size())) {
+    return nullptr;
+  }
+  return g_eval_replicas[replica_id].get();
 }
@@ -25,11 +25,13 @@
 #include "common/pack.h"
 #include "common/valarraykey.h"
 #include "hand.h"
+#include "large_page.h"
 #include "piece.h"
 #include "psq.h"
 #include "square.h"
 #include "types.h"
 class Position;
+struct EvalParameters;
 
 /**
  * 評価値のスケールです.
@@ -123,6 +125,22 @@ struct EvalDetail {
   PackedScore sliders{0};
 };
 
+/**
+ * ２種類の評価パラメータを混合（アンサンブル）する際の重みです.
+ * 各値は、評価パラメータの序盤・中盤・終盤の各成分について、混合する側の評価パラメータの比率を
+ * パーセント単位（0〜100）で表します。
+ *
+ * 混合はパラメータの成分ごとに行うので、局面の進行度に応じて２つの評価値を混合すること（フェーズブレンド）
+ * とは一致しません（比率がすべての成分で等しい場合にのみ一致します）。
+ * また、中盤の比率が反映されるのは、序盤・中盤・終盤の３成分を持つKPと手番、および進行度によらない駒割りだけです。
+ * それ以外の項目（PP、利き、玉の安全度、飛び駒）は序盤・終盤の２成分しか持たないため、中盤の比率は使われません。
+ */
+struct EvalEnsembleWeights {
+  int opening_component;
+  int middle_game_component;
+  int end_game_component;
+};
+
 /**
  * 評価値の計算を行うためのクラスです.
  */
@@ -135,6 +153,61 @@ class Evaluation {
 
   static void ReadParametersFromFile(const char* file_name);
 
+  /**
+   * ファイルから、指定された評価パラメータへ読み込みます.
+   * @param file_name 評価パラメータのファイル名
+   * @param params    読み込んだ評価パラメータを保存するためのポインタ
+   * @return 読み込みに成功した場合は、true
+   */
+  static bool ReadParametersFromFile(const char* file_name, EvalParameters* params);
+
+  /**
+   * 評価パラメータに、別の評価パラメータを成分ごとの重みで混合します.
+   *
+   * ２組のパラメータで評価値を別々に計算して混合する代わりに、あらかじめパラメータ自体を混合しておくので、
+   * 探索中のコストは増えません。
+   * 比率がすべての成分で等しければ、評価値を混合した場合と同じ結果になりますが、成分ごとに比率が異なる場合は、
+   * 進行度に応じた評価値の混合とは一致しません（EvalEnsembleWeightsを参照）。
+   * なお、進行度の計算には、混合される側（params）の重みをそのまま用います。
+   *
+   * @param other   混合する評価パラメータ
+   * @param weights 混合する側（other）の比率
+   * @param params  混合される評価パラメータ（結果もここに保存されます）
+   */
+  static void BlendParameters(const EvalParameters& other,
+                              const EvalEnsembleWeights& weights,
+                              EvalParameters* params);
+
+  /**
+   * ファイルから評価パラメータを読み込み、g_eval_paramsに混合します.
+   * @param file_name 混合する評価パラメータのファイル名
+   * @param weights   混合する側の比率
+   * @return 読み込みに成功した場合は、true
+   */
+  static bool BlendParametersFromFile(const char* file_name,
+                                      const EvalEnsembleWeights& weights);
+
+  /**
+   * 呼び出したスレッドで、評価値の計算に用いる評価パラメータを設定します.
+   * 合議の投票者ごとに異なる評価パラメータを用いる場合などに使用します。
+   * @param params 評価パラメータ（nullptrの場合は、g_eval_paramsを用いる）
+   */
+  static void SetThreadParameters(const EvalParameters* params);
+
+  /**
+   * g_eval_paramsを、NUMAノードの数だけ複製します（詳細は、numa.hを参照）.
+   * 各複製は、そのノードに固定したスレッド上で確保・コピーされます。
+   * @param num_replicas 複製の数（0の場合は、既存の複製を破棄します）
+   */
+  static void ReplicateParameters(int num_replicas);
+
+  /**
+   * ReplicateParameters()で作成した複製を返します.
+   * @param replica_id 複製の番号（NUMAノードの番号）
+   * @return 複製へのポインタ。複製が存在しない場合は、nullptr
+   */
+  static const EvalParameters* GetReplica(int replica_id);
+
   /**
    * 局面の評価値を計算します.
    * @param pos 評価値を計算したい局面
@@ -230,6 +303,6 @@ struct EvalParameters {
  * 評価関数のパラメータを格納します.
  * evaluation.ccのみならず、学習用のコード（learning.cc等）でも使用するので、extern宣言を付けています。
  */
-extern std::unique_ptr<EvalParameters> g_eval_params;
+extern LargePagePtr<EvalParameters> g_eval_params;
 
 #endif /* EVALUATION_H_ */
@@ -64,12 +64,17 @@ void ExtendedBoard::RemovePiece(Square square) {
 }
 
 void ExtendedBoard::SetAllPieces(const Position& pos) {
+  // 1. 先にすべての駒を配置しておく
   for (Square s : Square::all_squares()) {
-    Piece p = pos.piece_on(s);
-    if (p != kNoPiece) {
-      PutPiece(p, s);
-    }
+    board_[s] = pos.piece_on(s);
   }
+
+  // 2. 利きを追加する
+  //    すべての駒が配置済みなので、長い利きは最初から駒のあるマスで止まり、
+  //    PutPiece()のように、駒を置くたびに長い利きを遮る処理は必要ない
+  pos.pieces().ForEach([&](Square s) {
+    AddControls(pos.piece_on(s), s);
+  });
 }
 
 void ExtendedBoard::MakeCaptureMove(Move move) {
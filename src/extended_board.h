@@ -340,6 +340,7 @@ class ExtendedBoard {
 
   /**
    * 与えられた局面の駒を、ExtendedBoardにもすべてセットします.
+   * 前提条件: 将棋盤が空であること（Clear()を呼んだ直後であること）
    * @params pos 局面
    */
   void SetAllPieces(const Position& pos);
@@ -22,17 +22,29 @@
 #include "common/bitop.h"
 #include "node.h"
 
-void HashTable::SetSize(size_t megabytes) {
+bool HashTable::SetSize(size_t megabytes) {
   size_t bytes = megabytes * 1024 * 1024;
+  const size_t requested_size = (static_cast<size_t>(1) << bitop::bsr64(bytes)) / sizeof(Bucket);
   age_  = 0;
-  size_ = (static_cast<size_t>(1) << bitop::bsr64(bytes)) / sizeof(Bucket);
-  key_mask_ = size_ - 1;
+  size_ = requested_size;
   hashfull_ = 0;
-  table_.reset(new Bucket[size_]);
+  table_.reset();
+  table_ = MakeLargePageArray<Bucket>(size_, "HashTable");
+  // メモリが足りない場合は、確保できるまで大きさを半分にしていく
+  // （ライブラリとして組み込まれている場合もあるので、ここではプログラムを終了させない）
+  while (!table_ && size_ > 1) {
+    size_ /= 2;
+    table_ = MakeLargePageArray<Bucket>(size_, "HashTable");
+  }
+  if (!table_) {
+    LargePageAllocator::ExitOnFailure(sizeof(Bucket), "HashTable");
+  }
+  key_mask_ = size_ - 1;
   // テーブルのゼロ初期化を行う（省略不可）
   // Moveクラスのデフォルトコンストラクタにはゼロ初期化処理がないので、ここでゼロ初期化を行わないと、
   // ハッシュムーブがおかしな手になってしまい、最悪セグメンテーションフォールトを引き起こす。
   std::memset(table_.get(), 0, sizeof(Bucket) * size_);
+  return size_ == requested_size;
 }
 
 HashEntry* HashTable::LookUp(Key64 key64) const {
@@ -23,6 +23,7 @@
 #include <vector>
 #include "common/array.h"
 #include "hash_entry.h"
+#include "large_page.h"
 class Node;
 
 /**
@@ -84,9 +85,11 @@ class HashTable {
 
   /**
    * ハッシュテーブルの大きさを変更します.
+   * 指定された大きさのメモリを確保できなかった場合は、確保できるまで大きさを半分にしていきます。
    * @param megabytes メモリ上に確保したいハッシュテーブルの大きさ（メガバイト単位で指定）
+   * @return 指定された大きさでハッシュテーブルを確保できた場合は、true
    */
-  void SetSize(size_t megabytes);
+  bool SetSize(size_t megabytes);
 
   /**
    * ハッシュテーブルの使用率をパーミル（千分率）で返します.
@@ -96,6 +99,13 @@ class HashTable {
     return (UINT64_C(1000) * hashfull_) / (kBucketSize * size_);
   }
 
+  /**
+   * ハッシュテーブルが確保しているメモリの大きさを、バイト単位で返します.
+   */
+  size_t memory_size() const {
+    return table_ ? sizeof(Bucket) * size_ : 0;
+  }
+
  private:
   /** バケツ１個あたりに保存する、エントリの数. */
   static constexpr size_t kBucketSize = 4;
@@ -107,7 +117,7 @@ class HashTable {
   typedef Array<HashEntry, kBucketSize> Bucket;
 
   /** ハッシュテーブルのポインタ */
-  std::unique_ptr<Bucket[]> table_;
+  LargePagePtr<Bucket[]> table_;
 
   /** ハッシュテーブルの要素数 */
   size_t size_;
@@ -19,46 +19,81 @@
 
 #include "huffman_code.h"
 
+#include <cstring>
+#include <algorithm>
+
 namespace {
 
 /**
- * ハフマン符号化を補助するための、ビットストリームです.
+ * ハフマン符号を復号化するための、ビット列の読み込み器です.
+ * 1ビットずつではなく、64ビット単位で読み込んでおいたデータから、複数ビットをまとめて先読みします。
  */
-struct BitStream {
+class BitReader {
  public:
-  BitStream() {
-    array_.clear();
+  explicit BitReader(const Array<uint64_t, 4>& array)
+      : array_(array) {
   }
 
-  BitStream(const Array<uint64_t, 4>& array)
-      : array_(array) {
+  /**
+   * 次の count ビットを、読み込み位置を進めずに返します（count <= 32）.
+   * ビット列の末尾を超えた部分は、0として扱います。
+   */
+  uint32_t peek(size_t count) const {
+    assert(count <= 32);
+    size_t index = pos_ / 64, shift = pos_ % 64;
+    uint64_t value = array_[index] >> shift;
+    if (shift + count > 64 && index + 1 < 4) {
+      value |= array_[index + 1] << (64 - shift);
+    }
+    return static_cast<uint32_t>(value & ((UINT64_C(1) << count) - 1));
   }
 
-  uint64_t get() {
-    uint64_t value = (array_[pos_ / 64] >> (pos_ % 64)) & UINT64_C(1);
-    ++pos_;
-    assert(value == 0 || value == 1);
-    return value;
+  void skip(size_t count) {
+    pos_ += count;
+    assert(pos_ <= size());
   }
 
-  uint64_t read(size_t count) {
-    uint64_t value = 0;
-    for (size_t i = 0; i < count; ++i) {
-      value |= get() << i;
-    }
+  uint32_t read(size_t count) {
+    uint32_t value = peek(count);
+    skip(count);
     return value;
   }
 
-  void put(uint64_t value) {
-    assert(value == 0 || value == 1);
-    array_[pos_ / 64] |= value << (pos_ % 64);
-    ++pos_;
+  size_t size() const {
+    return 256;
+  }
+
+  bool eof() const {
+    return pos_ == size();
+  }
+
+ private:
+  const Array<uint64_t, 4>& array_;
+  size_t pos_ = 0;
+};
+
+/**
+ * ハフマン符号化を行うための、ビット列の書き込み器です.
+ */
+class BitWriter {
+ public:
+  BitWriter() {
+    array_.clear();
   }
 
+  /**
+   * value の下位 count ビットを書き込みます（count <= 32）.
+   */
   void write(uint64_t value, size_t count) {
-    for (size_t i = 0; i < count; ++i) {
-      put((value >> i) & UINT64_C(1));
+    assert(count <= 32);
+    assert(pos_ + count <= size());
+    assert((value >> count) == 0);
+    size_t index = pos_ / 64, shift = pos_ % 64;
+    array_[index] |= value << shift;
+    if (shift + count > 64) {
+      array_[index + 1] |= value >> (64 - shift);
     }
+    pos_ += count;
   }
 
   size_t size() const {
@@ -69,7 +104,7 @@ struct BitStream {
     return pos_ == size();
   }
 
-  const Array<uint64_t, 4>& array() {
+  const Array<uint64_t, 4>& array() const {
     return array_;
   }
 
@@ -100,16 +135,55 @@ const ArrayMap<HuffmanBitString, PieceType> g_huffman_code_table = {
     {kRook       , {0x3f, 6}},
 };
 
+/**
+ * 盤上の駒・持ち駒の符号の最大長（駒の種類・持ち主・成り駒か否かをすべて含む）です.
+ */
+constexpr int kMaxBoardCodeLength = 8; // 飛車・龍: 6 + 1 + 1 ビット
+constexpr int kMaxHandCodeLength = 7;  // 飛車: 5 + 1 + 1 ビット
+
+/**
+ * 盤上の駒を復号化する際に、１回の表引きで先読みするビット数です.
+ * 空きマスは１ビット、歩は４ビットで表されるので、平均して３〜４マス分をまとめて復号化できます。
+ */
+constexpr int kBoardLookupBits = 12;
+
+static_assert(kBoardLookupBits >= kMaxBoardCodeLength,
+              "１回の表引きで、少なくとも１マス分は復号化できる必要があります。");
+
+/**
+ * 駒１枚分の、符号化・復号化の結果です.
+ */
+struct PieceCode {
+  uint8_t piece;  // 駒（Piece型）
+  uint8_t length; // 符号の長さ（ビット数）。該当する駒が存在しない場合は0
+};
+
+/**
+ * 盤上の複数のマスを、１回の表引きでまとめて復号化するための参照テーブルの要素です.
+ */
+struct MultiPieceCode {
+  uint8_t num_pieces; // 復号化できたマスの数
+  uint8_t length;     // 復号化できたマスの符号長の合計（ビット数）
+  Array<uint8_t, kBoardLookupBits> pieces; // 復号化された駒（Piece型）
+};
+
+/**
+ * 盤上の駒・持ち駒のハフマン符号（持ち主・成りのビットを含む）の符号化テーブルです.
+ */
+ArrayMap<HuffmanBitString, Piece> g_board_encoder_table;
+ArrayMap<HuffmanBitString, Piece> g_hand_encoder_table;
+
 /**
  * ハフマン符号を高速に復号化するための参照テーブルです.
+ * 符号の最大長のビットを先読みし、その値を添字にして表を引くと、先頭の駒と符号長が得られます。
  */
-Array<PieceType, 6, 64> g_huffman_decoder_table; // [ビット長][ハフマン符号]
+Array<PieceCode, 1 << kMaxBoardCodeLength> g_board_decoder_table;
+Array<PieceCode, 1 << kMaxHandCodeLength> g_hand_decoder_table;
 
 /**
- * 与えられたハフマン符号に該当する駒が存在しない場合、g_huffman_decoder_tableに
- * この値をセットしておきます.
+ * 盤上の駒を、kBoardLookupBits ビットずつ復号化するための参照テーブルです.
  */
-const PieceType kHuffmanCodeNotFound = static_cast<PieceType>(-1);
+Array<MultiPieceCode, 1 << kBoardLookupBits> g_multi_piece_decoder_table;
 
 /**
  * 駒をハフマン符号で符号化します.
@@ -144,29 +218,17 @@ inline HuffmanBitString EncodePiece(Piece piece) {
 }
 
 /**
- * 駒のハフマン符号を復号化します.
+ * 符号の後ろに続くビットの値によらず、その符号に該当する駒が得られるように、復号化テーブルに登録します.
  */
-template<bool kIsHandPiece>
-inline Piece DecodePiece(BitStream& bit_stream) {
-  // 1. 駒の種類
-  uint64_t code = kIsHandPiece ? 1 : 0;
-  PieceType pt = kHuffmanCodeNotFound;
-  for (int i = kIsHandPiece ? 1 : 0; pt == kHuffmanCodeNotFound; ++i) {
-    assert(i < 6);
-    code |= bit_stream.get() << i;
-    pt = g_huffman_decoder_table[i][code];
+template<size_t kSize>
+void RegisterPieceCode(Piece piece, HuffmanBitString huffman,
+                       Array<PieceCode, kSize>* const decoder_table) {
+  for (size_t suffix = 0; (huffman.bits | (suffix << huffman.length)) < kSize; ++suffix) {
+    PieceCode& entry = (*decoder_table)[huffman.bits | (suffix << huffman.length)];
+    assert(entry.length == 0); // ハフマン符号は接頭符号なので、重複はありえない
+    entry.piece = static_cast<uint8_t>(piece);
+    entry.length = static_cast<uint8_t>(huffman.length);
   }
-
-  if (pt == kNoPieceType) {
-    return kNoPiece;
-  }
-
-  // 2. 駒の持ち主
-  Color color = static_cast<Color>(bit_stream.get());
-  Piece piece(color, pt);
-
-  // 3. 成り駒か否か
-  return (pt != kGold && bit_stream.get()) ? piece.promoted_piece() : piece;
 }
 
 } // namespace
@@ -182,91 +244,145 @@ HuffmanCode HuffmanCode::EncodePosition(const Position& pos) {
   assert(pos.num_unused_pieces(kRook  ) == 0);
   assert(pos.num_unused_pieces(kKing  ) == 0);
 
-  BitStream bit_stream;
-
-  // 1. 手番
-  bit_stream.put(static_cast<int>(pos.side_to_move()));
+  BitWriter bit_writer;
 
-  // 2. 玉の位置
-  bit_stream.write(static_cast<int>(pos.king_square(kBlack)), 7);
-  bit_stream.write(static_cast<int>(pos.king_square(kWhite)), 7);
+  // 1. 手番と玉の位置（1 + 7 + 7 = 15ビット）
+  bit_writer.write(  static_cast<uint64_t>(pos.side_to_move())
+                   | static_cast<uint64_t>(pos.king_square(kBlack)) << 1
+                   | static_cast<uint64_t>(pos.king_square(kWhite)) << 8, 15);
 
-  // 3. 盤上の駒
+  // 2. 盤上の駒
+  //    符号は最大8ビットなので、32ビットを超えない範囲で、複数マス分をまとめて書き込む
+  uint64_t buffer = 0;
+  size_t buffer_length = 0;
   for (Square s : Square::all_squares()) {
     Piece piece = pos.piece_on(s);
     if (piece.type() != kKing) {
-      HuffmanBitString huffman = EncodePiece<false>(piece);
-      bit_stream.write(huffman.bits, huffman.length);
+      const HuffmanBitString& huffman = g_board_encoder_table[piece];
+      buffer |= static_cast<uint64_t>(huffman.bits) << buffer_length;
+      buffer_length += huffman.length;
+      if (buffer_length > 32 - kMaxBoardCodeLength) {
+        bit_writer.write(buffer, buffer_length);
+        buffer = 0;
+        buffer_length = 0;
+      }
     }
   }
+  if (buffer_length > 0) {
+    bit_writer.write(buffer, buffer_length);
+  }
 
-  // 4. 持ち駒
+  // 3. 持ち駒
   for (Color c : {kBlack, kWhite}) {
     Hand hand = pos.hand(c);
     for (PieceType pt : Piece::all_hand_types()) {
       int count = hand.count(pt);
       if (count == 0) continue;
-      HuffmanBitString huffman = EncodePiece<true>(Piece(c, pt));
+      const HuffmanBitString& huffman = g_hand_encoder_table[Piece(c, pt)];
       do {
-        bit_stream.write(huffman.bits, huffman.length);
+        bit_writer.write(huffman.bits, huffman.length);
       } while (--count > 0);
     }
   }
 
-  assert(bit_stream.eof());
+  assert(bit_writer.eof());
 
-  return HuffmanCode(bit_stream.array());
+  return HuffmanCode(bit_writer.array());
 }
 
 Position HuffmanCode::DecodePosition(const HuffmanCode& huffman_code) {
   Position pos;
-  BitStream bit_stream(huffman_code.array());
+  BitReader bit_reader(huffman_code.array());
 
   // 1. 手番
-  Color side_to_move = static_cast<Color>(bit_stream.get());
-  pos.set_side_to_move(side_to_move);
+  pos.set_side_to_move(static_cast<Color>(bit_reader.read(1)));
 
   // 2. 玉の位置
-  Square black_king_square(bit_stream.read(7));
-  Square white_king_square(bit_stream.read(7));
-  pos.PutPiece(kBlackKing, black_king_square);
-  pos.PutPiece(kWhiteKing, white_king_square);
+  ArrayMap<Square, Color> king_squares;
+  king_squares[kBlack] = Square(bit_reader.read(7));
+  king_squares[kWhite] = Square(bit_reader.read(7));
 
   // 3. 盤上の駒
-  for (Square s : Square::all_squares()) {
-    if (pos.is_empty(s)) {
-      Piece piece = DecodePiece<false>(bit_stream);
-      if (piece != kNoPiece) {
-        pos.PutPiece(piece, s);
-      }
-    }
+  //    a. まず、玉以外の79マス分の駒を、符号の順番どおりに並べる
+  constexpr int kNumSquares = 81 - 2;
+  Array<uint8_t, 81 + kBoardLookupBits> pieces; // 末尾の余白は、書き込みのはみ出し用
+  int num_pieces = 0;
+  while (num_pieces <= kNumSquares - kBoardLookupBits) {
+    // 残りのマス数が先読みのビット数以上あれば、１回の表引きで復号化できた駒をすべて使える
+    const MultiPieceCode& entry = g_multi_piece_decoder_table[bit_reader.peek(kBoardLookupBits)];
+    std::memcpy(&pieces[num_pieces], &entry.pieces[0], kBoardLookupBits);
+    num_pieces += entry.num_pieces;
+    bit_reader.skip(entry.length);
+  }
+  while (num_pieces < kNumSquares) {
+    // 残りのマスは、持ち駒の符号を読み込んでしまわないよう、１マスずつ復号化する
+    const PieceCode& entry = g_board_decoder_table[bit_reader.peek(kMaxBoardCodeLength)];
+    assert(entry.length != 0);
+    pieces[num_pieces++] = entry.piece;
+    bit_reader.skip(entry.length);
   }
 
-  pos.InitStateInfo(); // 将棋盤に駒を配置し終えたところで、StateInfoを初期化する
+  //    b. 玉のマスの位置に玉を挿入すると、マスの順番どおりの駒の並びになる
+  //       （マスの番号が小さい方の玉から挿入する）
+  const Color first = king_squares[kBlack] < king_squares[kWhite] ? kBlack : kWhite;
+  for (Color c : {first, ~first}) {
+    Square s = king_squares[c];
+    std::memmove(&pieces[s + 1], &pieces[s], num_pieces - s);
+    pieces[s] = static_cast<uint8_t>(Piece(c, kKing));
+    ++num_pieces;
+  }
+  ArrayMap<Piece, Square> board;
+  for (Square s : Square::all_squares()) {
+    board[s] = Piece(pieces[s]);
+  }
 
   // 4. 持ち駒
-  while (!bit_stream.eof()) {
-    Piece piece = DecodePiece<true>(bit_stream);
-    pos.AddOneToHand(piece.color(), piece.type());
+  ArrayMap<Hand, Color> hands;
+  hands[kBlack] = hands[kWhite] = Hand();
+  while (!bit_reader.eof()) {
+    const PieceCode& entry = g_hand_decoder_table[bit_reader.peek(kMaxHandCodeLength)];
+    assert(entry.length != 0);
+    Piece piece(entry.piece);
+    hands[piece.color()].add_one(piece.type());
+    bit_reader.skip(entry.length);
   }
 
+  // 5. 駒の配置をまとめてセットし、StateInfoを１回だけ初期化する
+  pos.SetUpPieces(board, hands);
+
   return pos;
 }
 
 void HuffmanCode::Init() {
-  // 1. g_huffman_decoder_tableを初期化する
-  {
-    // 初期値として、kHuffmanCodeNotFoundをセットする
-    for (int length = 0; length < 6; ++length)
-      for (int bits = 0; bits < 64; ++bits) {
-        g_huffman_decoder_table[length][bits] = kHuffmanCodeNotFound;
-      }
+  // 1. 符号化テーブルと、１駒ずつ復号化するためのテーブルを初期化する
+  std::fill(g_board_decoder_table.begin(), g_board_decoder_table.end(), PieceCode{0, 0});
+  std::fill(g_hand_decoder_table.begin(), g_hand_decoder_table.end(), PieceCode{0, 0});
+  g_board_encoder_table[kNoPiece] = EncodePiece<false>(kNoPiece);
+  RegisterPieceCode(kNoPiece, g_board_encoder_table[kNoPiece], &g_board_decoder_table);
+  for (Piece piece : Piece::all_pieces()) {
+    if (piece.is(kKing)) continue;
+    g_board_encoder_table[piece] = EncodePiece<false>(piece);
+    RegisterPieceCode(piece, g_board_encoder_table[piece], &g_board_decoder_table);
+    if (!piece.is_promoted()) {
+      g_hand_encoder_table[piece] = EncodePiece<true>(piece);
+      RegisterPieceCode(piece, g_hand_encoder_table[piece], &g_hand_decoder_table);
+    }
+  }
 
-    // 各駒のハフマン符号をセットする
-    for (int i = kNoPieceType; i <= kRook; ++i) {
-      PieceType piece_type = static_cast<PieceType>(i);
-      HuffmanBitString huffman = g_huffman_code_table[piece_type];
-      g_huffman_decoder_table[huffman.length - 1][huffman.bits] = piece_type;
+  // 2. 盤上の駒を、複数マス分まとめて復号化するためのテーブルを初期化する
+  for (size_t bits = 0; bits < g_multi_piece_decoder_table.size(); ++bits) {
+    MultiPieceCode& entry = g_multi_piece_decoder_table[bits];
+    entry.num_pieces = entry.length = 0;
+    std::fill(entry.pieces.begin(), entry.pieces.end(), 0);
+    while (true) {
+      const size_t rest = bits >> entry.length;
+      const PieceCode& code = g_board_decoder_table[rest & ((1 << kMaxBoardCodeLength) - 1)];
+      if (entry.length + code.length > kBoardLookupBits) {
+        break; // 先読みしたビットの中に、この駒の符号が収まっていない
+      }
+      entry.pieces[entry.num_pieces++] = code.piece;
+      entry.length += code.length;
     }
+    assert(entry.num_pieces >= 1);
   }
 }
@@ -0,0 +1,234 @@
+/*
+ * 技巧 (Gikou), a USI shogi (Japanese chess) playing engine.
+ * Copyright (C) 2016-2017 Yosuke Demura
+ * except where otherwise indicated.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "large_page.h"
+
+#if defined(__linux__)
+#  include <sys/mman.h>
+#else
+#  include <xmmintrin.h>
+#endif
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include "memory_report.h"
+#include "synced_printf.h"
+
+namespace {
+
+/**
+ * 確保された領域が、どの種類のページに置かれたかを表します.
+ */
+enum PageKind {
+  kExplicitHugePages,    // MAP_HUGETLBで確保したラージページ
+  kTransparentHugePages, // THPを要求した通常の領域
+  kNormalPages,          // ラージページを使っていない領域
+};
+
+const char* PageKindName(PageKind kind) {
+  switch (kind) {
+    case kExplicitHugePages   : return "explicit huge pages";
+    case kTransparentHugePages: return "transparent huge pages";
+    default                   : return "normal pages";
+  }
+}
+
+struct Record {
+  std::string name;
+  size_t bytes;        // 要求された大きさ
+  size_t mapped_bytes; // 実際にmmap()した大きさ（アリーナや、Advise()の場合は0）
+  PageKind kind;
+};
+
+/**
+ * 確保済みの領域の一覧です.
+ * 静的なオブジェクトの初期化中に呼ばれることもあるので、関数内のstatic変数にしています。
+ */
+std::map<const void*, Record>& registry() {
+  static std::map<const void*, Record> records;
+  return records;
+}
+
+std::mutex& registry_mutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+inline size_t RoundUp(size_t bytes, size_t alignment) {
+  return (bytes + alignment - 1) / alignment * alignment;
+}
+
+#if defined(__linux__)
+
+/**
+ * ラージページの境界に揃った領域をmmap()で確保します.
+ * @param bytes 確保する大きさ（kLargePageSizeの倍数）
+ * @param kind  実際に使われたページの種類を受け取るポインタ
+ */
+void* MapLargePages(size_t bytes, PageKind* kind) {
+  // 1. 明示的なラージページ（OS側で事前に予約されている場合のみ成功する）
+#if defined(MAP_HUGETLB)
+  void* ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (ptr != MAP_FAILED) {
+    *kind = kExplicitHugePages;
+    return ptr;
+  }
+#endif
+
+  // 2. 通常のページを、2MB境界に揃えて確保したうえで、THPを要求する
+  const size_t alignment = LargePageAllocator::kLargePageSize;
+  void* raw = mmap(nullptr, bytes + alignment, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED) {
+    return nullptr;
+  }
+  uintptr_t begin = reinterpret_cast<uintptr_t>(raw);
+  uintptr_t aligned = RoundUp(begin, alignment);
+  // 前後の余分な部分を返却する
+  if (aligned != begin) {
+    munmap(raw, aligned - begin);
+  }
+  if (aligned + bytes != begin + bytes + alignment) {
+    munmap(reinterpret_cast<void*>(aligned + bytes),
+           begin + bytes + alignment - (aligned + bytes));
+  }
+  ptr = reinterpret_cast<void*>(aligned);
+#if defined(MADV_HUGEPAGE)
+  *kind = madvise(ptr, bytes, MADV_HUGEPAGE) == 0
+        ? kTransparentHugePages : kNormalPages;
+#else
+  *kind = kNormalPages;
+#endif
+  return ptr;
+}
+
+/**
+ * 小さなテーブルを切り出すための、共有アリーナです.
+ */
+struct SharedArena {
+  char* current = nullptr;
+  size_t remaining = 0;
+  PageKind kind = kNormalPages;
+};
+
+#endif // defined(__linux__)
+
+} // namespace
+
+void* LargePageAllocator::Allocate(size_t bytes, const char* name) {
+  std::lock_guard<std::mutex> lock(registry_mutex());
+  Record record{name, bytes, 0, kNormalPages};
+  void* ptr = nullptr;
+
+#if defined(__linux__)
+  if (bytes >= kLargePageSize / 2) {
+    // 大きなテーブルは、テーブルごとに個別に確保する
+    record.mapped_bytes = RoundUp(bytes, kLargePageSize);
+    ptr = MapLargePages(record.mapped_bytes, &record.kind);
+  } else {
+    // 小さなテーブルは、共有アリーナから切り出す
+    static SharedArena arena;
+    const size_t rounded = RoundUp(bytes, kAlignment);
+    if (rounded > arena.remaining) {
+      arena.current = static_cast<char*>(MapLargePages(kLargePageSize,
+                                                       &arena.kind));
+      arena.remaining = arena.current != nullptr ? kLargePageSize : 0;
+    }
+    if (arena.current != nullptr) {
+      ptr = arena.current;
+      arena.current += rounded;
+      arena.remaining -= rounded;
+      record.kind = arena.kind;
+    }
+  }
+  // mmap()で確保した領域は、ゼロ初期化済み
+#else
+  ptr = _mm_malloc(bytes, kAlignment);
+  if (ptr != nullptr) {
+    std::memset(ptr, 0, bytes);
+  }
+#endif
+
+  // 確保に失敗した場合の扱いは、呼び出し側に任せる
+  // （ライブラリとして組み込まれている場合に、ホストのプロセスごと終了させないため）
+  if (ptr != nullptr) {
+    registry()[ptr] = record;
+  }
+  return ptr;
+}
+
+void LargePageAllocator::ExitOnFailure(size_t bytes, const char* name) {
+  std::printf("info string Failed to allocate %zu bytes for %s.\n", bytes, name);
+  std::fflush(stdout);
+  std::exit(EXIT_FAILURE);
+}
+
+void LargePageAllocator::Deallocate(void* ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(registry_mutex());
+  auto it = registry().find(ptr);
+  if (it == registry().end()) {
+    return;
+  }
+#if defined(__linux__)
+  if (it->second.mapped_bytes != 0) {
+    munmap(ptr, it->second.mapped_bytes);
+  }
+#else
+  _mm_free(ptr);
+#endif
+  registry().erase(it);
+}
+
+void LargePageAllocator::Advise(void* ptr, size_t bytes, const char* name) {
+  std::lock_guard<std::mutex> lock(registry_mutex());
+  Record record{name, bytes, 0, kNormalPages};
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  // 2MB境界に揃った内側の部分だけが、ラージページの対象になる
+  uintptr_t begin = RoundUp(reinterpret_cast<uintptr_t>(ptr), kLargePageSize);
+  uintptr_t end = (reinterpret_cast<uintptr_t>(ptr) + bytes) / kLargePageSize
+                * kLargePageSize;
+  if (begin < end
+      && madvise(reinterpret_cast<void*>(begin), end - begin, MADV_HUGEPAGE) == 0) {
+    record.kind = kTransparentHugePages;
+  }
+#endif
+  registry()[ptr] = record;
+}
+
+void LargePageAllocator::Print(const char* prefix) {
+  std::lock_guard<std::mutex> lock(registry_mutex());
+  for (const auto& pair : registry()) {
+    const Record& record = pair.second;
+    SYNCED_PRINTF("%s%-40s %9.2f MB  %s\n", prefix, record.name.c_str(),
+                  record.bytes / (1024.0 * 1024.0), PageKindName(record.kind));
+  }
+  size_t huge_pages = MemoryReport::GetAnonHugePagesSize();
+  if (huge_pages != 0) {
+    SYNCED_PRINTF("%s%-40s %9.2f MB\n", prefix, "AnonHugePages (measured)",
+                  huge_pages / (1024.0 * 1024.0));
+  }
+}
@@ -0,0 +1,147 @@
+/*
+ * 技巧 (Gikou), a USI shogi (Japanese chess) playing engine.
+ * Copyright (C) 2016-2017 Yosuke Demura
+ * except where otherwise indicated.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LARGE_PAGE_H_
+#define LARGE_PAGE_H_
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+/**
+ * 評価パラメータや置換表などの、大きなテーブルを確保するためのアロケータです.
+ *
+ * 大きなテーブルへのランダムアクセスは、TLBミスが多発しやすいので、可能であれば
+ * ラージページ（Linuxでは2MBのページ）上にテーブルを配置します。
+ *   - 1MB以上のテーブル: テーブルごとにmmap()で領域を確保し、まず明示的なラージページ（MAP_HUGETLB）を試みます。
+ *     確保できなければ、通常のページを確保したうえで、Transparent Huge Pages（THP）を要求します。
+ *   - 1MB未満のテーブル: 共有の2MBアリーナから切り出すことで、複数の小さなテーブルを１枚のラージページにまとめます。
+ * いずれの場合も、SIMD命令で扱えるように、先頭アドレスは64バイト境界に揃えます。
+ *
+ * 使用例：
+ * @code
+ * LargePagePtr<EvalParameters> params = MakeLargePageObject<EvalParameters>("EvalParameters");
+ * LargePageAllocator::Print("info string "); // どのテーブルでラージページが使われたかを表示する
+ * @endcode
+ */
+class LargePageAllocator {
+ public:
+  /** ラージページの大きさ（バイト単位）. */
+  static constexpr size_t kLargePageSize = 2 * 1024 * 1024;
+
+  /** 確保される領域の、先頭アドレスのアライメント（バイト単位）. */
+  static constexpr size_t kAlignment = 64;
+
+  /**
+   * 領域を確保します.
+   * @param bytes 確保する大きさ（バイト単位）
+   * @param name  テーブルの名前（Print()で表示されます）
+   * @return 確保した領域の先頭アドレス（ゼロ初期化済み）。確保に失敗した場合は、nullptr
+   */
+  static void* Allocate(size_t bytes, const char* name);
+
+  /**
+   * 領域の確保に失敗したことを表示して、プログラムを終了します.
+   * 評価パラメータなどの、確保できなければ探索できない固定長のテーブルでのみ用います。
+   * （置換表のように大きさを指定できるテーブルでは、終了せずに、より小さな大きさで確保し直してください。）
+   */
+  [[noreturn]] static void ExitOnFailure(size_t bytes, const char* name);
+
+  /**
+   * Allocate()で確保した領域を解放します.
+   * アリーナから切り出した小さな領域は、プロセス終了まで解放されません。
+   */
+  static void Deallocate(void* ptr);
+
+  /**
+   * 既に確保済みの領域（静的な配列や、std::valarrayの中身など）について、THPを使うようにOSに要求します.
+   * 2MB境界に揃った部分だけがラージページの対象になるので、この関数を呼ぶのは、
+   * 領域に初めて書き込みを行う前が望ましいです。
+   * @param ptr   領域の先頭アドレス
+   * @param bytes 領域の大きさ（バイト単位）
+   * @param name  テーブルの名前（Print()で表示されます）
+   */
+  static void Advise(void* ptr, size_t bytes, const char* name);
+
+  /**
+   * 登録されたテーブルごとに、使用されたページの種類を表示します.
+   * Linuxでは、実際にラージページに割り当てられているメモリ量（AnonHugePages）も併せて表示します。
+   * @param prefix 各行の先頭に付ける文字列（USIで表示する場合は、"info string "）
+   */
+  static void Print(const char* prefix = "");
+};
+
+/**
+ * LargePageAllocatorで確保した領域を、std::unique_ptrで管理するためのデリータです.
+ * 対象の型は、トリビアルに破棄可能である必要があります（デストラクタは呼ばれません）。
+ */
+struct LargePageDeleter {
+  void operator()(void* ptr) const {
+    LargePageAllocator::Deallocate(ptr);
+  }
+};
+
+template<typename T>
+using LargePagePtr = std::unique_ptr<T, LargePageDeleter>;
+
+/**
+ * LargePageAllocatorを用いて、T型のオブジェクトを１個生成します.
+ * 確保に失敗した場合は、空のポインタを返します。
+ */
+template<typename T>
+LargePagePtr<T> MakeLargePageObject(const char* name) {
+  static_assert(std::is_trivially_destructible<T>::value, "");
+  void* ptr = LargePageAllocator::Allocate(sizeof(T), name);
+  if (ptr == nullptr) {
+    return LargePagePtr<T>();
+  }
+  return LargePagePtr<T>(new (ptr) T);
+}
+
+/**
+ * MakeLargePageObject()と同様ですが、確保に失敗した場合は、プログラムを終了します.
+ */
+template<typename T>
+LargePagePtr<T> MakeRequiredLargePageObject(const char* name) {
+  LargePagePtr<T> ptr = MakeLargePageObject<T>(name);
+  if (!ptr) {
+    LargePageAllocator::ExitOnFailure(sizeof(T), name);
+  }
+  return ptr;
+}
+
+/**
+ * LargePageAllocatorを用いて、T型の配列を生成します.
+ * 確保に失敗した場合は、空のポインタを返します。
+ */
+template<typename T>
+LargePagePtr<T[]> MakeLargePageArray(size_t size, const char* name) {
+  static_assert(std::is_trivially_destructible<T>::value, "");
+  T* ptr = static_cast<T*>(LargePageAllocator::Allocate(sizeof(T) * size, name));
+  if (ptr == nullptr) {
+    return LargePagePtr<T[]>();
+  }
+  for (size_t i = 0; i < size; ++i) {
+    new (ptr + i) T;
+  }
+  return LargePagePtr<T[]>(ptr);
+}
+
+#endif /* LARGE_PAGE_H_ */
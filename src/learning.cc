@@ -22,7 +22,9 @@
 #include <cinttypes>
 #include <cstdlib>
 #include <algorithm>
+#include <chrono>
 #include <fstream>
+#include <future>
 #include <random>
 #include <thread>
 #include <omp.h>
@@ -52,6 +54,7 @@ constexpr int kBatchSize = 8000;     // 勾配を計算するのに用いる局
 // 探索の設定
 constexpr int kMinSearchDepth = 1; // PVを求めるために行われる探索の、最小深さ
 constexpr int kMaxSearchDepth = 2; // PVを求めるために行われる探索の、最大深さ
+constexpr int kPvReuseInterval = 1; // 同じ学習局面のPVを何回の更新まで使い回すか（1ならば、毎回探索し直す）
 
 // 損失関数の設定
 constexpr float kWinRateCoefficient = 100.0f;   // 損失関数の第２項（勝率予測の誤差）に掛ける係数
@@ -74,6 +77,14 @@ constexpr float kRmsPropEpsilon = 1e-4f; // ゼロ除算を防止するために
 // 平均化SGDの設定
 constexpr float kAveragedSgdDecay = 0.9995f; // 指数移動平均の減衰率（大きいほど過去のパラメータを重視）
 
+// パラメータのコピーの設定
+// （通常の学習では毎回ほぼすべてのテーブルが変化し、変化の検出の分だけ遅くなるので、デフォルトでは無効にしている）
+constexpr bool kIncrementalCopyParams = false; // 値が変化したテーブルに依存する部分のみを、g_eval_paramsにコピーする
+
+// 交差検定の設定
+constexpr int kValidationInterval = 100; // 何イテレーションごとに、平均化パラメータの保存と交差検定を行うか
+constexpr int kValidationThreads = 2;    // 交差検定を行うスレッド数（学習と並行して、バックグラウンドで実行される）
+
 /**
  * 学習時の統計データをまとめて保存するためのクラスです.
  */
@@ -98,6 +109,9 @@ struct LearningStats {
     num_moves                   += rhs.num_moves;
     num_samples                 += rhs.num_samples;
     num_nodes                   += rhs.num_nodes;
+    num_searched_positions      += rhs.num_searched_positions;
+    num_reused_positions        += rhs.num_reused_positions;
+    search_time                 += rhs.search_time;
     return *this;
   }
   float loss                        = 0.0f; // 損失関数全体の損失
@@ -119,6 +133,51 @@ struct LearningStats {
   int num_moves         = 0;
   int num_samples       = 0;
   int num_nodes         = 0;
+  int num_searched_positions = 0;   // 実際に探索を行った局面数
+  int num_reused_positions   = 0;   // 以前のPVを再利用し、探索を省略した局面数
+  double search_time         = 0.0; // 探索に要した時間の合計（秒、全スレッドの合計）
+};
+
+/**
+ * 学習スレッドごとに保持しておく、探索用の作業領域です.
+ * 局面ごとにSearchやNodeを作り直すと、各種の統計テーブルの確保と初期化に時間がかかるため、使い回します。
+ */
+struct SearchWorkspace {
+  SearchWorkspace()
+      : node(Position::CreateStartPosition()),
+        search(shared_data) {
+  }
+
+  /**
+   * 新しい局面を探索する準備をします.
+   * 置換表は、イテレーションの開始時にまとめてクリアされます。
+   * カウンター手のヒストリーは、前の局面の探索で参照されたエントリだけを、局面ごとにクリアします。
+   */
+  Node& Reset(const Position& pos, bool learning_mode) {
+    node.Reset(pos);
+    search.set_learning_mode(learning_mode);
+    search.PrepareForNextSearch();
+    shared_data.countermoves_history.ClearTouchedEntries();
+    return node;
+  }
+
+  SharedData shared_data;
+  Node node;
+  Search search;
+};
+
+/**
+ * 学習局面について、探索で得られたPVを保存しておくためのクラスです.
+ * kPvReuseIntervalが2以上の場合は、保存されたPVを次回以降の更新でも使い回します。
+ */
+struct SearchedPvs {
+  bool valid = false;         // 学習に使えるPVが保存されている場合はtrue
+  int searched_iteration = 0; // 探索を行ったイテレーション
+  int num_pvs = 0;
+  int num_moves = 0;
+  Move best_move = kMoveNone;
+  std::vector<std::vector<Move>> pv_list;
+  std::valarray<int> scores;
 };
 
 /**
@@ -342,7 +401,7 @@ void ComputeGradientOfOscillationLoss(
  * RootStrapの損失項について、勾配を計算します.
  */
 void ComputeGradientOfRootStrapLoss(const TeacherPosition& teacher_position,
-                                    SharedData& shared_data,
+                                    SearchWorkspace& workspace,
                                     Gradient* const gradient,
                                     LearningStats* const stats) {
   assert(gradient != nullptr);
@@ -351,9 +410,8 @@ void ComputeGradientOfRootStrapLoss(const TeacherPosition& teacher_position,
   Position pos = HuffmanCode::DecodePosition(teacher_position.huffman_code);
 
   // 1. 静止探索を行う
-  Node node(pos);
-  Search search(shared_data);
-  search.PrepareForNextSearch();
+  Node& node = workspace.Reset(pos, false);
+  Search& search = workspace.search;
   Score alpha = -kScoreKnownWin, beta = kScoreKnownWin;
   Score score = search.AlphaBetaSearch(node, alpha, beta, kDepthZero);
   if (std::abs(score) >= kScoreKnownWin) {
@@ -413,35 +471,14 @@ void ComputeGradientOfLogisticRegressionLoss(const TeacherPosition& teacher_posi
 }
 
 /**
- * １つの特定の局面について、損失関数の勾配を計算します.
- *
- * なお、現在の実装では、評価関数の学習に用いる損失関数は、
- *    - 第1項: 棋譜の手との不一致率（idea from 激指）
- *    - 第2項: 勝率予測と勝敗との負の対数尤度（idea from 習甦）
- *    - 第3項: 浅い探索結果と深い探索結果との誤差（idea from 習甦）
- * の３つから構成されています。
- *
- * （参考文献）
- *   - 鶴岡慶雅: 「激指」の最近の改良について --コンピュータ将棋と機械学習--,
- *     『コンピュータ将棋の進歩６』, pp.77-81, 共立出版, 2012.
- *   - 竹内章: 習甦の誕生, 『人間に勝つコンピュータ将棋の作り方』, pp.184-189, 技術評論社, 2012.
- *   - 佐藤佳州: ゲームにおける棋譜の性質と強さの関係に基づいた学習, pp.66-67, 2014.
- *
- * @param pos              損失関数の勾配を計算したい局面
- * @param shared_data      探索中のデータ
- * @param teacher_move     教師とすべき、棋譜の手
- * @param progress         局面の進行度（初期局面が0で、投了局面が1となる値）
- * @param winner           その対局で勝った側の手番
- * @param mersenne_twister 乱数生成器（メルセンヌ・ツイスタ）
- * @param gradient         損失関数の勾配
- * @return 学習中の統計データ
+ * 学習局面の各合法手について探索を行い、PVを求めます.
+ * 探索を打ち切った場合など、学習に適さない局面では、searched_pvs->validはfalseのままになります。
  */
-LearningStats ComputeGradient(Position& pos, SharedData& shared_data,
-                              const Move teacher_move, const float progress,
-                              const Color winner,
-                              std::mt19937& mersenne_twister,
-                              Gradient* const gradient) {
-  assert(gradient != nullptr);
+LearningStats SearchPvs(Position& pos, SearchWorkspace& workspace,
+                        const Move teacher_move, const int margin,
+                        std::mt19937& mersenne_twister,
+                        SearchedPvs* const searched_pvs) {
+  assert(searched_pvs != nullptr);
 
   LearningStats stats;
 
@@ -465,16 +502,14 @@ LearningStats ComputeGradient(Position& pos, SharedData& shared_data,
   assert(legal_moves[0].move == teacher_move);
 
   // 探索の準備をする
-  Search search(shared_data);
-  search.set_learning_mode(true);
-  search.PrepareForNextSearch();
-  shared_data.countermoves_history.Clear();
-  Node node(pos);
+  Node& node = workspace.Reset(pos, true);
+  Search& search = workspace.search;
 
   // 子ノードを探索する
-  std::vector<std::vector<Move>> pv_list(legal_moves.size());
-  std::valarray<int> scores(legal_moves.size());
-  const int margin = static_cast<int>(10.0f + 256.0f * progress);
+  std::vector<std::vector<Move>>& pv_list = searched_pvs->pv_list;
+  std::valarray<int>& scores = searched_pvs->scores;
+  pv_list.resize(legal_moves.size());
+  scores.resize(legal_moves.size());
   Score alpha = -kScoreKnownWin;
   const Score beta = kScoreKnownWin;
   Score best_score = -kScoreInfinite;
@@ -509,12 +544,7 @@ LearningStats ComputeGradient(Position& pos, SharedData& shared_data,
 
     // 詰みを見つけた場合は探索を打ち切る（学習に適さないと考えられるため）
     if (score >= kScoreKnownWin || (move == teacher_move && score <= alpha)) {
-      stats.loss              = 0.0f;
-      stats.num_positions     = 0;
-      stats.num_right_answers = 0;
-      stats.num_moves         = 0;
-      stats.num_samples       = 0;
-      stats.num_nodes         = search.num_nodes_searched();
+      stats.num_nodes = search.num_nodes_searched();
       return stats;
     }
 
@@ -540,6 +570,111 @@ LearningStats ComputeGradient(Position& pos, SharedData& shared_data,
     }
   }
 
+  searched_pvs->valid     = true;
+  searched_pvs->num_pvs   = num_pvs;
+  searched_pvs->num_moves = legal_moves.size();
+  searched_pvs->best_move = best_move;
+  stats.num_nodes = search.num_nodes_searched();
+  return stats;
+}
+
+/**
+ * 以前に探索したPVの末端局面を、現在のパラメータで評価し直します.
+ * PVの再利用時に、再探索の代わりに用いられます。
+ */
+void RescorePvs(Position& pos, SearchedPvs* const searched_pvs) {
+  assert(searched_pvs != nullptr);
+
+  const Color root_side_to_move = pos.side_to_move();
+  std::valarray<int>& scores = searched_pvs->scores;
+  int best_score = -kScoreInfinite;
+
+  for (size_t i = 0; i < searched_pvs->pv_list.size(); ++i) {
+    const std::vector<Move>& pv = searched_pvs->pv_list.at(i);
+    // ウィンドウを外れた手は、-∞のままにしておく
+    if (pv.empty()) {
+      continue;
+    }
+
+    // リーフノードへ移動して評価する
+    for (Move m : pv) {
+      pos.MakeMove(m);
+    }
+    Score score = Evaluation::Evaluate(pos);
+    scores[i] = pos.side_to_move() == root_side_to_move ? score : -score;
+    for (auto it = pv.rbegin(); it != pv.rend(); ++it) {
+      pos.UnmakeMove(*it);
+    }
+
+    if (scores[i] > best_score) {
+      best_score = scores[i];
+      searched_pvs->best_move = pv.front();
+    }
+  }
+}
+
+/**
+ * １つの特定の局面について、損失関数の勾配を計算します.
+ *
+ * なお、現在の実装では、評価関数の学習に用いる損失関数は、
+ *    - 第1項: 棋譜の手との不一致率（idea from 激指）
+ *    - 第2項: 勝率予測と勝敗との負の対数尤度（idea from 習甦）
+ *    - 第3項: 浅い探索結果と深い探索結果との誤差（idea from 習甦）
+ * の３つから構成されています。
+ *
+ * （参考文献）
+ *   - 鶴岡慶雅: 「激指」の最近の改良について --コンピュータ将棋と機械学習--,
+ *     『コンピュータ将棋の進歩６』, pp.77-81, 共立出版, 2012.
+ *   - 竹内章: 習甦の誕生, 『人間に勝つコンピュータ将棋の作り方』, pp.184-189, 技術評論社, 2012.
+ *   - 佐藤佳州: ゲームにおける棋譜の性質と強さの関係に基づいた学習, pp.66-67, 2014.
+ *
+ * @param pos              損失関数の勾配を計算したい局面
+ * @param workspace        探索用の作業領域
+ * @param teacher_move     教師とすべき、棋譜の手
+ * @param progress         局面の進行度（初期局面が0で、投了局面が1となる値）
+ * @param winner           その対局で勝った側の手番
+ * @param reuse_pvs        trueの場合は、探索を行わず、searched_pvsに保存されているPVを再利用する
+ * @param mersenne_twister 乱数生成器（メルセンヌ・ツイスタ）
+ * @param searched_pvs     探索で得られたPV（reuse_pvsがfalseの場合は、ここに保存される）
+ * @param gradient         損失関数の勾配
+ * @return 学習中の統計データ
+ */
+LearningStats ComputeGradient(Position& pos, SearchWorkspace& workspace,
+                              const Move teacher_move, const float progress,
+                              const Color winner, const bool reuse_pvs,
+                              std::mt19937& mersenne_twister,
+                              SearchedPvs* const searched_pvs,
+                              Gradient* const gradient) {
+  assert(searched_pvs != nullptr);
+  assert(gradient != nullptr);
+
+  LearningStats stats;
+  const int margin = static_cast<int>(10.0f + 256.0f * progress);
+
+  if (reuse_pvs) {
+    // 以前のPVを再利用する場合は、末端局面の評価値だけを計算し直す
+    if (!searched_pvs->valid) {
+      return stats;
+    }
+    RescorePvs(pos, searched_pvs);
+    stats.num_reused_positions = 1;
+  } else {
+    *searched_pvs = SearchedPvs();
+    const auto start_time = std::chrono::steady_clock::now();
+    stats = SearchPvs(pos, workspace, teacher_move, margin, mersenne_twister,
+                      searched_pvs);
+    const auto end_time = std::chrono::steady_clock::now();
+    stats.search_time = std::chrono::duration<double>(end_time - start_time).count();
+    stats.num_searched_positions = 1;
+    if (!searched_pvs->valid) {
+      return stats;
+    }
+  }
+
+  const std::vector<std::vector<Move>>& pv_list = searched_pvs->pv_list;
+  const std::valarray<int>& scores = searched_pvs->scores;
+  const int num_pvs = searched_pvs->num_pvs;
+
   //
   // 損失関数の第1項: 棋譜の手との不一致率（idea from 激指）
   //
@@ -577,9 +712,8 @@ LearningStats ComputeGradient(Position& pos, SharedData& shared_data,
   ComputeGradientOfOscillationLoss(pv_list, num_pvs, scores, pos, gradient, &stats);
 
   stats.num_positions     = 1;
-  stats.num_right_answers = (best_move == teacher_move);
-  stats.num_moves         = legal_moves.size();
-  stats.num_nodes         = search.num_nodes_searched();
+  stats.num_right_answers = (searched_pvs->best_move == teacher_move);
+  stats.num_moves         = searched_pvs->num_moves;
 
   return stats;
 }
@@ -870,10 +1004,50 @@ void PrintParams(const std::unique_ptr<ExtendedParams>& params, int index) {
               params->tempo[0], params->tempo[1], params->tempo[2]);
 }
 
+/**
+ * 前回コピーしたときから、ExtendedParamsの各テーブルの値が変化したかどうかを調べるためのクラスです.
+ */
+class TableChangeDetector {
+ public:
+  /**
+   * @param current  現在のパラメータ
+   * @param previous 前回コピーしたときのパラメータ（nullptrの場合は、すべてのテーブルが変化したものとみなす）
+   */
+  TableChangeDetector(const ExtendedParams& current,
+                      const ExtendedParams* const previous)
+      : current_(reinterpret_cast<const char*>(&current)),
+        previous_(reinterpret_cast<const char*>(previous)) {
+  }
+
+  /**
+   * テーブルの値が変化していれば、trueを返します.
+   * @param table currentのメンバであるテーブル
+   */
+  template<typename T>
+  bool operator()(const T& table) const {
+    if (previous_ == nullptr) {
+      return true;
+    }
+    const ptrdiff_t offset = reinterpret_cast<const char*>(&table) - current_;
+    return std::memcmp(&table, previous_ + offset, sizeof(T)) != 0;
+  }
+
+ private:
+  const char* const current_;
+  const char* const previous_;
+};
+
 /*
- * 現在学習中のパラメータを、探索用のパラメータ（g_eval_params）にコピーします.
+ * 現在学習中のパラメータを、探索用のパラメータ（デフォルトでは、g_eval_params）にコピーします.
+ * g_eval_params以外にコピーする場合は、駒割りのテーブル（Material）は更新しません。
+ *
+ * previous_paramsに前回コピーしたときのパラメータを渡すと、値が変化したテーブルに依存する部分のみを
+ * コピーし直し、その後previous_paramsを現在のパラメータで上書きします。
  */
-void CopyParams(const std::unique_ptr<ExtendedParams>& params) {
+void CopyParams(const std::unique_ptr<ExtendedParams>& params,
+                EvalParameters* const eval_params = g_eval_params.get(),
+                ExtendedParams* const previous_params = nullptr) {
+  assert(eval_params != nullptr);
 
   auto to_packed_score = [](PackedWeight& x) -> PackedScore {
     PackedWeight score = x * static_cast<float>(kFvScale);
@@ -883,6 +1057,8 @@ void CopyParams(const std::unique_ptr<ExtendedParams>& params) {
                        static_cast<int32_t>(score[3]));
   };
 
+  const TableChangeDetector changed(*params, previous_params);
+
   // 1. 駒の価値をコピーする
   for (PieceType pt : Piece::all_piece_types()) {
     // 序盤〜中盤〜終盤を通した、平均的な駒の価値を求める
@@ -891,104 +1067,169 @@ void CopyParams(const std::unique_ptr<ExtendedParams>& params) {
     value += 0.50f * params->material[pt][1]; // 中盤
     value += 0.25f * params->material[pt][2]; // 終盤
     int int_value = static_cast<int>(value);
-    g_eval_params->material[pt] = static_cast<Score>(int_value);
+    eval_params->material[pt] = static_cast<Score>(int_value);
+  }
+  if (eval_params == g_eval_params.get()) {
+    Material::UpdateTables();
   }
-  Material::UpdateTables();
 
   // 2. KPをコピー
+  if (   changed(params->material)
+      || changed(params->relative_kp)
+      || changed(params->absolute_kp)) {
 #pragma omp parallel for schedule(static)
-  for (int i = Square::min(); i <= Square::max(); ++i) {
-    Square king_sq(i);
-    for (PsqIndex psq : PsqIndex::all_indices()) {
-      ExtendedParams::Accumulator accumulator;
-      auto sum = params->EachKP<kBlack>(king_sq, psq, accumulator).sum();
-      PackedScore packed_score = to_packed_score(sum);
-      packed_score[3] = Progress::weights[king_sq][psq]; // 進行度を保存する
-      g_eval_params->king_piece[king_sq][psq] = packed_score;
+    for (int i = Square::min(); i <= Square::max(); ++i) {
+      Square king_sq(i);
+      for (PsqIndex psq : PsqIndex::all_indices()) {
+        ExtendedParams::Accumulator accumulator;
+        auto sum = params->EachKP<kBlack>(king_sq, psq, accumulator).sum();
+        PackedScore packed_score = to_packed_score(sum);
+        packed_score[3] = Progress::weights[king_sq][psq]; // 進行度を保存する
+        eval_params->king_piece[king_sq][psq] = packed_score;
+      }
     }
   }
 
   // 3. PPをコピー
+  if (   changed(params->hand_value)
+      || changed(params->relative_pp)
+      || changed(params->relative_ppy)
+      || changed(params->absolute_pp)) {
 #pragma omp parallel for schedule(static)
-  for (int i = PsqIndex::min(); i <= PsqIndex::max(); ++i) {
-    PsqIndex psq1(i);
-    for (PsqIndex psq2 : PsqIndex::all_indices()) {
-      ExtendedParams::Accumulator accumulator;
-      auto sum = params->EachPP(psq1, psq2, accumulator).sum();
-      g_eval_params->two_pieces[psq1][psq2] = to_packed_score(sum);
+    for (int i = PsqIndex::min(); i <= PsqIndex::max(); ++i) {
+      PsqIndex psq1(i);
+      for (PsqIndex psq2 : PsqIndex::all_indices()) {
+        ExtendedParams::Accumulator accumulator;
+        auto sum = params->EachPP(psq1, psq2, accumulator).sum();
+        eval_params->two_pieces[psq1][psq2] = to_packed_score(sum);
+      }
     }
   }
 
   const auto all_pieces_plus_no_piece = Piece::all_pieces().set(kNoPiece);
 
   // 4. 各マスの利き評価をコピー
+  if (   changed(params->psqc_absolute)
+      || changed(params->psqc_relative)
+      || changed(params->floating_or_hostage_absolute)
+      || changed(params->floating_or_hostage_relative)
+      || changed(params->own_controls_absolute)
+      || changed(params->own_controls_relative)
+      || changed(params->opp_controls_absolute)
+      || changed(params->opp_controls_relative)
+      || changed(params->diff_controls_absolute)
+      || changed(params->controls_relative)
+      || changed(params->capture_threat)) {
 #pragma omp parallel for schedule(static)
-  for (int i = PsqControlIndex::min(); i <= PsqControlIndex::max(); ++i) {
-    PsqControlIndex index(i);
-    if (index.IsOk()) {
-      for (Square ksq : Square::all_squares()) {
-        ExtendedParams::Accumulator accumulator;
-        auto sum_b = params->EachControl<kBlack>(ksq, index, accumulator).sum();
-        auto sum_w = params->EachControl<kWhite>(ksq, index, accumulator).sum();
-        g_eval_params->controls[kBlack][ksq][index] = to_packed_score(sum_b);
-        g_eval_params->controls[kWhite][ksq][index] = to_packed_score(sum_w);
+    for (int i = PsqControlIndex::min(); i <= PsqControlIndex::max(); ++i) {
+      PsqControlIndex index(i);
+      if (index.IsOk()) {
+        for (Square ksq : Square::all_squares()) {
+          ExtendedParams::Accumulator accumulator;
+          auto sum_b = params->EachControl<kBlack>(ksq, index, accumulator).sum();
+          auto sum_w = params->EachControl<kWhite>(ksq, index, accumulator).sum();
+          eval_params->controls[kBlack][ksq][index] = to_packed_score(sum_b);
+          eval_params->controls[kWhite][ksq][index] = to_packed_score(sum_w);
+        }
       }
     }
   }
 
   // 5. 玉の安全度をコピー
+  if (   changed(params->king_on_the_edge)
+      || changed(params->weak_points_of_king)
+      || changed(params->attacker_controls)
+      || changed(params->diff_controls)
+      || changed(params->controls_advantage)
+      || changed(params->neighborhood_pieces)
+      || changed(params->drop_check_threat)
+      || changed(params->king_safety)) {
 #pragma omp parallel for schedule(static)
-  for (unsigned h = HandSet::min(); h <= HandSet::max(); ++h)
-    for (int d = 0; d < 8; ++d)
-      for (Piece piece : all_pieces_plus_no_piece)
-        for (int attacks = 0; attacks < 4; ++attacks)
-          for (int defenses = 0; defenses < 4; ++defenses) {
+    for (unsigned h = HandSet::min(); h <= HandSet::max(); ++h)
+      for (int d = 0; d < 8; ++d)
+        for (Piece piece : all_pieces_plus_no_piece)
+          for (int attacks = 0; attacks < 4; ++attacks)
+            for (int defenses = 0; defenses < 4; ++defenses) {
+              ExtendedParams::Accumulator accumulator;
+              HandSet hand_set(h);
+              Direction dir = static_cast<Direction>(d);
+              auto sum = params->EachKingSafety<kBlack>(hand_set, dir, piece,
+                                                        attacks, defenses,
+                                                        accumulator).sum();
+              PackedScore ps = to_packed_score(sum);
+              eval_params->king_safety[hand_set][dir][piece][attacks][defenses] = ps;
+            }
+  }
+
+  // 6. 飛車・角・香車の利きをコピー（駒の種類ごとに、値が変化した場合のみコピーする）
+  const bool rook_control   = changed(params->rook_control);
+  const bool bishop_control = changed(params->bishop_control);
+  const bool lance_control  = changed(params->lance_control);
+  const bool rook_threat    = changed(params->rook_threatened_piece)
+                           || changed(params->rook_threat);
+  const bool bishop_threat  = changed(params->bishop_threatened_piece)
+                           || changed(params->bishop_threat);
+  const bool lance_threat   = changed(params->lance_threatened_piece)
+                           || changed(params->lance_threat);
+  if (   rook_control || bishop_control || lance_control
+      || rook_threat || bishop_threat || lance_threat) {
+#pragma omp parallel for schedule(static)
+    for (int s = Square::min(); s <= Square::max(); ++s) {
+      Square i(s);
+      for (Color c : {kBlack, kWhite})
+        for (Square j : Square::all_squares())
+          for (Square k : Square::all_squares()) {
             ExtendedParams::Accumulator accumulator;
-            HandSet hand_set(h);
-            Direction dir = static_cast<Direction>(d);
-            auto sum = params->EachKingSafety<kBlack>(hand_set, dir, piece,
-                                                      attacks, defenses,
-                                                      accumulator).sum();
-            PackedScore ps = to_packed_score(sum);
-            g_eval_params->king_safety[hand_set][dir][piece][attacks][defenses] = ps;
+            if (rook_control) {
+              auto sum_r = params->EachSliderControl<kBlack, kRook>(c, i, j, k, accumulator).sum();
+              eval_params->rook_control[c][i][j][k] = to_packed_score(sum_r);
+            }
+            if (bishop_control) {
+              auto sum_b = params->EachSliderControl<kBlack, kBishop>(c, i, j, k, accumulator).sum();
+              eval_params->bishop_control[c][i][j][k] = to_packed_score(sum_b);
+            }
+            if (lance_control) {
+              auto sum_l = params->EachSliderControl<kBlack, kLance>(c, i, j, k, accumulator).sum();
+              eval_params->lance_control[c][i][j][k] = to_packed_score(sum_l);
+            }
           }
 
-  // 6. 飛車・角・香車の利きをコピー
-#pragma omp parallel for schedule(static)
-  for (int s = Square::min(); s <= Square::max(); ++s) {
-    Square i(s);
-    for (Color c : {kBlack, kWhite})
       for (Square j : Square::all_squares())
-        for (Square k : Square::all_squares()) {
-          ExtendedParams::Accumulator accumulator;
-          auto sum_r = params->EachSliderControl<kBlack, kRook>(c, i, j, k, accumulator).sum();
-          auto sum_b = params->EachSliderControl<kBlack, kBishop>(c, i, j, k, accumulator).sum();
-          auto sum_l = params->EachSliderControl<kBlack, kLance>(c, i, j, k, accumulator).sum();
-          g_eval_params->rook_control[c][i][j][k] = to_packed_score(sum_r);
-          g_eval_params->bishop_control[c][i][j][k] = to_packed_score(sum_b);
-          g_eval_params->lance_control[c][i][j][k] = to_packed_score(sum_l);
+        for (Piece p : Piece::all_pieces()) {
+           ExtendedParams::Accumulator accumulator;
+           if (rook_threat) {
+             auto sum_r = params->EachThreat<kBlack, kRook>(i, j, p, accumulator).sum();
+             eval_params->rook_threat[i][j][p] = to_packed_score(sum_r);
+           }
+           if (bishop_threat) {
+             auto sum_b = params->EachThreat<kBlack, kBishop>(i, j, p, accumulator).sum();
+             eval_params->bishop_threat[i][j][p] = to_packed_score(sum_b);
+           }
+           if (lance_threat) {
+             auto sum_l = params->EachThreat<kBlack, kLance>(i, j, p, accumulator).sum();
+             eval_params->lance_threat[i][j][p] = to_packed_score(sum_l);
+           }
         }
-
-    for (Square j : Square::all_squares())
-      for (Piece p : Piece::all_pieces()) {
-         ExtendedParams::Accumulator accumulator;
-         auto sum_r = params->EachThreat<kBlack, kRook>(i, j, p, accumulator).sum();
-         auto sum_b = params->EachThreat<kBlack, kBishop>(i, j, p, accumulator).sum();
-         auto sum_l = params->EachThreat<kBlack, kLance>(i, j, p, accumulator).sum();
-         g_eval_params->rook_threat[i][j][p] = to_packed_score(sum_r);
-         g_eval_params->bishop_threat[i][j][p] = to_packed_score(sum_b);
-         g_eval_params->lance_threat[i][j][p] = to_packed_score(sum_l);
-      }
+    }
   }
 
   // 7. 手番をコピー
-  g_eval_params->tempo = to_packed_score(params->tempo);
+  eval_params->tempo = to_packed_score(params->tempo);
+
+  // 8. 次回の差分コピーのために、今回コピーしたパラメータを保存しておく
+  if (previous_params != nullptr) {
+    *previous_params = *params;
+  }
 }
 
 /*
  * 学習したパラメータを用いて、棋譜（テストデータ）との一致率を計算する。
+ * 学習と並行して実行できるように、一致率の計算には、引数で渡されたパラメータのスナップショットと、
+ * その駒割りから作成した駒の価値のテーブルを用いる（共有のテーブルは、学習中に書き換えられるため）。
  */
-float ComputeAccuracy(const std::vector<Game>& games) {
+float ComputeAccuracy(const std::vector<Game>& games,
+                      const EvalParameters* const eval_params,
+                      const MaterialTables* const material_tables) {
   // 設定変数
   const int transposition_table_size = 1;
   const Score alpha = -kScoreKnownWin, beta = kScoreKnownWin;
@@ -996,9 +1237,11 @@ float ComputeAccuracy(const std::vector<Game>& games) {
   ProgressTimer timer(games.size());
   int sum_accuracy = 0, num_positions = 0;
 
-#pragma omp parallel for schedule(dynamic)
+#pragma omp parallel for schedule(dynamic) num_threads(kValidationThreads)
   for (size_t game_id = 0; game_id < games.size(); ++game_id) {
     const Game& game = games.at(game_id);
+    Evaluation::SetThreadParameters(eval_params);
+    Material::SetThreadTables(material_tables);
     Node node(Position::CreateStartPosition());
     SharedData shared_data;
     shared_data.hash_table.SetSize(transposition_table_size);
@@ -1023,6 +1266,10 @@ float ComputeAccuracy(const std::vector<Game>& games) {
       node.Evaluate(); // 評価関数の差分計算を行うために必要
     }
 
+    // スナップショットは交差検定の終了後に破棄されるので、このスレッドの参照を元に戻しておく
+    Evaluation::SetThreadParameters(nullptr);
+    Material::SetThreadTables(nullptr);
+
     timer.IncrementCounter();
     timer.PrintProgress("Accuracy=%f%% (%d/%d)",
                         static_cast<float>(sum_accuracy) / num_positions,
@@ -1032,6 +1279,46 @@ float ComputeAccuracy(const std::vector<Game>& games) {
   return static_cast<float>(sum_accuracy) / num_positions;
 }
 
+/**
+ * バックグラウンドで行われた交差検定の結果です.
+ */
+struct ValidationResult {
+  int iteration = 0;
+  LearningStats stats;  // 交差検定を開始したイテレーションでの統計データ
+  float accuracy = 0.0f;
+};
+
+/**
+ * 交差検定の結果と、その時点での学習時の統計データを、ログファイルに出力します.
+ */
+void WriteValidationLog(const ValidationResult& result) {
+  const LearningStats& stats = result.stats;
+  std::FILE* fp_log = std::fopen("learning_log.txt", "a");
+  if (fp_log == nullptr) {
+    std::printf("Failed to open learning_log.txt.\n");
+    return;
+  }
+  std::fprintf(fp_log,
+               "%d loss=%.0f penalty=%.1f wr_l=%.1f wr_e=%f o_l=%.1f o_e=%.1f o_s=%.0f accuracy=%f prediction=%f pos=%d moves=%d samples=%d nodes=%d\n",
+               result.iteration,
+               stats.loss,
+               stats.penalty,
+               stats.win_rate_loss,
+               std::sqrt(stats.win_rate_error / stats.win_rate_samples),
+               stats.oscillation_loss,
+               std::sqrt(stats.oscillation_error / stats.oscillation_samples),
+               stats.oscillation_samples,
+               result.accuracy,
+               (float)stats.num_right_answers / stats.num_positions,
+               stats.num_positions,
+               stats.num_moves,
+               stats.num_samples,
+               stats.num_nodes);
+  std::fclose(fp_log);
+  std::printf("Cross validation at iteration %d: accuracy=%f\n",
+              result.iteration, result.accuracy);
+}
+
 } // namespace
 
 void Learning::LearnEvaluationParameters(const bool use_rootstrap,
@@ -1093,17 +1380,23 @@ void Learning::LearnEvaluationParameters(const bool use_rootstrap,
   std::unique_ptr<ExtendedParams> accumulated_gradient(new ExtendedParams);
   std::unique_ptr<ExtendedParams> current_params(new ExtendedParams);
   std::unique_ptr<ExtendedParams> accumulated_params(new ExtendedParams);
+  std::unique_ptr<ExtendedParams> copied_params(new ExtendedParams);
   std::unique_ptr<Gradient> gradient(new Gradient);
   std::vector<Gradient> thread_local_gradient(num_threads);
-  std::vector<SharedData> shared_data(num_threads);
+  std::vector<std::unique_ptr<SearchWorkspace>> workspaces;
+  for (int i = 0; i < num_threads; ++i) {
+    workspaces.emplace_back(new SearchWorkspace);
+  }
+  std::vector<SearchedPvs> searched_pvs(kBatchSize);
   g_eval_params->Clear();
   accumulated_gradient->Clear();
   current_params->Clear();
   accumulated_params->Clear();
   ResetMaterialValues(current_params.get());
   CopyParams(current_params);
-  for (auto& s : shared_data) {
-    s.hash_table.SetSize(64);
+  *copied_params = *current_params;
+  for (auto& w : workspaces) {
+    w->shared_data.hash_table.SetSize(64);
   }
 
   // ログファイルのクリア
@@ -1122,6 +1415,9 @@ void Learning::LearnEvaluationParameters(const bool use_rootstrap,
     std::fclose(fp);
   }
 
+  // バックグラウンドで行われている交差検定
+  std::future<ValidationResult> validation;
+
   // 学習のイテレーションを開始する
   for (int iteration = 1; iteration <= kNumIteration; ++iteration) {
     if (kVerboseMessage) {
@@ -1129,8 +1425,17 @@ void Learning::LearnEvaluationParameters(const bool use_rootstrap,
     }
 
     // 学習に使う局面をシャッフルする（復元抽出）
+    // PVを再利用する場合は、PVが古くなった局面だけを新しい局面と入れ替える。
+    // 全局面が同時に古くならないように、最初のイテレーションでは、探索したイテレーションをずらして記録する。
+    std::vector<bool> reuse_pvs(kBatchSize, false);
     for (int i = 0; i < kBatchSize; ++i) {
-      std::uniform_int_distribution<size_t> dis(i, position_ids.size() - 1);
+      if (   iteration > 1
+          && iteration - searched_pvs.at(i).searched_iteration < kPvReuseInterval) {
+        reuse_pvs.at(i) = true;
+        continue;
+      }
+      size_t first = kPvReuseInterval > 1 ? kBatchSize : i;
+      std::uniform_int_distribution<size_t> dis(first, position_ids.size() - 1);
       auto begin = position_ids.begin();
       std::iter_swap(begin + i, begin + dis(mersenne_twisters.front()));
     }
@@ -1139,7 +1444,7 @@ void Learning::LearnEvaluationParameters(const bool use_rootstrap,
 #pragma omp parallel for schedule(static, 1)
     for (int i = 0; i < num_threads; ++i) {
       thread_local_gradient.at(i).Clear();
-      shared_data.at(i).Clear();
+      workspaces.at(i)->shared_data.Clear();
     }
 
     // 勾配を計算する
@@ -1164,10 +1469,17 @@ void Learning::LearnEvaluationParameters(const bool use_rootstrap,
       Move teacher_move = game.moves.at(ply);
       float progress = float(ply) / float(game.moves.size());
       Color winner = game.result == Game::kBlackWin ? kBlack : kWhite;
-      auto temp = ComputeGradient(pos, shared_data.at(thread_id),
+      auto temp = ComputeGradient(pos, *workspaces.at(thread_id),
                                   teacher_move, progress, winner,
+                                  reuse_pvs.at(i),
                                   mersenne_twisters.at(thread_id),
+                                  &searched_pvs.at(i),
                                   &thread_local_gradient.at(thread_id));
+      if (!reuse_pvs.at(i)) {
+        searched_pvs.at(i).searched_iteration = iteration == 1
+                                              ? 1 - (i % kPvReuseInterval)
+                                              : iteration;
+      }
 #pragma omp critical
       stats += temp;
     }
@@ -1187,7 +1499,7 @@ void Learning::LearnEvaluationParameters(const bool use_rootstrap,
         const TeacherPosition& teacher_pos = rootstrap_positions.at(i);
         LearningStats temp;
         int thread_id = omp_get_thread_num();
-        ComputeGradientOfRootStrapLoss(teacher_pos, shared_data.at(thread_id),
+        ComputeGradientOfRootStrapLoss(teacher_pos, *workspaces.at(thread_id),
                                        &thread_local_gradient.at(thread_id),
                                        &temp);
 #pragma omp critical
@@ -1236,7 +1548,11 @@ void Learning::LearnEvaluationParameters(const bool use_rootstrap,
       std::printf("Update the evaluation parameters...\n");
     }
     stats += UpdateParams(convoluted_gradient, accumulated_gradient, current_params);
-    CopyParams(current_params);
+    const auto copy_start_time = std::chrono::steady_clock::now();
+    CopyParams(current_params, g_eval_params.get(),
+               kIncrementalCopyParams ? copied_params.get() : nullptr);
+    const auto copy_end_time = std::chrono::steady_clock::now();
+    const double copy_time = std::chrono::duration<double>(copy_end_time - copy_start_time).count();
 
     // 後で平均化パラメータを求めるために、現在のパラメータを足し込んでおく
 #pragma omp parallel for schedule(static)
@@ -1245,7 +1561,7 @@ void Learning::LearnEvaluationParameters(const bool use_rootstrap,
       (*accumulated_params)[i] += (*current_params)[i];
     }
 
-    if (iteration % 100 == 0) {
+    if (iteration % kValidationInterval == 0) {
       // 平均化パラメータを求める
       // ここでは、より直近のデータを重視するため、「指数移動平均」を使っている。
       // （参考文献）
@@ -1263,8 +1579,12 @@ void Learning::LearnEvaluationParameters(const bool use_rootstrap,
       PrintParams(average, 1);
       PrintParams(average, 2);
 
-      // ファイル保存＆一致率計算には、平均化パラメータを使用
-      CopyParams(average);
+      // ファイル保存＆一致率計算には、平均化パラメータのスナップショットを使用
+      // （g_eval_paramsは学習中のパラメータのままにしておく）
+      std::shared_ptr<EvalParameters> snapshot(new EvalParameters);
+      CopyParams(average, snapshot.get());
+      std::shared_ptr<MaterialTables> snapshot_material(new MaterialTables);
+      snapshot_material->Update(*snapshot);
 
       // 平均化パラメータをファイルに保存する
       std::FILE* fp_params = std::fopen("params.bin", "wb");
@@ -1272,40 +1592,31 @@ void Learning::LearnEvaluationParameters(const bool use_rootstrap,
         std::printf("Failed to open params.bin.\n");
         break;
       }
-      std::fwrite(g_eval_params.get(), sizeof(EvalParameters), 1, fp_params);
+      std::fwrite(snapshot.get(), sizeof(EvalParameters), 1, fp_params);
       std::fclose(fp_params);
       std::printf("Wrote parameters to params.bin\n");
 
-      // 交差検定を行い、棋譜の手との一致率を計算する
-       std::printf("Perform the cross validation...\n");
-      float accuracy = ComputeAccuracy(test_set);
+      // 前回の交差検定がまだ終わっていなければ、終了を待ってから結果を記録する
+      if (validation.valid()) {
+        WriteValidationLog(validation.get());
+      }
 
-      // ファイル保存＆一致率計算後は、元のパラメータに戻す
-      CopyParams(current_params);
+      // 交差検定を、学習と並行してバックグラウンドで行い、棋譜の手との一致率を計算する
+      std::printf("Start the cross validation in the background...\n");
+      validation = std::async(std::launch::async, [=, &test_set]() {
+        ValidationResult result;
+        result.iteration = iteration;
+        result.stats = stats;
+        result.accuracy = ComputeAccuracy(test_set, snapshot.get(),
+                                          snapshot_material.get());
+        return result;
+      });
+    }
 
-      // 学習時の統計データをログファイルに出力する
-      std::FILE* fp_log = std::fopen("learning_log.txt", "a");
-      if (fp_log == nullptr) {
-        std::printf("Failed to open learning_log.txt.\n");
-        break;
-      }
-      std::fprintf(fp_log,
-                   "%d loss=%.0f penalty=%.1f wr_l=%.1f wr_e=%f o_l=%.1f o_e=%.1f o_s=%.0f accuracy=%f prediction=%f pos=%d moves=%d samples=%d nodes=%d\n",
-                   iteration,
-                   stats.loss,
-                   stats.penalty,
-                   stats.win_rate_loss,
-                   std::sqrt(stats.win_rate_error / stats.win_rate_samples),
-                   stats.oscillation_loss,
-                   std::sqrt(stats.oscillation_error / stats.oscillation_samples),
-                   stats.oscillation_samples,
-                   accuracy,
-                   (float)stats.num_right_answers / stats.num_positions,
-                   stats.num_positions,
-                   stats.num_moves,
-                   stats.num_samples,
-                   stats.num_nodes);
-      std::fclose(fp_log);
+    // 交差検定が終わっていれば、結果をログファイルに出力する
+    if (   validation.valid()
+        && validation.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+      WriteValidationLog(validation.get());
     }
 
     // 学習途中の駒割りの値をファイルに出力する
@@ -1324,7 +1635,7 @@ void Learning::LearnEvaluationParameters(const bool use_rootstrap,
     }
 
     // 学習中の統計データを画面に表示する
-    std::printf("%d loss=%.0f L1=%.0f rs_l=%.0f rs_e=%f lr_l=%.0f lr_e=%f wr_l=%.0f wr_e=%f o_l=%.0f o_e=%.1f prediction=%f pos=%d moves=%d samples=%d nodes=%d\n",
+    std::printf("%d loss=%.0f L1=%.0f rs_l=%.0f rs_e=%f lr_l=%.0f lr_e=%f wr_l=%.0f wr_e=%f o_l=%.0f o_e=%.1f prediction=%f pos=%d moves=%d samples=%d nodes=%d copy_params=%.3fs\n",
                 iteration,
                 stats.loss,
                 stats.penalty,
@@ -1340,7 +1651,24 @@ void Learning::LearnEvaluationParameters(const bool use_rootstrap,
                 stats.num_positions,
                 stats.num_moves,
                 stats.num_samples,
-                stats.num_nodes);
+                stats.num_nodes,
+                copy_time);
+
+    // PVを再利用した場合は、省略できた探索時間の見積もりを表示する
+    if (kPvReuseInterval > 1 && stats.num_searched_positions > 0) {
+      double time_per_position = stats.search_time / stats.num_searched_positions;
+      std::printf("%d searched=%d reused=%d search_time=%.1fs saved_time=%.1fs\n",
+                  iteration,
+                  stats.num_searched_positions,
+                  stats.num_reused_positions,
+                  stats.search_time,
+                  time_per_position * stats.num_reused_positions);
+    }
+  }
+
+  // 最後の交差検定の終了を待つ
+  if (validation.valid()) {
+    WriteValidationLog(validation.get());
   }
 
   std::printf("Congratulations! Learning is successfully finished!\n");
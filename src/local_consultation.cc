@@ -0,0 +1,271 @@
+/*
+ * 技巧 (Gikou), a USI shogi (Japanese chess) playing engine.
+ * Copyright (C) 2016-2017 Yosuke Demura
+ * except where otherwise indicated.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "local_consultation.h"
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <thread>
+#include "evaluation.h"
+#include "material.h"
+#include "memory_report.h"
+#include "node.h"
+#include "synced_printf.h"
+#include "usi.h"
+
+ConsultationVoter::ConsultationVoter(const UsiOptions& usi_options,
+                                     size_t voter_id)
+    : usi_options_(usi_options),
+      voter_id_(voter_id),
+      time_manager_(usi_options, &shared_data_.signals),
+      thread_manager_(shared_data_, time_manager_) {
+}
+
+ConsultationVoter::~ConsultationVoter() {
+}
+
+void ConsultationVoter::Initialize(size_t hash_size,
+                                   const std::string& params_file) {
+  if (!shared_data_.hash_table.SetSize(hash_size)) {
+    SYNCED_PRINTF("info string Voter %d: Failed to allocate %zu MB for the hash table. Using %.2f MB instead.\n",
+                  int(voter_id_), hash_size, shared_data_.hash_table.memory_size() / (1024.0 * 1024.0));
+  }
+  shared_data_.countermoves_history.Clear();
+
+  // パラメータファイルが指定されていない場合は、g_eval_paramsを共有する
+  eval_params_.reset();
+  material_tables_.reset();
+  shared_data_.eval_params = nullptr;
+  shared_data_.material_tables = nullptr;
+  if (params_file.empty()) {
+    return;
+  }
+  eval_params_.reset(new EvalParameters);
+  if (Evaluation::ReadParametersFromFile(params_file.c_str(), eval_params_.get())) {
+    shared_data_.eval_params = eval_params_.get();
+    // 駒の価値（SEE、指し手の順序付け、駒割りの評価に用いる）も、この投票者のパラメータに合わせる
+    material_tables_.reset(new MaterialTables);
+    material_tables_->Update(*eval_params_);
+    shared_data_.material_tables = material_tables_.get();
+  } else {
+    SYNCED_PRINTF("info string Voter %d uses the default parameters.\n",
+                  int(voter_id_));
+    eval_params_.reset();
+  }
+}
+
+RootMove ConsultationVoter::Search(const Node& root_node,
+                                   const UsiGoOptions& go_options,
+                                   const std::vector<RootMove>& root_moves,
+                                   Score draw_score, int multipv,
+                                   int depth_limit, uint64_t nodes_limit) {
+  time_manager_.StartTimeManagement(root_node, go_options);
+
+  Node node = root_node;
+  thread_manager_.SetNumSearchThreads(usi_options_["Threads"]);
+  RootMove best_root_move = thread_manager_.ParallelSearch(node, draw_score,
+                                                           root_moves, multipv,
+                                                           depth_limit,
+                                                           nodes_limit);
+
+  time_manager_.StopTimeManagement();
+  time_manager_.WaitUntilTaskIsFinished();
+  return best_root_move;
+}
+
+void ConsultationVoter::Stop() {
+  shared_data_.signals.stop = true;
+}
+
+void ConsultationVoter::Ponderhit() {
+  time_manager_.RecordPonderhitTime();
+  shared_data_.signals.ponderhit = true;
+}
+
+void ConsultationVoter::ReportMemoryUsage(MemoryReport* const report) const {
+  assert(report != nullptr);
+  std::string prefix = "Voter " + std::to_string(voter_id_) + ": ";
+  report->Add(prefix + "HashTable", shared_data_.hash_table.memory_size());
+  report->Add(prefix + "CountermovesHistoryStats",
+              CountermovesHistoryStats::memory_size());
+  if (eval_params_) {
+    report->Add(prefix + "EvalParameters", sizeof(EvalParameters));
+    report->Add(prefix + "MaterialTables", sizeof(MaterialTables));
+  }
+}
+
+LocalConsultation::LocalConsultation(const UsiOptions& usi_options)
+    : usi_options_(usi_options) {
+}
+
+void LocalConsultation::Initialize() {
+  const size_t num_voters = usi_options_["ConsultationVoters"];
+
+  // パラメータファイルのリストを、セミコロンで区切る
+  std::vector<std::string> params_files;
+  std::istringstream iss(usi_options_["ConsultationParams"].string());
+  for (std::string file; std::getline(iss, file, ';');) {
+    params_files.push_back(file);
+  }
+
+  voters_.clear();
+  if (num_voters < 2) {
+    return;
+  }
+
+  // 置換表は、各投票者で等分する
+  const size_t hash_size = std::max<size_t>(usi_options_["USI_Hash"] / num_voters, 1);
+  for (size_t i = 0; i < num_voters; ++i) {
+    voters_.emplace_back(new ConsultationVoter(usi_options_, i));
+    std::string params_file = i < params_files.size() ? params_files[i] : "";
+    voters_.back()->Initialize(hash_size, params_file);
+  }
+  set_info_callback(info_callback_);
+}
+
+RootMove LocalConsultation::Search(const Node& root_node,
+                                   const UsiGoOptions& go_options,
+                                   const std::vector<RootMove>& root_moves,
+                                   Score draw_score, int multipv,
+                                   int depth_limit, uint64_t nodes_limit,
+                                   bool quiet) {
+  assert(voters_.size() >= 2);
+
+  // 1. 各投票者の探索を並列に行う（最初の投票者は、このスレッドで探索する）
+  std::vector<RootMove> results(voters_.size(), RootMove(kMoveNone));
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < voters_.size(); ++i) {
+    threads.emplace_back([&, i]() {
+      results[i] = voters_[i]->Search(root_node, go_options, root_moves,
+                                      draw_score, multipv, depth_limit,
+                                      nodes_limit);
+    });
+  }
+  results[0] = voters_[0]->Search(root_node, go_options, root_moves,
+                                  draw_score, multipv, depth_limit,
+                                  nodes_limit);
+
+  // 各投票者は、それぞれのタイムマネージャに従って探索を終える
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  // 2. 合議を行う際の「票」を表す構造体
+  struct Vote {
+    int count = 0;
+    Score best_score = -kScoreInfinite;
+    size_t voter = 0;
+    bool operator<(const Vote& rhs) const {
+      if (   count == rhs.count
+          || best_score >= kScoreKnownWin
+          || rhs.best_score >= kScoreKnownWin) {
+        // Rule 1: 投票数が同数の場合、または、必勝手が発見された場合は、評価値が高い指し手が優先する
+        return best_score < rhs.best_score;
+      } else {
+        // Rule 2: そうでない場合は、投票数が多い指し手を優先する（多数決合議）
+        return count < rhs.count;
+      }
+    }
+  };
+
+  // 3. 各投票者が、自分の最善手に１票ずつ投票する
+  std::map<std::string, Vote> votes;
+  for (size_t i = 0; i < results.size(); ++i) {
+    const RootMove& rm = results[i];
+    if (rm.pv.empty() || rm.pv.front() == kMoveNone) {
+      continue;
+    }
+    Vote& vote = votes[rm.pv.front().ToSfen()];
+    vote.count += 1;
+    if (rm.score > vote.best_score) {
+      vote.best_score = rm.score;
+      vote.voter = i;
+    }
+  }
+
+  // 4. 最善手を決定する
+  typedef std::pair<std::string, Vote> Pair;
+  auto best_vote = std::max_element(votes.begin(), votes.end(),
+                                    [](const Pair& lhs, const Pair& rhs) {
+    return lhs.second < rhs.second;
+  });
+  last_winner_ = best_vote != votes.end() ? best_vote->second.voter : 0;
+
+  if (!quiet && !votes.empty()) {
+    std::string text = "info string votes";
+    for (const auto& pair : votes) {
+      text += " " + pair.first + "=" + std::to_string(pair.second.count);
+    }
+    SYNCED_PRINTF("%s\n", text.c_str());
+  }
+
+  return results[last_winner_];
+}
+
+Move LocalConsultation::GetPonderMove(const Node& root_node,
+                                      Move best_move) const {
+  return voters_.at(last_winner_)->GetPonderMove(root_node, best_move);
+}
+
+void LocalConsultation::Stop() {
+  for (std::unique_ptr<ConsultationVoter>& voter : voters_) {
+    voter->Stop();
+  }
+}
+
+void LocalConsultation::Ponderhit() {
+  for (std::unique_ptr<ConsultationVoter>& voter : voters_) {
+    voter->Ponderhit();
+  }
+}
+
+void LocalConsultation::ResetSignals() {
+  for (std::unique_ptr<ConsultationVoter>& voter : voters_) {
+    voter->ResetSignals();
+  }
+}
+
+void LocalConsultation::set_info_callback(
+    const std::function<void(const SearchInfo&)>& callback) {
+  info_callback_ = callback;
+
+  // 最初の投票者以外は、途中経過を出力しない
+  for (size_t i = 0; i < voters_.size(); ++i) {
+    if (i == 0) {
+      voters_[i]->set_info_callback(callback);
+    } else {
+      voters_[i]->set_info_callback([](const SearchInfo&) {});
+    }
+  }
+}
+
+uint64_t LocalConsultation::last_num_nodes_searched() const {
+  uint64_t total = 0;
+  for (const std::unique_ptr<ConsultationVoter>& voter : voters_) {
+    total += voter->last_num_nodes_searched();
+  }
+  return total;
+}
+
+void LocalConsultation::ReportMemoryUsage(MemoryReport* const report) const {
+  for (const std::unique_ptr<ConsultationVoter>& voter : voters_) {
+    voter->ReportMemoryUsage(report);
+  }
+}
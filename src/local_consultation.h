@@ -0,0 +1,179 @@
+/*
+ * 技巧 (Gikou), a USI shogi (Japanese chess) playing engine.
+ * Copyright (C) 2016-2017 Yosuke Demura
+ * except where otherwise indicated.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOCAL_CONSULTATION_H_
+#define LOCAL_CONSULTATION_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "shared_data.h"
+#include "thread.h"
+#include "time_manager.h"
+
+class MemoryReport;
+class Node;
+class UsiGoOptions;
+class UsiOptions;
+struct EvalParameters;
+struct MaterialTables;
+
+/**
+ * プロセス内合議に参加する、１つの探索エンジンです.
+ *
+ * 置換表などの共有データと、評価関数のパラメータ（及びその駒割りに対応する駒の価値のテーブル）を、
+ * 他の投票者とは独立に保持しています。
+ */
+class ConsultationVoter {
+ public:
+  ConsultationVoter(const UsiOptions& usi_options, size_t voter_id);
+  ~ConsultationVoter();
+
+  /**
+   * 置換表の確保と、評価関数のパラメータの読み込みを行います.
+   * @param hash_size   置換表のサイズ（単位はMB）
+   * @param params_file 評価関数のパラメータファイル（空文字列の場合は、g_eval_paramsを使用する）
+   */
+  void Initialize(size_t hash_size, const std::string& params_file);
+
+  /**
+   * ルート局面を探索し、最善手を求めます.
+   */
+  RootMove Search(const Node& root_node, const UsiGoOptions& go_options,
+                  const std::vector<RootMove>& root_moves, Score draw_score,
+                  int multipv, int depth_limit, uint64_t nodes_limit);
+
+  /**
+   * 探索の停止を指示します.
+   */
+  void Stop();
+
+  /**
+   * ponderhitが来たことを通知します.
+   */
+  void Ponderhit();
+
+  /**
+   * シグナルを初期状態にリセットします.
+   */
+  void ResetSignals() {
+    shared_data_.signals.Reset();
+  }
+
+  /**
+   * 探索の途中経過を受け取るコールバック関数を設定します.
+   */
+  void set_info_callback(const std::function<void(const SearchInfo&)>& callback) {
+    shared_data_.info_callback = callback;
+  }
+
+  /**
+   * 最善手の次の手（相手の予想手）を、この投票者の置換表から取得します.
+   */
+  Move GetPonderMove(const Node& root_node, Move best_move) const {
+    return shared_data_.hash_table.GetPonderMove(root_node, best_move);
+  }
+
+  /**
+   * 直前の探索で、この投票者の全スレッドが探索したノード数の合計を返します.
+   */
+  uint64_t last_num_nodes_searched() const {
+    return thread_manager_.last_num_nodes_searched();
+  }
+
+  /**
+   * この投票者が個別に確保しているメモリの使用量を、レポートに追加します.
+   */
+  void ReportMemoryUsage(MemoryReport* report) const;
+
+ private:
+  const UsiOptions& usi_options_;
+  const size_t voter_id_;
+  SharedData shared_data_;
+  std::unique_ptr<EvalParameters> eval_params_;
+  std::unique_ptr<MaterialTables> material_tables_;
+  SimpleTimeManager time_manager_;
+  ThreadManager thread_manager_;
+};
+
+/**
+ * １つのプロセス内で、評価関数のパラメータが異なる複数の探索を並列に走らせ、合議を行うためのクラスです.
+ *
+ * 外部プロセスを起動するConsultationクラスとは異なり、USIの通信を介さずに、各投票者の探索結果を直接集計します。
+ * 採用しているアルゴリズムは、Consultationクラスと同様に、
+ *   1. 原則として、「多数決合議」を用いる
+ *   2. ただし、投票数が同数の場合や、必勝手が発見された場合には「楽観合議」を行う
+ * というものです。
+ */
+class LocalConsultation {
+ public:
+  explicit LocalConsultation(const UsiOptions& usi_options);
+
+  /**
+   * USIオプション（ConsultationVoters, ConsultationParams）に従って、投票者を用意します.
+   * ConsultationParamsには、各投票者が用いるパラメータファイルをセミコロン区切りで指定します。
+   */
+  void Initialize();
+
+  /**
+   * 合議に参加する投票者の数を返します.
+   */
+  size_t num_voters() const {
+    return voters_.size();
+  }
+
+  /**
+   * 全投票者に探索を行わせ、合議により最善手を決定します.
+   * 探索の途中経過は、最初の投票者のものだけを出力します。
+   * @param quiet trueの場合は、投票結果を標準出力に出力しない
+   */
+  RootMove Search(const Node& root_node, const UsiGoOptions& go_options,
+                  const std::vector<RootMove>& root_moves, Score draw_score,
+                  int multipv, int depth_limit, uint64_t nodes_limit,
+                  bool quiet);
+
+  /**
+   * 直前のSearch()で選ばれた指し手に対する、相手の予想手を返します.
+   */
+  Move GetPonderMove(const Node& root_node, Move best_move) const;
+
+  void Stop();
+  void Ponderhit();
+  void ResetSignals();
+
+  /**
+   * 最初の投票者の探索の途中経過を受け取るコールバック関数を設定します.
+   */
+  void set_info_callback(const std::function<void(const SearchInfo&)>& callback);
+
+  /**
+   * 直前のSearch()で、全投票者が探索したノード数の合計を返します.
+   */
+  uint64_t last_num_nodes_searched() const;
+
+  void ReportMemoryUsage(MemoryReport* report) const;
+
+ private:
+  const UsiOptions& usi_options_;
+  std::function<void(const SearchInfo&)> info_callback_;
+  std::vector<std::unique_ptr<ConsultationVoter>> voters_;
+  size_t last_winner_ = 0;
+};
+
+#endif /* LOCAL_CONSULTATION_H_ */
@@ -17,22 +17,11 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include "bitboard.h"
 #include "cli.h"
 #include "cluster.h"
 #include "consultation.h"
-#include "evaluation.h"
-#include "extended_board.h"
-#include "huffman_code.h"
-#include "mate1ply.h"
-#include "material.h"
-#include "move_probability.h"
-#include "progress.h"
-#include "psq.h"
-#include "search.h"
-#include "square.h"
+#include "engine.h"
 #include "usi.h"
-#include "zobrist.h"
 
 #ifdef UNIT_TEST
 # include "gtest/gtest.h"
@@ -40,18 +29,7 @@
 
 int main(int argc, char **argv) {
   // テーブル等の初期化を行う
-  Square::Init();
-  Bitboard::Init();
-  ExtendedBoard::Init();
-  Zobrist::Init();
-  HuffmanCode::Init();
-  InitMateInOnePly();
-  Search::Init();
-  PsqPair::Init();
-  Progress::ReadWeightsFromFile();
-  Evaluation::Init();
-  Material::Init();
-  MoveProbability::Init();
+  Engine::Init();
 
 #ifdef UNIT_TEST
   // Google Test によるユニットテストを行う
@@ -80,7 +58,7 @@ int main(int argc, char **argv) {
   } else {
 #ifndef MINIMUM
     // オプションを解析して、コマンドを実行
-    Cli::ExecuteCommand(argc, argv);
+    return Cli::ExecuteCommand(argc, argv);
 #endif
   }
 
@@ -0,0 +1,675 @@
+/*
+ * 技巧 (Gikou), a USI shogi (Japanese chess) playing engine.
+ * Copyright (C) 2016-2017 Yosuke Demura
+ * except where otherwise indicated.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if !defined(MINIMUM)
+
+#include "match.h"
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+#include <cinttypes>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include "common/simple_timer.h"
+#include "book.h"
+#include "movegen.h"
+#include "position.h"
+#include "synced_printf.h"
+#include "usi.h"
+#include "usi_protocol.h"
+
+namespace {
+
+const char* const kStartPositionSfen =
+    "lnsgkgsnl/1r5b1/ppppppppp/9/9/9/PPPPPPPPP/1B5R1/LNSGKGSNL b - 1";
+
+/**
+ * SFEN形式の指し手を、その局面における合法手に変換します.
+ * @return 合法手でない場合は、kMoveNone
+ */
+Move ParseMove(const std::string& str, const Position& pos) {
+  SimpleMoveList<kAllMoves, true> legal_moves(pos);
+  for (const ExtMove& ext_move : legal_moves) {
+    if (ext_move.move.ToSfen() == str) {
+      return ext_move.move;
+    }
+  }
+
+  // 指し手生成では省略されている不成の手（例：飛・角・歩の不成）
+  for (const ExtMove& ext_move : legal_moves) {
+    Move move = ext_move.move;
+    if (move.is_promotion() && move.ToSfen() == str + "+") {
+      Move unpromotion(move.piece(), move.from(), move.to(), false,
+                       move.captured_piece());
+      if (pos.MoveIsLegal(unpromotion)) {
+        return unpromotion;
+      }
+    }
+  }
+
+  return kMoveNone;
+}
+
+/**
+ * 千日手の判定に用いるため、手数を除いたSFENを返します.
+ */
+std::string PositionKey(const Position& pos) {
+  std::string sfen = pos.ToSfen();
+  return sfen.substr(0, sfen.find_last_of(' '));
+}
+
+/**
+ * 勝率から、レーティング差を求めます.
+ */
+double ScoreToElo(double score) {
+  score = std::min(std::max(score, 1e-6), 1.0 - 1e-6);
+  return -400.0 * std::log10(1.0 / score - 1.0);
+}
+
+/**
+ * 引数を数値として読み込みます.
+ */
+template<typename T>
+bool ParseNumber(int* i, int argc, char* argv[], T* value) {
+  if (*i + 1 >= argc) {
+    std::printf("Match: %s requires a value.\n", argv[*i]);
+    return false;
+  }
+  *value = static_cast<T>(std::atof(argv[++*i]));
+  return true;
+}
+
+} // namespace
+
+bool MatchOptions::Parse(int argc, char* argv[], MatchOptions* const options) {
+  assert(options != nullptr);
+
+  int num_engines = 0;
+  for (int i = 0; i < argc; ++i) {
+    const std::string arg(argv[i]);
+    bool ok = true;
+    if      (arg == "--games"        ) ok = ParseNumber(&i, argc, argv, &options->num_games);
+    else if (arg == "--concurrency"  ) ok = ParseNumber(&i, argc, argv, &options->concurrency);
+    else if (arg == "--time"         ) ok = ParseNumber(&i, argc, argv, &options->time);
+    else if (arg == "--byoyomi"      ) ok = ParseNumber(&i, argc, argv, &options->byoyomi);
+    else if (arg == "--inc"          ) ok = ParseNumber(&i, argc, argv, &options->inc);
+    else if (arg == "--margin"       ) ok = ParseNumber(&i, argc, argv, &options->time_margin);
+    else if (arg == "--opening-plies") ok = ParseNumber(&i, argc, argv, &options->opening_plies);
+    else if (arg == "--max-plies"    ) ok = ParseNumber(&i, argc, argv, &options->max_plies);
+    else if (arg == "--resign"       ) ok = ParseNumber(&i, argc, argv, &options->resign_score);
+    else if (arg == "--resign-moves" ) ok = ParseNumber(&i, argc, argv, &options->resign_moves);
+    else if (arg == "--elo0"         ) ok = ParseNumber(&i, argc, argv, &options->elo0);
+    else if (arg == "--elo1"         ) ok = ParseNumber(&i, argc, argv, &options->elo1);
+    else if (arg == "--alpha"        ) ok = ParseNumber(&i, argc, argv, &options->alpha);
+    else if (arg == "--beta"         ) ok = ParseNumber(&i, argc, argv, &options->beta);
+    else if (arg == "--openings" && i + 1 < argc) options->openings_file = argv[++i];
+    else if (arg == "--book"     && i + 1 < argc) options->book_file = argv[++i];
+    else if (arg == "--record"   && i + 1 < argc) options->record_file = argv[++i];
+    else if (arg == "--option1"  && i + 1 < argc) options->engine_options[0].push_back(argv[++i]);
+    else if (arg == "--option2"  && i + 1 < argc) options->engine_options[1].push_back(argv[++i]);
+    else if (arg.compare(0, 2, "--") != 0 && num_engines < 2) options->engines[num_engines++] = arg;
+    else {
+      std::printf("Match: Unknown argument. %s\n", arg.c_str());
+      ok = false;
+    }
+    if (!ok) {
+      return false;
+    }
+  }
+
+  if (num_engines < 2) {
+    std::printf("Usage: --match <engine1> <engine2> [--games N] [--concurrency N]\n"
+                "         [--time ms] [--byoyomi ms] [--inc ms] [--margin ms]\n"
+                "         [--openings file | --book file] [--opening-plies N]\n"
+                "         [--max-plies N] [--resign cp] [--resign-moves N]\n"
+                "         [--elo0 x] [--elo1 x] [--alpha x] [--beta x]\n"
+                "         [--option1 name=value]... [--option2 name=value]...\n"
+                "         [--record file]\n");
+    return false;
+  }
+
+  options->num_games = std::max(options->num_games, 2);
+  options->concurrency = std::max(options->concurrency, 1);
+  return true;
+}
+
+MatchEngine::~MatchEngine() {
+  if (started_) {
+    process_.PrintLine("quit");
+    process_.WaitFor();
+  }
+}
+
+bool MatchEngine::Start(const std::string& file,
+                        const std::vector<std::string>& options,
+                        const int first_cpu, const int num_cpus) {
+  // 1. 外部プロセスを起動する
+  char* const args[] = {
+      const_cast<char*>(file.c_str()),
+      NULL
+  };
+  if (process_.StartProcess(args[0], args) < 0) {
+    return false;
+  }
+  started_ = true;
+
+  // 2. 外部プロセスを、指定されたCPUに固定する
+#if defined(__linux__)
+  if (num_cpus > 0) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int cpu = first_cpu; cpu < first_cpu + num_cpus; ++cpu) {
+      CPU_SET(cpu, &cpu_set);
+    }
+    sched_setaffinity(process_.process_id(), sizeof(cpu_set), &cpu_set);
+  }
+#else
+  (void)first_cpu;
+  (void)num_cpus;
+#endif
+
+  // 3. USIコマンドを送信して、対局の準備を行う
+  process_.PrintLine("usi");
+  for (std::string line; process_.GetLine(&line); ) {
+    if (line.compare(0, 8, "id name ") == 0) {
+      name_ = line.substr(8);
+    } else if (line == "usiok") {
+      break;
+    }
+  }
+  for (const std::string& option : options) {
+    size_t pos = option.find('=');
+    if (pos == std::string::npos) {
+      SYNCED_PRINTF("Match: Invalid option. %s\n", option.c_str());
+      continue;
+    }
+    process_.Printf("setoption name %s value %s\n",
+                    option.substr(0, pos).c_str(), option.substr(pos + 1).c_str());
+  }
+  if (name_.empty()) {
+    name_ = file;
+  }
+  return true;
+}
+
+bool MatchEngine::WaitFor(const std::string& command) {
+  for (std::string line; process_.GetLine(&line); ) {
+    if (line == command) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void MatchEngine::NewGame() {
+  process_.PrintLine("isready");
+  WaitFor("readyok");
+  process_.PrintLine("usinewgame");
+}
+
+std::string MatchEngine::Think(const std::string& position_command,
+                               const std::string& go_command,
+                               Score* const score, int64_t* const nps) {
+  process_.PrintLine(position_command.c_str());
+  process_.PrintLine(go_command.c_str());
+
+  // bestmoveコマンドが返ってくるまで、infoコマンドを読み込む
+  for (std::string line; process_.GetLine(&line); ) {
+    std::istringstream is(line);
+    std::string token;
+    is >> token;
+    if (token == "info") {
+      if (line.find(" string ") != std::string::npos) {
+        continue;
+      }
+      UsiInfo info = UsiProtocol::ParseInfoCommand(is);
+      if (info.score != -kScoreInfinite) {
+        *score = info.score;
+      }
+      if (info.nps > 0) {
+        *nps = info.nps;
+      }
+    } else if (token == "bestmove") {
+      std::string move;
+      is >> move;
+      return move;
+    }
+  }
+
+  return "";
+}
+
+void MatchEngine::GameOver(const char* const result) {
+  process_.Printf("gameover %s\n", result);
+}
+
+Match::Match(const MatchOptions& options)
+    : options_(options) {
+}
+
+int Match::Run() {
+  // 1. 開始局面を準備する
+  if (!PrepareOpenings()) {
+    return 2;
+  }
+  if (!options_.record_file.empty()) {
+    record_file_ = std::fopen(options_.record_file.c_str(), "w");
+    if (record_file_ == nullptr) {
+      std::printf("Match: Failed to open %s.\n", options_.record_file.c_str());
+      return 2;
+    }
+  }
+
+  // 2. 並列に対局を行う
+  std::printf("Match: %d games, concurrency %d, %d openings.\n",
+              options_.num_games, options_.concurrency, int(openings_.size()));
+  std::vector<std::thread> workers;
+  for (int worker_id = 0; worker_id < options_.concurrency; ++worker_id) {
+    workers.emplace_back([this, worker_id]() { PlayGames(worker_id); });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+
+  // 3. 最終結果を表示する
+  std::printf("\nFinal result:\n");
+  PrintStatus();
+  if (record_file_ != nullptr) {
+    std::fclose(record_file_);
+  }
+
+  return sprt_decision_ < 0 ? 1 : 0;
+}
+
+double Match::ComputeLlr(int wins, int draws, int losses, double elo0,
+                         double elo1) {
+  // 勝ち・引き分け・負けの三項分布を、正規分布で近似してLLRを求める
+  const double n = wins + draws + losses;
+  if (n == 0 || (wins == 0 && losses == 0)) {
+    return 0.0;
+  }
+  const double score = (wins + 0.5 * draws) / n;
+  const double variance = (wins * std::pow(1.0 - score, 2)
+                         + draws * std::pow(0.5 - score, 2)
+                         + losses * std::pow(0.0 - score, 2)) / n;
+  if (variance <= 0.0) {
+    return 0.0;
+  }
+  const double score0 = 1.0 / (1.0 + std::pow(10.0, -elo0 / 400.0));
+  const double score1 = 1.0 / (1.0 + std::pow(10.0, -elo1 / 400.0));
+  return (score1 - score0) * (2.0 * score - score0 - score1) / (2.0 * variance / n);
+}
+
+bool Match::PrepareOpenings() {
+  const int num_pairs = (options_.num_games + 1) / 2;
+
+  if (!options_.openings_file.empty()) {
+    // a. ファイルから開始局面を読み込む
+    std::ifstream ifs(options_.openings_file);
+    if (!ifs) {
+      std::printf("Match: Failed to open %s.\n", options_.openings_file.c_str());
+      return false;
+    }
+    for (std::string line; std::getline(ifs, line); ) {
+      std::istringstream is(line);
+      std::string token;
+      if (!(is >> token) || token[0] == '#') {
+        continue;
+      }
+      if (token == "position") {
+        is >> token;
+      }
+      Opening opening;
+      if (token == "startpos") {
+        opening.sfen = kStartPositionSfen;
+      } else {
+        // "sfen"が省略されている場合は、行全体をSFENとみなす
+        std::string board = token == "sfen" ? "" : token;
+        std::string stm, hands, move_count;
+        if (board.empty()) {
+          is >> board;
+        }
+        if (!(is >> stm >> hands >> move_count)) {
+          std::printf("Match: Unsupported opening. %s\n", line.c_str());
+          continue;
+        }
+        opening.sfen = board + " " + stm + " " + hands + " " + move_count;
+      }
+      if (is >> token && token == "moves") {
+        for (std::string move; is >> move; ) {
+          opening.moves.push_back(move);
+        }
+      }
+
+      // 開始局面の指し手が合法手であることを確認しておく
+      Position pos = Position::FromSfen(opening.sfen);
+      bool legal = true;
+      for (const std::string& move_str : opening.moves) {
+        Move move = ParseMove(move_str, pos);
+        if (move == kMoveNone) {
+          legal = false;
+          break;
+        }
+        pos.MakeMove(move);
+      }
+      if (legal) {
+        openings_.push_back(opening);
+      } else {
+        std::printf("Match: Illegal opening. %s\n", line.c_str());
+      }
+    }
+  } else if (!options_.book_file.empty()) {
+    // b. 定跡ファイルから、ランダムに開始局面を作成する
+    Book book(options_.book_file.c_str());
+    UsiOptions usi_options;
+    for (int i = 0; i < num_pairs; ++i) {
+      Opening opening;
+      opening.sfen = kStartPositionSfen;
+      Position pos = Position::CreateStartPosition();
+      for (int ply = 0; ply < options_.opening_plies; ++ply) {
+        Move move = book.GetBookMoves(pos, usi_options).PickRandom();
+        if (move == kMoveNone) {
+          break;
+        }
+        opening.moves.push_back(move.ToSfen());
+        pos.MakeMove(move);
+      }
+      openings_.push_back(opening);
+    }
+  } else {
+    // c. 平手の初期局面から対局する
+    openings_.push_back(Opening{kStartPositionSfen, {}});
+  }
+
+  if (openings_.empty()) {
+    std::printf("Match: No openings.\n");
+    return false;
+  }
+  return true;
+}
+
+void Match::PlayGames(const int worker_id) {
+  // 1. 対局ごとに使用するCPUを決める
+  const int num_cpus = std::thread::hardware_concurrency();
+  const int cpus_per_game = std::max(num_cpus / options_.concurrency, 1);
+  const int first_cpu = num_cpus > 0
+                      ? (worker_id * cpus_per_game) % num_cpus
+                      : 0;
+
+  // 2. エンジンを起動する（エンジンは、対局ごとに起動し直さず、使い回す）
+  MatchEngine engines[2];
+  for (int i = 0; i < 2; ++i) {
+    if (!engines[i].Start(options_.engines[i], options_.engine_options[i],
+                          first_cpu, num_cpus > 0 ? cpus_per_game : 0)) {
+      SYNCED_PRINTF("Match: Failed to start %s.\n", options_.engines[i].c_str());
+      stop_ = true;
+      return;
+    }
+  }
+
+  // 3. 対局を行う
+  const int num_games = (options_.num_games + 1) / 2 * 2;
+  while (!stop_) {
+    int game_id = next_game_id_++;
+    if (game_id >= num_games) {
+      break;
+    }
+    GameRecord game;
+    PlayGame(game_id, engines, &game);
+    RecordResult(game_id, game);
+  }
+}
+
+void Match::PlayGame(const int game_id, MatchEngine engines[2],
+                     GameRecord* const game) const {
+  // 1. 対局者を決める（偶数番目の対局では、engines[0]が先手）
+  const int black_id = game_id % 2;
+  const ArrayMap<int, Color> engine_id{black_id, 1 - black_id};
+
+  // 2. 開始局面を準備する
+  const Opening& opening = openings_[(game_id / 2) % openings_.size()];
+  Position pos = Position::FromSfen(opening.sfen);
+  std::string moves_str;
+  for (const std::string& move_str : opening.moves) {
+    pos.MakeMove(ParseMove(move_str, pos));
+    moves_str += " " + move_str;
+  }
+  for (int i = 0; i < 2; ++i) {
+    engines[i].NewGame();
+  }
+
+  // 3. 千日手判定のため、局面の履歴を記録しておく
+  std::vector<std::string> history{PositionKey(pos)};
+  std::vector<bool> checks{pos.in_check()};
+  std::unordered_map<std::string, int> first_occurrence{{history.back(), 0}};
+  std::unordered_map<std::string, int> num_occurrences{{history.back(), 1}};
+
+  // 4. 対局を行う
+  ArrayMap<int64_t, Color> remaining{options_.time, options_.time};
+  Color loser_candidate = kBlack;
+  int num_consecutive_resign_scores = 0;
+  Color winner = kBlack;
+  bool decisive = false;
+  const char* reason = nullptr;
+  auto set_winner = [&](Color color, const char* why) {
+    winner = color;
+    decisive = true;
+    reason = why;
+  };
+  for (int ply = opening.moves.size(); reason == nullptr; ++ply) {
+    const Color side = pos.side_to_move();
+
+    // a. 最大手数に達したら、引き分けとする
+    if (ply >= options_.max_plies) {
+      reason = "max plies";
+      break;
+    }
+
+    // b. エンジンに指し手を考えさせる
+    char go_command[256];
+    if (options_.inc > 0) {
+      std::snprintf(go_command, sizeof(go_command),
+                    "go btime %" PRId64 " wtime %" PRId64 " binc %" PRId64 " winc %" PRId64,
+                    remaining[kBlack], remaining[kWhite], options_.inc, options_.inc);
+    } else {
+      std::snprintf(go_command, sizeof(go_command),
+                    "go btime %" PRId64 " wtime %" PRId64 " byoyomi %" PRId64,
+                    remaining[kBlack], remaining[kWhite], options_.byoyomi);
+    }
+    std::string position_command = "position sfen " + opening.sfen;
+    if (!moves_str.empty()) {
+      position_command += " moves" + moves_str;
+    }
+    Score score = -kScoreInfinite;
+    int64_t nps = 0;
+    SimpleTimer timer;
+    const std::string bestmove = engines[engine_id[side]].Think(
+        position_command, go_command, &score, &nps);
+    const int64_t elapsed = timer.GetElapsedMilliseconds();
+    if (nps > 0) {
+      game->sum_nps[engine_id[side]] += nps;
+      game->num_nps_samples[engine_id[side]] += 1;
+    }
+
+    // c. 消費時間を計算する
+    remaining[side] -= elapsed;
+    if (remaining[side] < 0) {
+      int64_t allowance = options_.inc > 0 ? 0 : options_.byoyomi;
+      if (-remaining[side] > allowance + options_.time_margin) {
+        set_winner(~side, "time forfeit");
+        break;
+      }
+      remaining[side] = 0;
+    }
+    remaining[side] += options_.inc;
+
+    // d. 投了・入玉宣言・反則手を処理する
+    if (bestmove == "resign" || bestmove.empty()) {
+      set_winner(~side, bestmove.empty() ? "engine terminated" : "resign");
+      break;
+    } else if (bestmove == "win") {
+      // 入玉宣言の条件は確認せず、エンジンの申告をそのまま受け入れる
+      set_winner(side, "declaration");
+      break;
+    }
+    Move move = ParseMove(bestmove, pos);
+    if (move == kMoveNone) {
+      set_winner(~side, "illegal move");
+      break;
+    }
+    pos.MakeMove(move);
+    moves_str += " " + bestmove;
+
+    // e. 詰み・打ち歩詰めを判定する
+    if (SimpleMoveList<kAllMoves, true>(pos).empty()) {
+      bool pawn_drop_mate = move.is_drop() && move.piece_type() == kPawn;
+      set_winner(pawn_drop_mate ? ~side : side,
+                 pawn_drop_mate ? "pawn drop mate" : "checkmate");
+      break;
+    }
+
+    // f. 千日手を判定する
+    history.push_back(PositionKey(pos));
+    checks.push_back(pos.in_check());
+    const int current = history.size() - 1;
+    first_occurrence.emplace(history.back(), current);
+    if (++num_occurrences[history.back()] >= 4) {
+      // 同一局面が４回現れた場合、一方が王手をかけ続けていれば、王手をかけていた側の負け
+      const int first = first_occurrence[history.back()];
+      ArrayMap<bool, Color> continuous_checks{true, true};
+      for (int i = current; i > first; --i) {
+        Color mover = (current - i) % 2 == 0 ? side : ~side;
+        continuous_checks[mover] = continuous_checks[mover] && checks[i];
+      }
+      if (continuous_checks[side]) {
+        set_winner(~side, "perpetual check");
+      } else if (continuous_checks[~side]) {
+        set_winner(side, "perpetual check");
+      } else {
+        reason = "repetition";
+      }
+      break;
+    }
+
+    // g. 両者の評価値が一方に大きく傾いた状態が続いたら、投了とみなす
+    Color candidate = score <= -options_.resign_score ? side : ~side;
+    if (score != -kScoreInfinite && std::abs(score) >= options_.resign_score) {
+      num_consecutive_resign_scores = candidate == loser_candidate
+                                    ? num_consecutive_resign_scores + 1 : 1;
+      loser_candidate = candidate;
+    } else {
+      num_consecutive_resign_scores = 0;
+    }
+    if (num_consecutive_resign_scores >= 2 * options_.resign_moves) {
+      set_winner(~loser_candidate, "adjudication");
+    }
+  }
+
+  // 5. 対局結果をエンジンに伝える
+  if (!decisive) {
+    game->result = kDraw;
+    engines[0].GameOver("draw");
+    engines[1].GameOver("draw");
+  } else {
+    game->result = engine_id[winner] == 0 ? kWin : kLoss;
+    engines[engine_id[winner]].GameOver("win");
+    engines[engine_id[~winner]].GameOver("lose");
+  }
+  game->reason = reason;
+  game->moves = "position sfen " + opening.sfen
+              + (moves_str.empty() ? "" : " moves" + moves_str);
+}
+
+void Match::RecordResult(const int game_id, const GameRecord& game) {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  // 1. 対局結果を集計する
+  num_results_[game.result] += 1;
+  for (int i = 0; i < 2; ++i) {
+    sum_nps_[i] += game.sum_nps[i];
+    num_nps_samples_[i] += game.num_nps_samples[i];
+  }
+  const char* const kResultNames[] = {"0-1", "1/2-1/2", "1-0"};
+  SYNCED_PRINTF("Game %d (%s): %s by %s\n", game_id + 1,
+                game_id % 2 == 0 ? "engine1 black" : "engine1 white",
+                kResultNames[game.result], game.reason.c_str());
+  if (record_file_ != nullptr) {
+    std::fprintf(record_file_, "%d %s %s %s\n", game_id + 1,
+                 kResultNames[game.result], game.reason.c_str(), game.moves.c_str());
+    std::fflush(record_file_);
+  }
+
+  // 2. SPRTを行い、結論が出ていれば対局を打ち切る
+  if (options_.elo0 != options_.elo1 && sprt_decision_ == 0) {
+    double llr = ComputeLlr(num_results_[kWin], num_results_[kDraw],
+                            num_results_[kLoss], options_.elo0, options_.elo1);
+    if (llr >= std::log((1.0 - options_.beta) / options_.alpha)) {
+      sprt_decision_ = 1;
+      stop_ = true;
+    } else if (llr <= std::log(options_.beta / (1.0 - options_.alpha))) {
+      sprt_decision_ = -1;
+      stop_ = true;
+    }
+  }
+
+  PrintStatus();
+}
+
+void Match::PrintStatus() const {
+  const int wins = num_results_[kWin], draws = num_results_[kDraw];
+  const int losses = num_results_[kLoss];
+  const int n = wins + draws + losses;
+  if (n == 0) {
+    return;
+  }
+
+  // 勝率とレーティング差（95%信頼区間）
+  const double score = (wins + 0.5 * draws) / n;
+  const double variance = (wins * std::pow(1.0 - score, 2)
+                         + draws * std::pow(0.5 - score, 2)
+                         + losses * std::pow(score, 2)) / n;
+  const double margin = 1.96 * std::sqrt(variance / n);
+  const double elo = ScoreToElo(score);
+  const double elo_margin = (ScoreToElo(score + margin) - ScoreToElo(score - margin)) / 2;
+  SYNCED_PRINTF("  W-D-L %d-%d-%d (%d games), score %.1f%%, Elo %+.1f +- %.1f\n",
+                wins, draws, losses, n, 100.0 * score, elo, elo_margin);
+
+  // 平均NPS（速度差が強さに結びついているかを確認するため）
+  SYNCED_PRINTF("  NPS engine1 %.0f, engine2 %.0f\n",
+                sum_nps_[0] / std::max<int64_t>(num_nps_samples_[0], 1),
+                sum_nps_[1] / std::max<int64_t>(num_nps_samples_[1], 1));
+
+  // SPRT
+  if (options_.elo0 != options_.elo1) {
+    const double llr = ComputeLlr(wins, draws, losses, options_.elo0, options_.elo1);
+    const double lower = std::log(options_.beta / (1.0 - options_.alpha));
+    const double upper = std::log((1.0 - options_.beta) / options_.alpha);
+    const char* const kDecisions[] = {"H0 accepted", "running", "H1 accepted"};
+    SYNCED_PRINTF("  SPRT elo0=%.1f elo1=%.1f: LLR %.2f [%.2f, %.2f] %s\n",
+                  options_.elo0, options_.elo1, llr, lower, upper,
+                  kDecisions[sprt_decision_ + 1]);
+  }
+}
+
+#endif /* !defined(MINIMUM) */
@@ -0,0 +1,200 @@
+/*
+ * 技巧 (Gikou), a USI shogi (Japanese chess) playing engine.
+ * Copyright (C) 2016-2017 Yosuke Demura
+ * except where otherwise indicated.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MATCH_H_
+#define MATCH_H_
+
+#if !defined(MINIMUM)
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "process.h"
+#include "types.h"
+
+/**
+ * 連続対局の設定です.
+ */
+struct MatchOptions {
+  /**
+   * コマンドライン引数から、連続対局の設定を読み込みます.
+   * @param argc 引数の数（"--match"の次の引数から数える）
+   * @param argv 引数の配列
+   * @param options 読み込んだ設定を保存するためのポインタ
+   * @return 引数の解析に成功した場合は、true
+   */
+  static bool Parse(int argc, char* argv[], MatchOptions* options);
+
+  /** 対局させるエンジンの実行ファイル（[0]が比較対象、[1]が基準） */
+  std::string engines[2];
+  /** エンジンごとのUSIオプション（"名前=値"の形式） */
+  std::vector<std::string> engine_options[2];
+  /** 対局数（先後入れ替えのため、偶数に切り上げられる） */
+  int num_games = 100;
+  /** 同時に対局させる数 */
+  int concurrency = 1;
+  /** 持ち時間・秒読み・フィッシャールールの加算時間（ミリ秒） */
+  int64_t time = 0, byoyomi = 1000, inc = 0;
+  /** 時間切れと判定するまでの猶予時間（ミリ秒） */
+  int64_t time_margin = 1000;
+  /** 開始局面を読み込むファイル（１行に１局面。USIのpositionコマンドと同じ形式） */
+  std::string openings_file;
+  /** 開始局面を作成するための定跡ファイル */
+  std::string book_file;
+  /** 定跡から開始局面を作成する際の手数 */
+  int opening_plies = 16;
+  /** この手数に達したら、引き分けとする */
+  int max_plies = 256;
+  /** 投了判定：両者の評価値が、resign_moves手連続でこの値を超えたら、投了とみなす */
+  int resign_score = 3000, resign_moves = 4;
+  /** SPRTのパラメータ（elo0 == elo1 の場合は、SPRTを行わない） */
+  double elo0 = 0.0, elo1 = 5.0, alpha = 0.05, beta = 0.05;
+  /** 棋譜の出力先（空の場合は、出力しない） */
+  std::string record_file;
+};
+
+/**
+ * 連続対局で用いる、外部プロセスのUSIエンジンです.
+ */
+class MatchEngine {
+ public:
+  ~MatchEngine();
+
+  /**
+   * エンジンを起動し、usiokが返ってくるまで待機したうえで、USIオプションを設定します.
+   * isready/readyokのやり取りは、NewGame()で行います。
+   * @param file      エンジンの実行ファイル
+   * @param options   エンジンに設定するUSIオプション（"名前=値"の形式）
+   * @param first_cpu エンジンを固定するCPUの先頭の番号
+   * @param num_cpus  エンジンを固定するCPUの数（0の場合は、固定しない）
+   * @return 起動に成功した場合は、true
+   */
+  bool Start(const std::string& file, const std::vector<std::string>& options,
+             int first_cpu, int num_cpus);
+
+  /**
+   * 新規対局の準備を行います.
+   */
+  void NewGame();
+
+  /**
+   * 指し手を考えさせます.
+   * @param position_command USIのpositionコマンド
+   * @param go_command       USIのgoコマンド
+   * @param score            エンジンが最後に出力した評価値を保存するポインタ
+   * @param nps              エンジンが最後に出力したNPSを保存するポインタ
+   * @return bestmoveコマンドで返された指し手（エンジンが終了した場合は、空文字列）
+   */
+  std::string Think(const std::string& position_command,
+                    const std::string& go_command, Score* score, int64_t* nps);
+
+  /**
+   * 対局結果をエンジンに伝えます.
+   * @param result "win"、"lose"、"draw"のいずれか
+   */
+  void GameOver(const char* result);
+
+  /**
+   * エンジンが通知してきた名前を返します.
+   */
+  const std::string& name() const {
+    return name_;
+  }
+
+ private:
+  bool WaitFor(const std::string& command);
+  Process process_;
+  std::string name_;
+  bool started_ = false;
+};
+
+/**
+ * ２つのUSIエンジンを連続対局させ、強さの差（レーティング差）を測定するためのクラスです.
+ *
+ * 複数の対局を並列に行い、各対局のエンジンは、それぞれ別のCPUに固定されます（Linuxのみ）。
+ * 同じ開始局面について先後を入れ替えた２局を指させることで、開始局面による偏りを抑えています。
+ * また、SPRT（逐次確率比検定）により、結論が出た時点で対局を打ち切ります。
+ *
+ * 使用例（探索速度の改善が、実際に強さに結びついたかを確かめる場合）：
+ * <pre>
+ * ./release --match ./new ./old --games 1000 --concurrency 4 --byoyomi 1000 --book book.bin
+ * </pre>
+ *
+ * （SPRTについての参考文献）
+ *   - A. Wald: Sequential Tests of Statistical Hypotheses, The Annals of Mathematical
+ *     Statistics, 16(2), pp.117-186, 1945.
+ */
+class Match {
+ public:
+  /**
+   * 対局結果です（engines[0]、すなわち比較対象のエンジンから見た結果）.
+   */
+  enum Result {
+    kLoss, kDraw, kWin,
+  };
+
+  explicit Match(const MatchOptions& options);
+
+  /**
+   * 連続対局を行います.
+   * @return 終了コード（SPRTにより、比較対象の方が弱いと判定された場合は、1）
+   */
+  int Run();
+
+  /**
+   * 勝ち・引き分け・負けの数から、SPRTの対数尤度比を計算します.
+   */
+  static double ComputeLlr(int wins, int draws, int losses, double elo0,
+                           double elo1);
+
+ private:
+  struct Opening {
+    std::string sfen;
+    std::vector<std::string> moves;
+  };
+
+  struct GameRecord {
+    Result result = kDraw;
+    std::string reason;
+    std::string moves;
+    double sum_nps[2] = {0.0, 0.0};
+    int64_t num_nps_samples[2] = {0, 0};
+  };
+
+  bool PrepareOpenings();
+  void PlayGames(int worker_id);
+  void PlayGame(int game_id, MatchEngine engines[2], GameRecord* game) const;
+  void RecordResult(int game_id, const GameRecord& game);
+  void PrintStatus() const;
+
+  const MatchOptions options_;
+  std::vector<Opening> openings_;
+  std::atomic<int> next_game_id_{0};
+  std::atomic_bool stop_{false};
+  std::mutex mutex_;
+  int num_results_[3] = {0, 0, 0};
+  double sum_nps_[2] = {0.0, 0.0};
+  int64_t num_nps_samples_[2] = {0, 0};
+  int sprt_decision_ = 0;
+  std::FILE* record_file_ = nullptr;
+};
+
+#endif /* !defined(MINIMUM) */
+#endif /* MATCH_H_ */
@@ -20,6 +20,7 @@
 #include "mate3.h"
 
 #include "mate1ply.h"
+#include "mate_pattern.h"
 #include "movegen.h"
 #include "position.h"
 #include "proofpiece.h"
@@ -52,6 +53,18 @@ bool IsMateInThreePlies(Position& pos, Mate3Result* const result) {
   };
 #endif
 
+  // 詰み筋の表に該当する駒打があれば、近接王手を生成する前に、その手を最初に調べる
+  if (MatePatternTable::enabled()) {
+    const Move move = MatePatternTable::Probe(pos);
+    if (move != kMoveNone) {
+      if (MoveLeadsToMateInThreePlies(pos, move, result)) {
+        MatePatternTable::stats().hits += 1;
+        return true;
+      }
+      MatePatternTable::stats().false_hits += 1;
+    }
+  }
+
   // 近接王手を生成する
   SimpleMoveList<kAdjacentChecks> adjacent_checks(pos);
 
@@ -67,6 +80,7 @@ bool IsMateInThreePlies(Position& pos, Mate3Result* const result) {
     const Move move = ext_move.move;
     assert(pos.MoveGivesCheck(move));
 
+    // 打ち歩詰めの手も、ここで除外される
     if (!pos.PseudoLegalMoveIsLegal(move)) {
       continue;
     }
@@ -97,10 +111,7 @@ bool IsMateInThreePlies(Position& pos, Mate3Result* const result) {
     Mate3Result r;
     if (IsMatedInTwoPlies(pos, &r)) {
       pos.UnmakeMove(move);
-      // 打ち歩詰め
-      if (move.is_pawn_drop() && r.mate_distance == 0) {
-        continue;
-      }
+      assert(!move.is_pawn_drop() || r.mate_distance != 0);
       // 結果を保存する
       result->mate_move = move;
       result->mate_distance = r.mate_distance + 1;
@@ -114,6 +125,24 @@ bool IsMateInThreePlies(Position& pos, Mate3Result* const result) {
   return false;
 }
 
+bool MoveLeadsToMateInThreePlies(Position& pos, const Move move,
+                                 Mate3Result* const result) {
+  assert(!pos.in_check());
+  assert(result != nullptr);
+  assert(pos.MoveGivesCheck(move));
+
+  pos.MakeMove(move, true);
+  Mate3Result r;
+  const bool mated = IsMatedInTwoPlies(pos, &r);
+  pos.UnmakeMove(move);
+  if (mated) {
+    result->mate_move = move;
+    result->mate_distance = r.mate_distance + 1;
+    result->proof_pieces = ProofPieces::AtAttackSide(r.proof_pieces, move);
+  }
+  return mated;
+}
+
 namespace {
 
 bool IsMatedInTwoPlies(Position& pos, Mate3Result* const result) {
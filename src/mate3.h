@@ -55,6 +55,17 @@ struct Mate3Result {
  */
 bool IsMateInThreePlies(Position& pos, Mate3Result* result);
 
+/**
+ * 与えられた王手を指すと、３手以内に詰む場合は、trueを返します.
+ * 詰み筋の表（MatePatternTable）から引いた駒打を、実際の局面で確かめるのに用います。
+ *
+ * @param pos    攻め方の手番の局面
+ * @param move   調べたい王手（合法手であることを前提とします）
+ * @param result 詰みが見つかった場合に、その結果を保存する場所です
+ * @return ３手以内の詰みが存在する場合は、true
+ */
+bool MoveLeadsToMateInThreePlies(Position& pos, Move move, Mate3Result* result);
+
 /**
  * 王手回避手を逐次生成するためのクラスです.
  *
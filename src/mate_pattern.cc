@@ -0,0 +1,322 @@
+/*
+ * 技巧 (Gikou), a USI shogi (Japanese chess) playing engine.
+ * Copyright (C) 2016-2017 Yosuke Demura
+ * except where otherwise indicated.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mate_pattern.h"
+
+#if defined(__linux__)
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+#include <cinttypes>
+#include <cstdio>
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <unordered_map>
+#include <vector>
+#include "gamedb.h"
+#include "mate3.h"
+#include "position.h"
+
+const uint8_t* MatePatternTable::table_ = nullptr;
+bool MatePatternTable::enabled_ = true;
+
+namespace {
+
+/**
+ * 表の値の種類の数です.
+ *
+ * 表の値は、0が「該当する手なし」で、それ以外は 1 + (駒の種類 - 歩) * 10 + 打つマス となります。
+ * 打つマスは、0〜7が玉から見た方向（攻め方から見た向きに正規化済み）で、8と9が桂馬を打つ２マスです。
+ */
+constexpr int kNumCodes = 1 + 7 * 10;
+
+thread_local MatePatternTable::Stats g_stats;
+
+#if !defined(__linux__)
+std::vector<uint8_t> g_table_buffer;
+#endif
+
+/**
+ * 後手が攻め方の場合に、方向のビットセットを180度回転させて、先手が攻め方の場合の向きに揃えます.
+ */
+inline uint32_t NormalizeDirections(DirectionSet ds, Color attacker) {
+  uint32_t bits = static_cast<uint32_t>(ds);
+  if (attacker == kWhite) {
+    uint32_t reversed = 0;
+    for (int i = 0; i < 8; ++i) {
+      reversed |= ((bits >> i) & 1) << (7 - i); // inverse_direction(d) == 7 - d
+    }
+    bits = reversed;
+  }
+  return bits;
+}
+
+/**
+ * 桂馬を打つ２マスのうち、攻め方から見て右側のマスであればtrueを返します.
+ */
+inline bool IsRightKnightSquare(Square to, Square ksq, Color attacker) {
+  return attacker == kBlack ? to.file() < ksq.file() : to.file() > ksq.file();
+}
+
+} // namespace
+
+void MatePatternTable::Init(const char* const file_name) {
+  table_ = nullptr;
+
+#if defined(__linux__)
+  int fd = open(file_name, O_RDONLY);
+  if (fd == -1) {
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) == kNumEntries) {
+    void* ptr = mmap(nullptr, kNumEntries, PROT_READ, MAP_SHARED, fd, 0);
+    if (ptr != MAP_FAILED) {
+      table_ = static_cast<const uint8_t*>(ptr);
+    }
+  }
+  close(fd);
+#else
+  std::FILE* file = std::fopen(file_name, "rb");
+  if (file == nullptr) {
+    return;
+  }
+  g_table_buffer.resize(kNumEntries);
+  if (std::fread(g_table_buffer.data(), 1, kNumEntries, file) == kNumEntries) {
+    table_ = g_table_buffer.data();
+  }
+  std::fclose(file);
+#endif
+}
+
+uint32_t MatePatternTable::ComputeKey(const Position& pos) {
+  const Color attacker = pos.side_to_move();
+  const Square ksq = pos.king_square(~attacker);
+  const ExtendedBoard& eb = pos.extended_board();
+  EightNeighborhoods neighborhood_attacks  = eb.GetEightNeighborhoodControls( attacker, ksq);
+  EightNeighborhoods neighborhood_defenses = eb.GetEightNeighborhoodControls(~attacker, ksq);
+
+  DirectionSet attack1 = neighborhood_attacks.more_than(0);
+  DirectionSet defense = neighborhood_defenses.more_than(1);
+  DirectionSet on_board = neighborhood8_bb(ksq).neighborhood8(ksq);
+  DirectionSet own_pieces = pos.pieces(attacker).neighborhood8(ksq);
+  DirectionSet occ = pos.pieces().neighborhood8(ksq);
+
+  // ３手詰の初手は捨て駒になることがあるので、攻め方の利きの有無は問わない
+  DirectionSet drop_targets = on_board & ~(defense | occ);
+  DirectionSet evasions = on_board & ~attack1 & (~occ | own_pieces);
+  uint32_t hand_set = (static_cast<uint32_t>(pos.hand(attacker).GetHandSet()) >> kPawn) & 0x7f;
+
+  return  NormalizeDirections(drop_targets, attacker)
+       | (NormalizeDirections(evasions, attacker) << 8)
+       | (hand_set << 16);
+}
+
+Move MatePatternTable::DecodeMove(const Position& pos, const uint8_t code) {
+  assert(0 < code && code < kNumCodes);
+
+  const Color attacker = pos.side_to_move();
+  const Square ksq = pos.king_square(~attacker);
+  const PieceType pt = static_cast<PieceType>(kPawn + (code - 1) / 10);
+  const int target = (code - 1) % 10;
+
+  if (!pos.hand(attacker).has(pt)) {
+    return kMoveNone;
+  }
+
+  // 駒を打つマスを求める
+  Bitboard to_bb;
+  if (target < 8) {
+    Direction dir = static_cast<Direction>(target);
+    if (attacker == kWhite) {
+      dir = inverse_direction(dir);
+    }
+    to_bb = direction_bb(ksq, DirectionSet(dir));
+  } else {
+    Bitboard knight_squares = Bitboard::step_attacks_bb(Piece(~attacker, kKnight), ksq);
+    knight_squares.ForEach([&](Square s) {
+      if (IsRightKnightSquare(s, ksq, attacker) == (target == 9)) {
+        to_bb.set(s);
+      }
+    });
+  }
+  if (to_bb.none()) {
+    return kMoveNone;
+  }
+  const Square to = to_bb.first_one();
+
+  // 空きマスに打つ王手であることを確認する（行きどころのない駒も、ここで除外される）
+  if (   pos.pieces().test(to)
+      || !Bitboard::max_attacks_bb(Piece(attacker, pt), to).test(ksq)) {
+    return kMoveNone;
+  }
+
+  const Move move(attacker, pt, to);
+  if (!pos.MoveIsPseudoLegal(move) || !pos.PseudoLegalMoveIsLegal(move)) {
+    return kMoveNone;
+  }
+  return move;
+}
+
+uint8_t MatePatternTable::EncodeMove(const Position& pos, const Move move) {
+  assert(move.is_drop());
+
+  const Color attacker = pos.side_to_move();
+  const Square ksq = pos.king_square(~attacker);
+  const Square to = move.to();
+
+  int target = -1;
+  if (move.piece_type() == kKnight) {
+    target = IsRightKnightSquare(to, ksq, attacker) ? 9 : 8;
+  } else {
+    for (int i = 0; i < 8; ++i) {
+      Direction dir = static_cast<Direction>(i);
+      if (direction_bb(ksq, DirectionSet(dir)).test(to)) {
+        target = attacker == kWhite ? inverse_direction(dir) : dir;
+        break;
+      }
+    }
+  }
+
+  // 玉から離れたマスへの駒打（香・角・飛の遠くからの王手）は、表に登録しない
+  if (target == -1) {
+    return 0;
+  }
+
+  return static_cast<uint8_t>(1 + (move.piece_type() - kPawn) * 10 + target);
+}
+
+Move MatePatternTable::Probe(const Position& pos) {
+  assert(enabled());
+  assert(pos.king_exists(~pos.side_to_move()));
+
+  g_stats.probes += 1;
+  const uint8_t code = table_[ComputeKey(pos)];
+  return code == 0 ? kMoveNone : DecodeMove(pos, code);
+}
+
+MatePatternTable::Stats& MatePatternTable::stats() {
+  return g_stats;
+}
+
+void MatePatternTable::PrintStats() {
+  const Stats& s = g_stats;
+  uint64_t misses = s.probes - s.hits - s.false_hits;
+  std::printf("MatePatternTable: probes=%" PRIu64 " hits=%" PRIu64
+              " false_hits=%" PRIu64 " misses=%" PRIu64 " (hit rate %.1f%%)\n",
+              s.probes, s.hits, s.false_hits, misses,
+              100.0 * s.hits / std::max<uint64_t>(s.probes, 1));
+}
+
+#if !defined(MINIMUM)
+
+void MatePatternTable::Generate(const char* const output_file_name) {
+  // 棋譜DBを準備する
+  std::ifstream game_db_file(GameDatabase::kDefaultDatabaseFile);
+  GameDatabase game_db(game_db_file);
+  std::vector<Game> all_games;
+  for (Game game; game_db.ReadOneGame(&game); ) {
+    all_games.push_back(game);
+  }
+  std::printf("Read %zu games.\n", all_games.size());
+
+  // キーごとに、そのキーを持つ全局面で、各駒打が実際に３手以内の詰みになるかを調べて数える
+  // （探索が最初に見つけた手だけを数えると、他の局面でもその手で詰むかどうかが分からないため）
+  struct Votes {
+    uint32_t num_occurrences = 0;
+    std::array<uint32_t, kNumCodes> num_mates{};
+  };
+  std::unordered_map<uint32_t, Votes> votes;
+  uint64_t num_positions = 0, num_candidates = 0, num_mating_drops = 0;
+
+#pragma omp parallel for schedule(dynamic) reduction(+:num_positions,num_candidates,num_mating_drops)
+  for (size_t game_id = 0; game_id < all_games.size(); ++game_id) {
+    const Game& game = all_games[game_id];
+    Position pos = Position::CreateStartPosition();
+
+    for (Move move : game.moves) {
+      if (!pos.MoveIsLegal(move)) {
+        break;
+      }
+
+      if (!pos.in_check() && pos.king_exists(~pos.side_to_move())) {
+        // 表を引いたときと同じ手順で、各候補の駒打を実際の局面で確かめる
+        std::array<bool, kNumCodes> mates{};
+        num_positions += 1;
+        for (int code = 1; code < kNumCodes; ++code) {
+          const Move drop = DecodeMove(pos, static_cast<uint8_t>(code));
+          if (drop == kMoveNone) {
+            continue;
+          }
+          num_candidates += 1;
+          Mate3Result result;
+          mates[code] = MoveLeadsToMateInThreePlies(pos, drop, &result);
+          num_mating_drops += mates[code];
+        }
+        const uint32_t key = ComputeKey(pos);
+#pragma omp critical
+        {
+          Votes& v = votes[key];
+          v.num_occurrences += 1;
+          for (int code = 1; code < kNumCodes; ++code) {
+            v.num_mates[code] += mates[code];
+          }
+        }
+      }
+
+      pos.MakeMove(move);
+    }
+  }
+
+  // 最も多くの局面で詰みになった駒打を、そのキーの手として登録する
+  // ただし、そのキーを持つ局面の半数以上で詰みにならない手は、表を引いても無駄になりやすいので登録しない
+  std::vector<uint8_t> table(kNumEntries, 0);
+  size_t num_patterns = 0;
+  for (const auto& entry : votes) {
+    const Votes& v = entry.second;
+    int best_code = 1;
+    for (int code = 2; code < kNumCodes; ++code) {
+      if (v.num_mates[code] > v.num_mates[best_code]) {
+        best_code = code;
+      }
+    }
+    if (2 * v.num_mates[best_code] >= v.num_occurrences && v.num_mates[best_code] > 0) {
+      table[entry.first] = static_cast<uint8_t>(best_code);
+      num_patterns += 1;
+    }
+  }
+  std::printf("Positions=%" PRIu64 " CandidateDrops=%" PRIu64 " MatingDrops=%" PRIu64
+              " Patterns=%zu\n", num_positions, num_candidates, num_mating_drops,
+              num_patterns);
+
+  // ファイルに保存する
+  std::FILE* file = std::fopen(output_file_name, "wb");
+  if (file == nullptr) {
+    std::printf("Failed to open %s.\n", output_file_name);
+  } else {
+    std::fwrite(table.data(), 1, table.size(), file);
+    std::fclose(file);
+    std::printf("Mate patterns are written to %s.\n", output_file_name);
+  }
+}
+
+#endif // !defined(MINIMUM)
@@ -0,0 +1,120 @@
+/*
+ * 技巧 (Gikou), a USI shogi (Japanese chess) playing engine.
+ * Copyright (C) 2016-2017 Yosuke Demura
+ * except where otherwise indicated.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MATE_PATTERN_H_
+#define MATE_PATTERN_H_
+
+#include <cstddef>
+#include <cstdint>
+#include "move.h"
+
+class Position;
+
+/**
+ * ３手詰の詰み筋（初手の駒打）を、受け方の玉の８近傍のパターンと攻め方の持ち駒から引くための表です.
+ *
+ * 持ち駒が多い終盤では、近接王手の数が多くなり、IsMateInThreePlies()の実行時間が長くなりがちです。
+ * そこで、棋譜に現れた局面で各駒打が実際に詰むかを確かめて、「この８近傍のパターンとこの持ち駒なら、この駒打が詰み筋になりやすい」
+ * という表をオフラインで作っておき、３手詰探索の前に、表から引いた手を最初に試すようにします。
+ *
+ * 表のキーは、１手詰関数（mate1ply.cc）の駒打テーブルと同様に、
+ *   - 受け方の玉以外の駒で取られることなく、駒を打てる空きマス（８ビット）
+ *   - 受け方の玉が逃げられるマス（８ビット）
+ *   - 攻め方の持ち駒の有無（歩、香、桂、銀、金、角、飛の７ビット）
+ * を組み合わせた23ビットの値です（方向は、攻め方から見た向きに正規化します）。
+ * 表から引いた手は、実際の局面で詰みを確認してから使うので、表の内容が探索結果を変えることはありません。
+ *
+ * 表のファイル（mate_patterns.bin）は、Linuxではmmap()で読み込むので、複数のプロセスで共有されます。
+ */
+class MatePatternTable {
+ public:
+  /** 表のファイル名. */
+  static constexpr const char* kDefaultFile = "mate_patterns.bin";
+
+  /** 表の要素数（キーのビット数は23）. */
+  static constexpr size_t kNumEntries = size_t(1) << 23;
+
+  /**
+   * 表の利用状況に関する統計です（スレッドごとに集計されます）.
+   */
+  struct Stats {
+    /** 表を引いた回数 */
+    uint64_t probes = 0;
+    /** 表から引いた手で、実際に３手詰が見つかった回数 */
+    uint64_t hits = 0;
+    /** 表から引いた手が、３手詰にならなかった回数 */
+    uint64_t false_hits = 0;
+  };
+
+  /**
+   * ファイルから表を読み込みます（ファイルが存在しない場合は、表を使用しません）.
+   */
+  static void Init(const char* file_name = kDefaultFile);
+
+  /**
+   * 表が読み込まれていて、かつ、使用が有効になっていればtrueを返します.
+   */
+  static bool enabled() {
+    return table_ != nullptr && enabled_;
+  }
+
+  /**
+   * 表の使用の有無を切り替えます（ベンチマーク用）.
+   */
+  static void set_enabled(bool enabled) {
+    enabled_ = enabled;
+  }
+
+  /**
+   * 表を引いて、３手詰の初手の候補となる駒打を返します.
+   * @param pos 攻め方の手番の局面
+   * @return 候補となる駒打（表に該当する手がないか、その手が非合法の場合は、kMoveNone）
+   */
+  static Move Probe(const Position& pos);
+
+  /**
+   * 呼び出したスレッドでの、表の利用状況の統計を返します.
+   */
+  static Stats& stats();
+
+  /**
+   * 呼び出したスレッドでの、表の利用状況の統計を表示します.
+   */
+  static void PrintStats();
+
+#if !defined(MINIMUM)
+  /**
+   * 棋譜DBに現れる局面から表を作成して、ファイルに保存します.
+   * 各局面で、表に登録できるすべての駒打について、実際に３手以内に詰むかを確かめます。
+   * キーごとに最も多くの局面で詰んだ駒打を選び、そのキーを持つ局面の半数以上で詰む場合にのみ登録します。
+   * @param output_file_name 出力する表のファイル名
+   */
+  static void Generate(const char* output_file_name = kDefaultFile);
+#endif
+
+ private:
+  static uint32_t ComputeKey(const Position& pos);
+  static Move DecodeMove(const Position& pos, uint8_t code);
+  static uint8_t EncodeMove(const Position& pos, Move move);
+
+  static const uint8_t* table_;
+  static bool enabled_;
+};
+
+#endif /* MATE_PATTERN_H_ */
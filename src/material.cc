@@ -23,54 +23,58 @@
 #include "common/array.h"
 #include "evaluation.h"
 
-ArrayMap<Score, PieceType> Material::values_;
-ArrayMap<Score, PieceType> Material::promotion_values_;
-ArrayMap<Score, PieceType> Material::exchange_values_;
-ArrayMap<Score, PieceType> Material::exchange_orders_;
+MaterialTables Material::shared_tables_;
+__thread const MaterialTables* Material::thread_tables_ = nullptr;
 
 void Material::Init() {
-  values_[kNoPieceType]           = kScoreZero;
-  promotion_values_[kNoPieceType] = kScoreZero;
-  exchange_values_[kNoPieceType]  = kScoreZero;
-  exchange_orders_[kNoPieceType]  = kScoreZero;
-  SetValue(kKing, kScoreZero);
   UpdateTables();
 }
 
 void Material::UpdateTables() {
+  shared_tables_.Update(*g_eval_params);
+}
+
+void MaterialTables::Update(const EvalParameters& params) {
+  values[kNoPieceType]           = kScoreZero;
+  promotion_values[kNoPieceType] = kScoreZero;
+  exchange_values[kNoPieceType]  = kScoreZero;
+  exchange_orders[kNoPieceType]  = kScoreZero;
+  promotion_values[kGold] = kScoreZero;
+  promotion_values[kKing] = kScoreZero;
+  SetValue(kKing, kScoreZero);
   for (PieceType pt : Piece::all_piece_types()) {
     if (pt != kKing) {
-      SetValue(pt, g_eval_params->material[pt]);
+      SetValue(pt, params.material[pt]);
     }
   }
   UpdateExchangeOrders();
 }
-
-void Material::SetValue(PieceType pt, Score value) {
+
+void MaterialTables::SetValue(PieceType pt, Score value) {
   // 1. 駒の価値を更新する
-  values_[pt] = value;
+  values[pt] = value;
 
-  // 2. 駒が成る価値（promotion_values_）と駒の交換値（exchange_values_）を更新する
+  // 2. 駒が成る価値（promotion_values）と駒の交換値（exchange_values）を更新する
   if (IsPromotablePieceType(pt)) {
-    promotion_values_[pt] = values_[GetPromotedType(pt)] - value;
-    exchange_values_[pt] = 2 * value;
+    promotion_values[pt] = values[GetPromotedType(pt)] - value;
+    exchange_values[pt] = 2 * value;
   } else if (IsPromotedPieceType(pt)) {
     PieceType ot = GetOriginalType(pt);
-    promotion_values_[ot] = value - values_[ot];
-    exchange_values_[pt] = value + values_[ot];
+    promotion_values[ot] = value - values[ot];
+    exchange_values[pt] = value + values[ot];
   } else {
     assert(pt == kGold || pt == kKing);
-    assert(promotion_values_[pt] == kScoreZero);
-    exchange_values_[pt] = 2 * value;
+    assert(promotion_values[pt] == kScoreZero);
+    exchange_values[pt] = 2 * value;
   }
 }
 
-void Material::UpdateExchangeOrders() {
+void MaterialTables::UpdateExchangeOrders() {
   // 1. 駒の価値を、一時的に別の配列にコピーする
   typedef std::pair<PieceType, Score> Pair;
   Array<Pair, 16> temp;
   for (PieceType pt : Piece::all_piece_types()) {
-    temp[pt] = std::make_pair(pt, exchange_values_[pt]);
+    temp[pt] = std::make_pair(pt, exchange_values[pt]);
   }
 
   // 2. 駒の価値の昇順で並べ替える
@@ -79,12 +83,12 @@ void Material::UpdateExchangeOrders() {
     return lhs.second < rhs.second;
   });
 
-  // 3. 駒の交換順位（exchange_orderes_）を更新する
+  // 3. 駒の交換順位（exchange_orders）を更新する
   int order = 0;
   for (const Pair& pair : temp) {
     PieceType pt = pair.first;
     if (pt != kNoPieceType) {
-      exchange_orders_[pt] = static_cast<Score>(++order);
+      exchange_orders[pt] = static_cast<Score>(++order);
     }
   }
 }
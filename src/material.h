@@ -22,6 +22,29 @@
 
 #include "piece.h"
 
+struct EvalParameters;
+
+/**
+ * 駒の価値に関するテーブルの一式です.
+ * 通常はMaterialクラスが保持する１組のみを使いますが、学習中の交差検定やプロセス内合議の投票者のように、
+ * 別の評価パラメータで並行して探索を行う場合には、そのパラメータ用のテーブルを別途作成します。
+ */
+struct MaterialTables {
+  /**
+   * 評価パラメータの駒割りを読み出し、その値で全テーブルを計算し直します.
+   */
+  void Update(const EvalParameters& params);
+
+  ArrayMap<Score, PieceType> values;
+  ArrayMap<Score, PieceType> promotion_values;
+  ArrayMap<Score, PieceType> exchange_values;
+  ArrayMap<Score, PieceType> exchange_orders;
+
+ private:
+  void SetValue(PieceType pt, Score value);
+  void UpdateExchangeOrders();
+};
+
 /**
  * 駒の価値を管理するクラスです.
  *
@@ -42,19 +65,19 @@ class Material {
   static void Init();
 
   static Score value(PieceType pt) {
-    return values_[pt];
+    return tables().values[pt];
   }
 
   static Score promotion_value(PieceType pt) {
-    return promotion_values_[pt];
+    return tables().promotion_values[pt];
   }
 
   static Score exchange_value(PieceType pt) {
-    return exchange_values_[pt];
+    return tables().exchange_values[pt];
   }
 
   static Score exchange_order(PieceType pt) {
-    return exchange_orders_[pt];
+    return tables().exchange_orders[pt];
   }
 
   /**
@@ -64,13 +87,22 @@ class Material {
    */
   static void UpdateTables();
 
+  /**
+   * 呼び出したスレッドで用いる、駒の価値のテーブルを設定します.
+   * Evaluation::SetThreadParameters()で別の評価パラメータを使う場合に、その駒割りと合わせるために使用します。
+   * @param tables 駒の価値のテーブル（nullptrの場合は、UpdateTables()で更新される共有のテーブルを用いる）
+   */
+  static void SetThreadTables(const MaterialTables* tables) {
+    thread_tables_ = tables;
+  }
+
  private:
-  static void SetValue(PieceType pt, Score value);
-  static void UpdateExchangeOrders();
-  static ArrayMap<Score, PieceType> values_;
-  static ArrayMap<Score, PieceType> promotion_values_;
-  static ArrayMap<Score, PieceType> exchange_values_;
-  static ArrayMap<Score, PieceType> exchange_orders_;
+  static const MaterialTables& tables() {
+    return thread_tables_ != nullptr ? *thread_tables_ : shared_tables_;
+  }
+  static MaterialTables shared_tables_;
+  // 探索中に頻繁に参照されるので、ラッパー関数を経由しない__threadを用いている
+  static __thread const MaterialTables* thread_tables_;
 };
 
 #endif /* MATERIAL_H_ */
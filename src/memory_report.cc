@@ -0,0 +1,111 @@
+/*
+ * 技巧 (Gikou), a USI shogi (Japanese chess) playing engine.
+ * Copyright (C) 2016-2017 Yosuke Demura
+ * except where otherwise indicated.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "memory_report.h"
+
+#include <cstdio>
+#include "synced_printf.h"
+
+namespace {
+
+/**
+ * バイト数を、人間が読みやすい形式（例："12.81 MB", "20.25 KB"）に変換します.
+ */
+std::string FormatSize(size_t bytes) {
+  char buf[32];
+  if (bytes >= 1024 * 1024) {
+    std::snprintf(buf, sizeof(buf), "%.2f MB", bytes / (1024.0 * 1024.0));
+  } else {
+    std::snprintf(buf, sizeof(buf), "%.2f KB", bytes / 1024.0);
+  }
+  return std::string(buf);
+}
+
+/**
+ * /proc/self/status の「VmRSS: 12345 kB」のような行を読み、バイト単位で返します.
+ * @param format 読み取る行のフォーマット（例："VmRSS: %lu kB"）
+ * @param path   読み取るファイル
+ */
+size_t ReadProcStatus(const char* format,
+                      const char* path = "/proc/self/status") {
+  size_t bytes = 0;
+#if defined(__linux__)
+  std::FILE* fp = std::fopen(path, "r");
+  if (fp == nullptr) {
+    return 0;
+  }
+  char line[256];
+  while (std::fgets(line, sizeof(line), fp) != nullptr) {
+    unsigned long kilobytes = 0;
+    if (std::sscanf(line, format, &kilobytes) == 1) {
+      bytes = static_cast<size_t>(kilobytes) * 1024;
+      break;
+    }
+  }
+  std::fclose(fp);
+#endif
+  return bytes;
+}
+
+} // namespace
+
+void MemoryReport::Add(const std::string& name, size_t bytes, size_t count) {
+  items_.push_back(Item{name, bytes, count});
+}
+
+size_t MemoryReport::total_bytes() const {
+  size_t total = 0;
+  for (const Item& item : items_) {
+    total += item.bytes * item.count;
+  }
+  return total;
+}
+
+void MemoryReport::Print(const char* prefix) const {
+  for (const Item& item : items_) {
+    if (item.count == 1) {
+      SYNCED_PRINTF("%s%-40s %12s\n", prefix, item.name.c_str(),
+                    FormatSize(item.bytes).c_str());
+    } else {
+      SYNCED_PRINTF("%s%-40s %12s (%s x %d)\n", prefix, item.name.c_str(),
+                    FormatSize(item.bytes * item.count).c_str(),
+                    FormatSize(item.bytes).c_str(), static_cast<int>(item.count));
+    }
+  }
+  SYNCED_PRINTF("%s%-40s %12s\n", prefix, "Total (estimated)",
+                FormatSize(total_bytes()).c_str());
+
+  size_t rss = GetResidentSetSize();
+  if (rss != 0) {
+    SYNCED_PRINTF("%s%-40s %12s\n", prefix, "Resident set size (measured)",
+                  FormatSize(rss).c_str());
+  }
+}
+
+size_t MemoryReport::GetResidentSetSize() {
+  return ReadProcStatus("VmRSS: %lu kB");
+}
+
+size_t MemoryReport::GetPeakResidentSetSize() {
+  return ReadProcStatus("VmHWM: %lu kB");
+}
+
+size_t MemoryReport::GetAnonHugePagesSize() {
+  return ReadProcStatus("AnonHugePages: %lu kB", "/proc/self/smaps_rollup");
+}
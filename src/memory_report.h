@@ -0,0 +1,86 @@
+/*
+ * 技巧 (Gikou), a USI shogi (Japanese chess) playing engine.
+ * Copyright (C) 2016-2017 Yosuke Demura
+ * except where otherwise indicated.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MEMORY_REPORT_H_
+#define MEMORY_REPORT_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * エンジンの各テーブルが使用しているメモリ量を集計して、表示するためのクラスです.
+ *
+ * 使用例：
+ * @code
+ * MemoryReport report;
+ * report.Add("HashTable", hash_table.memory_size());
+ * report.Add("Search", sizeof(Search), num_threads); // スレッド数分のコピーがある場合
+ * report.Print("info string "); // USIのinfoコマンドとして表示する
+ * @endcode
+ */
+class MemoryReport {
+ public:
+  /**
+   * 構成要素のメモリ使用量を追加します.
+   * @param name  構成要素の名前
+   * @param bytes 構成要素１個あたりの大きさ（バイト単位）
+   * @param count 構成要素の個数（スレッドごとに確保されるものは、スレッド数）
+   */
+  void Add(const std::string& name, size_t bytes, size_t count = 1);
+
+  /**
+   * 追加された構成要素の合計サイズを返します（バイト単位）.
+   */
+  size_t total_bytes() const;
+
+  /**
+   * 構成要素ごとのメモリ使用量と、その合計を表示します.
+   * @param prefix 各行の先頭に付ける文字列（USIで表示する場合は、"info string "）
+   */
+  void Print(const char* prefix = "") const;
+
+  /**
+   * このプロセスが実際に使用している物理メモリ量（RSS）を返します（バイト単位）.
+   * 取得できない環境では、0を返します。
+   */
+  static size_t GetResidentSetSize();
+
+  /**
+   * このプロセスがこれまでに使用した物理メモリ量の最大値（ピークRSS）を返します（バイト単位）.
+   * 取得できない環境では、0を返します。
+   */
+  static size_t GetPeakResidentSetSize();
+
+  /**
+   * このプロセスの匿名メモリのうち、ラージページ（THP）に割り当てられている量を返します（バイト単位）.
+   * 取得できない環境では、0を返します。
+   */
+  static size_t GetAnonHugePagesSize();
+
+ private:
+  struct Item {
+    std::string name;
+    size_t bytes;
+    size_t count;
+  };
+  std::vector<Item> items_;
+};
+
+#endif /* MEMORY_REPORT_H_ */
@@ -121,6 +121,31 @@ Move Move::FromSfen(const std::string& sfen, const Position& pos) {
   }
 }
 
+uint16_t Move::ToUint16() const {
+  uint32_t u16 = move_[kKeyDestination] << kKeyDestination.shift
+               | move_[kKeyPromotion]   << kKeyPromotion.shift;
+  if (is_drop()) {
+    u16 |= static_cast<uint32_t>(piece_type()) << kKeySource.shift;
+    u16 |= kKeyDrop.mask;
+  } else {
+    u16 |= move_[kKeySource] << kKeySource.shift;
+  }
+  return static_cast<uint16_t>(u16);
+}
+
+Move Move::FromUint16(uint16_t u16, const Position& pos) {
+  BitField<uint32_t> bits(u16);
+  Square to(bits[kKeyDestination]);
+  if (bits[kKeyDrop]) {
+    PieceType pt = static_cast<PieceType>(bits[kKeySource]);
+    return Move(pos.side_to_move(), pt, to);
+  } else {
+    Square from(bits[kKeySource]);
+    bool promotion = bits[kKeyPromotion];
+    return Move(pos.piece_on(from), from, to, promotion, pos.piece_on(to));
+  }
+}
+
 Move& Move::Flip() {
   if (is_drop()) {
     *this = Move(piece().opponent_piece(), to().inverse_square());
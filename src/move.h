@@ -235,6 +235,10 @@ class Move {
 
   /**
    * Move型から、16ビット整数型に変換します.
+   *
+   * 下位15ビットは、移動先のマス・成る手のフラグ・移動元のマスで、32ビット整数型と同じ配置です。
+   * 最上位ビットは打つ手のフラグで、打つ手の場合は、移動元のマスの代わりに打つ駒の種類を保存します。
+   * 動かす駒と取る駒の情報は失われるので、元に戻すときには局面が必要になります。
    */
   uint16_t ToUint16() const;
 
@@ -245,7 +249,7 @@ class Move {
 
   /**
    * 16ビット整数型から、Move型に変換します.
-   * TODO 現状では未実装です。
+   * 動かす駒と取る駒は、与えられた局面（その手を指す直前の局面）から補います。
    */
   static Move FromUint16(uint16_t, const Position&);
 
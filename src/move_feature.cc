@@ -691,7 +691,7 @@ MoveFeatureList ExtractMoveFeatures(const Move move, const Position& pos,
 
     // Global SEE値（-1＜龍損＞から+1＜龍得＞までの連続値）
     if (!pos.in_check() && move.is_capture_or_promotion()) {
-      int global_see_score = Swap::EvaluateGlobalSwap(move, pos, 3);
+      int global_see_score = Swap::EvaluateGlobalSwap(move, pos_info.threat_map);
       float normalized_global_see_score = float(global_see_score) * kMaterialScale;
       float global_see_value = min_max(normalized_global_see_score, -1.0f, 1.0f);
       feature_list.continuous_values[kGlobalSeeValue] = global_see_value;
@@ -1849,7 +1849,8 @@ PositionInfo::PositionInfo(const Position& pos,
     : history(history_stats),
       gains(gains_stats),
       countermoves_history(cmh),
-      followupmoves_history(fmh) {
+      followupmoves_history(fmh),
+      threat_map(pos) {
   const Color stm = pos.side_to_move();
   const Square own_ksq = pos.king_square(stm);
   const Square opp_ksq = pos.king_square(~stm);
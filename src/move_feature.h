@@ -24,6 +24,7 @@
 #include "common/array.h"
 #include "bitboard.h"
 #include "move.h"
+#include "swap.h"
 class Position;
 class HistoryStats;
 class GainsStats;
@@ -118,6 +119,9 @@ struct PositionInfo {
 
   /** 敵玉24近傍にある敵の銀 */
   Bitboard opponent_king_neighborhood_silvers;
+
+  /** Global SEE値の計算に用いる、局面の利きの情報 */
+  ThreatMap threat_map;
 };
 
 /**
@@ -20,14 +20,18 @@
 #include "move_probability.h"
 
 #include <fstream>
+#include <limits>
+#include <string>
 #include <thread>
 #include <omp.h>
 #include "common/math.h"
 #include "common/pack.h"
 #include "common/progress_timer.h"
 #include "gamedb.h"
+#include "large_page.h"
 #include "movegen.h"
 #include "move_feature.h"
+#include "numa.h"
 #include "position.h"
 #include "progress.h"
 #include "search.h"
@@ -50,6 +54,10 @@ constexpr int kLearningStartPly = 24;
 // History値収集に用いる探索の深さ
 constexpr Depth kSearchDepth = 7 * kOnePly;
 
+// 軽量モデルの蒸留に関する設定
+constexpr int    kNumDistillationIterations = 256;  // 重みの更新回数
+constexpr double kDistillationStep          = 0.1; // AdaGradの学習率
+
 // AdaDeltaの設定
 constexpr float kInitialStep = 0.05f; // 重みベクトルの最初の更新幅
 constexpr float kDecay = 0.95f;       // AdaDelta原論文のρ
@@ -63,6 +71,8 @@ struct PositionSample {
   Score see_value_of_teacher_move;
   double progress;
   std::vector<MoveFeatureList> features;
+  // 静かな手の番号（featuresの添字）と、その手の軽量モデル用の特徴（蒸留時のみ使用）
+  std::vector<std::pair<size_t, LightMoveProbability::Features>> light_features;
 };
 
 struct AccuracyStats {
@@ -99,6 +109,20 @@ typedef Pack<float, 4> PackedWeight;
 typedef std::valarray<PackedWeight> Weights;
 Weights g_weights;
 
+/**
+ * NUMAノードごとの、g_weightsの複製です.
+ */
+std::vector<LargePagePtr<PackedWeight[]>> g_weight_replicas;
+
+/**
+ * このスレッドで用いる重みです（nullptrの場合は、g_weightsを用いる）.
+ */
+thread_local const PackedWeight* t_weights = nullptr;
+
+inline const PackedWeight* weights() {
+  return t_weights != nullptr ? t_weights : &g_weights[0];
+}
+
 inline float HorizontalAdd(PackedWeight weight) {
   return weight[0] + weight[1] + weight[2] + weight[3];
 }
@@ -179,7 +203,8 @@ void ExtractGamesFromDatabase(std::vector<Game>* teacher_data,
 }
 
 void ComputeMoveFeatures(const std::vector<Game>& games,
-                         std::vector<PositionSample>* position_samples) {
+                         std::vector<PositionSample>* position_samples,
+                         bool extract_light_features = false) {
   assert(position_samples != nullptr);
 
   const Position kStartPosition = Position::CreateStartPosition();
@@ -287,6 +312,25 @@ void ComputeMoveFeatures(const std::vector<Game>& games,
         sample.features.back().shrink_to_fit();
       }
 
+      // 軽量モデルの蒸留を行う場合は、静かな手について、軽量モデル用の特徴も求める
+      // （MovePickerと同様に、ヒストリー値にはカウンター手かフォローアップ手の統計を加える）
+      if (extract_light_features && !sample.in_check) {
+        for (size_t i = 0; i < legal_moves.size(); ++i) {
+          const Move move = legal_moves[i].move;
+          if (!move.is_quiet()) {
+            continue;
+          }
+          int history_score = search.history()[move];
+          if (countermoves_history != nullptr) {
+            history_score += (*countermoves_history)[move];
+          } else if (followupmoves_history != nullptr) {
+            history_score += (*followupmoves_history)[move];
+          }
+          sample.light_features.emplace_back(
+              i, LightMoveProbability::ExtractFeatures(move, history_score, node));
+        }
+      }
+
       // 指し手の特徴を保存する（position_samplesは共有変数なので、排他制御を行う）
 #pragma omp critical
       {
@@ -484,6 +528,127 @@ void ComputeAccuracy(const std::vector<PositionSample>& position_samples,
   stats->num_test_positions = position_samples.size();
 }
 
+/**
+ * 軽量モデルを蒸留するための教師データです.
+ */
+struct LightSample {
+  std::vector<LightMoveProbability::Features> features;
+  std::vector<double> targets; // 通常のモデルによる、静かな手の中での条件付き確率
+  double quiet_mass;           // 通常のモデルによる、静かな手全体の確率
+};
+
+struct LightStats {
+  double loss = 0.0;
+  double agreement = 0.0;
+};
+
+std::vector<LightSample> ComputeLightSamples(
+    const std::vector<PositionSample>& position_samples) {
+  std::vector<LightSample> light_samples(position_samples.size());
+
+#pragma omp parallel for schedule(dynamic)
+  for (size_t pos_id = 0; pos_id < position_samples.size(); ++pos_id) {
+    const PositionSample& sample = position_samples.at(pos_id);
+    if (sample.light_features.size() < 2) {
+      continue;
+    }
+
+    // 通常のモデルで全合法手の確率を求め、静かな手の中での条件付き確率に直す
+    std::valarray<double> probabilities = ComputeMoveProbabilities(sample);
+    double quiet_mass = 0.0;
+    for (const auto& light_feature : sample.light_features) {
+      quiet_mass += probabilities[light_feature.first];
+    }
+    if (quiet_mass <= 0.0) {
+      continue;
+    }
+    LightSample& light_sample = light_samples.at(pos_id);
+    for (const auto& light_feature : sample.light_features) {
+      light_sample.features.push_back(light_feature.second);
+      light_sample.targets.push_back(probabilities[light_feature.first] / quiet_mass);
+    }
+    light_sample.quiet_mass = quiet_mass;
+  }
+
+  // 教師データにならなかった局面を取り除く
+  light_samples.erase(std::remove_if(light_samples.begin(), light_samples.end(),
+                                     [](const LightSample& light_sample) {
+    return light_sample.features.empty();
+  }), light_samples.end());
+
+  return light_samples;
+}
+
+/**
+ * 軽量モデルの損失（交差エントロピー）と、通常のモデルとの最善手の一致率を計算します.
+ * @param weights   軽量モデルの重み（自然対数の単位）
+ * @param gradients 勾配を保存するためのポインタ（nullptrの場合は、勾配を計算しない）
+ */
+LightStats ComputeLightGradients(const std::vector<LightSample>& light_samples,
+                                 const std::valarray<double>& weights,
+                                 std::valarray<double>* gradients) {
+  const int num_threads = omp_get_max_threads();
+  std::vector<std::valarray<double>> thread_local_gradients(
+      num_threads, std::valarray<double>(0.0, weights.size()));
+  double loss = 0.0;
+  double agreement = 0.0;
+
+#pragma omp parallel for reduction(+:loss, agreement) schedule(dynamic)
+  for (size_t pos_id = 0; pos_id < light_samples.size(); ++pos_id) {
+    const LightSample& light_sample = light_samples.at(pos_id);
+    const size_t num_moves = light_sample.features.size();
+
+    // ソフトマックス関数で、各指し手の確率を求める
+    std::valarray<double> scores(num_moves);
+    for (size_t i = 0; i < num_moves; ++i) {
+      scores[i] = 0.0;
+      for (uint8_t index : light_sample.features[i]) {
+        scores[i] += weights[index];
+      }
+    }
+    std::valarray<double> p = std::exp(scores - scores.max());
+    p /= p.sum();
+
+    // 損失と一致率を求める
+    size_t best_light = 0, best_teacher = 0;
+    for (size_t i = 0; i < num_moves; ++i) {
+      loss += -light_sample.targets[i] * std::log(std::max(p[i], 1e-12));
+      if (p[i] > p[best_light]) {
+        best_light = i;
+      }
+      if (light_sample.targets[i] > light_sample.targets[best_teacher]) {
+        best_teacher = i;
+      }
+    }
+    agreement += (best_light == best_teacher);
+
+    // 勾配を求める
+    if (gradients != nullptr) {
+      std::valarray<double>& g = thread_local_gradients.at(omp_get_thread_num());
+      for (size_t i = 0; i < num_moves; ++i) {
+        double delta = p[i] - light_sample.targets[i];
+        for (uint8_t index : light_sample.features[i]) {
+          g[index] += delta;
+        }
+      }
+    }
+  }
+
+  // 全スレッドの勾配を集計する
+  if (gradients != nullptr) {
+    *gradients = 0.0;
+    for (const std::valarray<double>& g : thread_local_gradients) {
+      *gradients += g;
+    }
+    *gradients /= static_cast<double>(light_samples.size());
+  }
+
+  LightStats stats;
+  stats.loss = loss / static_cast<double>(light_samples.size());
+  stats.agreement = agreement / static_cast<double>(light_samples.size());
+  return stats;
+}
+
 void PrintMoveProbabilities(Position pos) {
   // 1. 初期局面の合法手を生成する
   SimpleMoveList<kAllMoves, true> legal_moves(pos);
@@ -645,32 +810,43 @@ void MoveProbability::Learn() {
 
 ProbabilityCacheTable MoveProbability::cache_table_;
 
-std::unordered_map<uint32_t, float> MoveProbability::ComputeProbabilities(
-    const Position& pos, const HistoryStats& history, const GainsStats& gains,
+void MoveProbability::ComputeProbabilities(
+    const Position& pos, const SimpleMoveList<kAllMoves, true>& legal_moves,
+    const HistoryStats& history, const GainsStats& gains,
     const HistoryStats* countermoves_history,
-    const HistoryStats* followupmoves_history) {
-  // 合法手を生成する
-  SimpleMoveList<kAllMoves, true> legal_moves(pos);
+    const HistoryStats* followupmoves_history, double* const probabilities) {
   assert(legal_moves.size() >= 1);
+  assert(probabilities != nullptr);
 
   // 局面情報を収集する
-  PositionSample sample;
   PositionInfo pos_info(pos, history, gains, countermoves_history, followupmoves_history);
-  sample.progress = Progress::EstimateProgress(pos);
-  for (ExtMove em : legal_moves) {
-    sample.features.push_back(ExtractMoveFeatures(em.move, pos, pos_info));
-  }
+  const PackedWeight coefficient = GetProgressCoefficient(Progress::EstimateProgress(pos));
 
-  // 確率を計算する
-  std::valarray<double> p = ComputeMoveProbabilities(sample);
-
-  // 指し手と確率を対応付ける
-  std::unordered_map<uint32_t, float> move_probabilities;
+  // 各指し手に点数を付ける（特徴を保存せずに、その場で重みを合計する）
+  const PackedWeight* const w = weights();
+  double max_score = -std::numeric_limits<double>::infinity();
   for (size_t i = 0; i < legal_moves.size(); ++i) {
-    move_probabilities.emplace(legal_moves[i].move.ToUint32(), p[i]);
+    MoveFeatureList features = ExtractMoveFeatures(legal_moves[i].move, pos, pos_info);
+    PackedWeight sum(0.0f);
+    for (MoveFeatureIndex feature_index : features) {
+      sum += w[feature_index];
+    }
+    for (size_t j = 0; j < features.continuous_values.size(); ++j) {
+      sum += w[kNumBinaryMoveFeatures + j] * features.continuous_values[j];
+    }
+    probabilities[i] = HorizontalAdd(sum * coefficient);
+    max_score = std::max(max_score, probabilities[i]);
   }
 
-  return move_probabilities;
+  // ソフトマックス関数を適用して、確率を求める
+  double total = 0.0;
+  for (size_t i = 0; i < legal_moves.size(); ++i) {
+    probabilities[i] = std::exp(probabilities[i] - max_score);
+    total += probabilities[i];
+  }
+  for (size_t i = 0; i < legal_moves.size(); ++i) {
+    probabilities[i] /= total;
+  }
 }
 
 /**
@@ -693,6 +869,7 @@ std::unordered_map<uint32_t, float> MoveProbability::ComputeProbabilities(
    // 1. 進行度に応じた係数を求める
    const double progress = Progress::EstimateProgress(pos);
    const PackedWeight progress_coefficient = GetProgressCoefficient(progress);
+   const PackedWeight* const w = weights();
 
    // 2. 合法手を生成する
    SimpleMoveList<kAllMoves, true> legal_moves(pos);
@@ -724,12 +901,12 @@ std::unordered_map<uint32_t, float> MoveProbability::ComputeProbabilities(
        // 静的な指し手の重みを合計する
        PackedWeight sum(0.0f);
        for (MoveFeatureIndex feature_index : features) {
-         sum += g_weights[feature_index];
+         sum += w[feature_index];
        }
 
        // 連続値を取る特徴の重みも追加
-       sum += g_weights[kNumBinaryMoveFeatures + kSeeValue] * features.continuous_values[kSeeValue];
-       sum += g_weights[kNumBinaryMoveFeatures + kGlobalSeeValue] * features.continuous_values[kGlobalSeeValue];
+       sum += w[kNumBinaryMoveFeatures + kSeeValue] * features.continuous_values[kSeeValue];
+       sum += w[kNumBinaryMoveFeatures + kGlobalSeeValue] * features.continuous_values[kGlobalSeeValue];
 
        // 進行度に応じて内分を取る
        PackedWeight static_score = sum * progress_coefficient;
@@ -757,7 +934,7 @@ std::unordered_map<uint32_t, float> MoveProbability::ComputeProbabilities(
      PackedWeight sum(0.0f);
      for (size_t i = kHistoryValue; i <= kEvaluationGain; ++i) {
        float value = continuous_features[i];
-       sum += g_weights[kNumBinaryMoveFeatures + i] * value;
+       sum += w[kNumBinaryMoveFeatures + i] * value;
      }
 
      // 進行度に応じて内分を取る
@@ -819,6 +996,19 @@ const ProbabilityCacheTable::Entry* ProbabilityCacheTable::LookUp(Key64 key) con
    age_ = 0;
  }
 
+ size_t ProbabilityCacheTable::memory_size() const {
+   if (!table_) {
+     return 0;
+   }
+   size_t bytes = sizeof(Bucket) * size_;
+   for (size_t i = 0; i < size_; ++i) {
+     for (const Entry& entry : table_[i]) {
+       bytes += sizeof(float) * entry.data.size();
+     }
+   }
+   return bytes;
+ }
+
  void ProbabilityCacheTable::Clear() {
    for (size_t i = 0; i < size_; ++i) {
      Bucket& bucket = table_[i];
@@ -864,6 +1054,11 @@ const ProbabilityCacheTable::Entry* ProbabilityCacheTable::LookUp(Key64 key) con
 
 void MoveProbability::Init() {
   g_weights.resize(kNumMoveFeatures);
+  LargePageAllocator::Advise(&g_weights[0], sizeof(PackedWeight) * g_weights.size(),
+                             "MoveProbability weights");
+
+  // 軽量モデルの重みも読み込んでおく
+  LightMoveProbability::Init();
 
   // ファイルを開く
   std::FILE* fin = std::fopen("probability.bin", "rb");
@@ -881,3 +1076,202 @@ void MoveProbability::Init() {
     g_weights[i] = buf;
   }
 }
+
+size_t MoveProbability::weights_memory_size() {
+  return sizeof(PackedWeight) * g_weights.size();
+}
+
+void MoveProbability::ReplicateWeights(const int num_replicas) {
+  g_weight_replicas.clear();
+  g_weight_replicas.resize(num_replicas);
+  for (int node = 0; node < num_replicas; ++node) {
+    // ノード上のスレッドで確保・コピーすることにより、ノードのローカルメモリに配置する
+    Numa::RunOnNode(node, [&]() {
+      const std::string name = "MoveProbability weights (NUMA node " + std::to_string(node) + ")";
+      g_weight_replicas[node] = MakeLargePageArray<PackedWeight>(g_weights.size(), name.c_str());
+      if (g_weight_replicas[node]) {
+        std::copy(std::begin(g_weights), std::end(g_weights), g_weight_replicas[node].get());
+      }
+    });
+  }
+}
+
+void MoveProbability::SetThreadWeights(const int replica_id) {
+  t_weights = (replica_id >= 0 && replica_id < static_cast<int>(g_weight_replicas.size()))
+            ? g_weight_replicas[replica_id].get()
+            : nullptr;
+}
+
+#if !defined(MINIMUM)
+
+void MoveProbability::DistillLightModel() {
+  // スレッド数の設定
+  const int num_threads = std::max(1U, std::thread::hardware_concurrency());
+  omp_set_num_threads(num_threads);
+  std::printf("Set num_threads = %d\n", num_threads);
+
+  // 棋譜データの準備
+  std::printf("start reading games.\n");
+  std::vector<Game> teacher_data;
+  std::vector<Game> test_data;
+  ExtractGamesFromDatabase(&teacher_data, &test_data);
+  std::printf("finish reading games.\n");
+
+  // 通常のモデルで確率を計算し、蒸留の教師データとする
+  std::vector<LightSample> teacher_samples, test_samples;
+  {
+    std::vector<PositionSample> teacher_position_samples;
+    std::vector<PositionSample> test_position_samples;
+    ComputeMoveFeatures(teacher_data, &teacher_position_samples, true);
+    ComputeMoveFeatures(test_data, &test_position_samples, true);
+    teacher_samples = ComputeLightSamples(teacher_position_samples);
+    test_samples = ComputeLightSamples(test_position_samples);
+  }
+  if (teacher_samples.empty() || test_samples.empty()) {
+    std::printf("No positions to learn.\n");
+    return;
+  }
+  std::printf("teacher positions=%zu test positions=%zu\n",
+              teacher_samples.size(), test_samples.size());
+
+  // 重みを学習する（AdaGrad）
+  const int n = LightMoveProbability::kNumFeatures;
+  std::valarray<double> weights(0.0, n), gradients(0.0, n), accumulated(0.0, n);
+  for (int iteration = 1; iteration <= kNumDistillationIterations; ++iteration) {
+    LightStats teacher_stats = ComputeLightGradients(teacher_samples, weights, &gradients);
+    accumulated += gradients * gradients;
+    weights -= kDistillationStep * gradients / (std::sqrt(accumulated) + 1e-8);
+    LightStats test_stats = ComputeLightGradients(test_samples, weights, nullptr);
+    std::printf("%d Loss=%f Agreement=%f TestLoss=%f TestAgreement=%f\n",
+                iteration, teacher_stats.loss, teacher_stats.agreement,
+                test_stats.loss, test_stats.agreement);
+  }
+
+  // 整数（1/16ビット単位）に量子化する
+  const double kBitsPerNat = LightMoveProbability::kScale / std::log(2.0);
+  std::valarray<double> quantized_weights(n);
+  for (int i = 0; i < n; ++i) {
+    double w = std::round(weights[i] * kBitsPerNat);
+    w = std::max(std::min(w, double(INT16_MAX)), double(INT16_MIN));
+    LightMoveProbability::weights_[i] = static_cast<int16_t>(w);
+    quantized_weights[i] = w / kBitsPerNat;
+  }
+
+  // 静かな手全体の確率の対数を、平均して求める
+  double log_quiet_mass = 0.0;
+  for (const LightSample& light_sample : teacher_samples) {
+    log_quiet_mass += std::log2(light_sample.quiet_mass);
+  }
+  log_quiet_mass /= static_cast<double>(teacher_samples.size());
+  LightMoveProbability::quiet_bias_ = static_cast<int>(
+      std::round(log_quiet_mass * LightMoveProbability::kScale));
+
+  // 量子化による劣化を確認する
+  LightStats quantized_stats = ComputeLightGradients(test_samples, quantized_weights, nullptr);
+  std::printf("Quantized: TestLoss=%f TestAgreement=%f QuietBias=%d\n",
+              quantized_stats.loss, quantized_stats.agreement,
+              LightMoveProbability::quiet_bias_);
+
+  // 計算結果をファイルへ書き出す
+  std::FILE* fout = std::fopen("light_probability.bin", "wb");
+  if (fout == nullptr) {
+    std::printf("Failed to open light_probability.bin.\n");
+    return;
+  }
+  std::fwrite(LightMoveProbability::weights_.begin(), sizeof(int16_t), n, fout);
+  std::fwrite(&LightMoveProbability::quiet_bias_, sizeof(int), 1, fout);
+  std::fclose(fout);
+}
+
+#endif /* !defined(MINIMUM) */
+
+namespace {
+
+/**
+ * 2^(-i/16) を、2^16倍して整数にしたテーブルです（log-sum-expの計算に用います）.
+ */
+Array<uint32_t, 256> g_exp2_table;
+
+} // namespace
+
+Array<int16_t, LightMoveProbability::kNumFeatures> LightMoveProbability::weights_;
+int LightMoveProbability::quiet_bias_ = 0;
+bool LightMoveProbability::enabled_ = false;
+
+LightMoveProbability::Features LightMoveProbability::ExtractFeatures(
+    const Move move, const int history_score, const Position& pos) {
+  // 特徴の配置：駒の種類と打つ手かどうか(32), 成り(2), 移動先の段(9),
+  //             相手玉との距離(9), 自玉との距離(9), ヒストリー値(16)
+  constexpr int kPromotionOffset = 32;
+  constexpr int kRankOffset      = kPromotionOffset + 2;
+  constexpr int kEnemyKingOffset = kRankOffset + 9;
+  constexpr int kOwnKingOffset   = kEnemyKingOffset + 9;
+  constexpr int kHistoryOffset   = kOwnKingOffset + 9;
+  static_assert(kHistoryOffset + 16 == kNumFeatures, "");
+
+  const Color stm = pos.side_to_move();
+  const Square to = move.to();
+  auto king_distance = [&](Color c) -> int {
+    return pos.king_exists(c) ? Square::distance(to, pos.king_square(c)) : 8;
+  };
+  const int history_bucket = std::min(std::max((history_score + 512) >> 6, 0), 15);
+
+  Features features;
+  features[0] = 2 * move.piece_type() + move.is_drop();
+  features[1] = kPromotionOffset + move.is_promotion();
+  features[2] = kRankOffset + to.relative_square(stm).rank();
+  features[3] = kEnemyKingOffset + king_distance(~stm);
+  features[4] = kOwnKingOffset + king_distance(stm);
+  features[5] = kHistoryOffset + history_bucket;
+  return features;
+}
+
+int LightMoveProbability::ComputeLogPartition(const ExtMove* const begin,
+                                              const ExtMove* const end,
+                                              const Position& pos) {
+  if (begin == end) {
+    return 0;
+  }
+
+  // 最大値を基準にしながら、2^(score/16) の和を１パスで求める
+  int max_score = ComputeScore(begin->move, begin->score, pos);
+  uint64_t sum = 1 << 16;
+  for (const ExtMove* it = begin + 1; it != end; ++it) {
+    int score = ComputeScore(it->move, it->score, pos);
+    if (score > max_score) {
+      int diff = std::min(score - max_score, 255);
+      sum = ((sum * g_exp2_table[diff]) >> 16) + (1 << 16);
+      max_score = score;
+    } else if (max_score - score < 256) {
+      sum += g_exp2_table[max_score - score];
+    }
+  }
+
+  return max_score + static_cast<int>(
+      std::lround(kScale * std::log2(double(sum) / double(1 << 16))));
+}
+
+double LightMoveProbability::ComputeProbability(const Move move,
+                                                const int history_score,
+                                                const Position& pos,
+                                                const int log_partition) {
+  int score = ComputeScore(move, history_score, pos) - log_partition + quiet_bias_;
+  return std::exp2(std::min(score, 0) / double(kScale));
+}
+
+void LightMoveProbability::Init() {
+  for (size_t i = 0; i < g_exp2_table.size(); ++i) {
+    g_exp2_table[i] = static_cast<uint32_t>(
+        std::lround(double(1 << 16) * std::exp2(-double(i) / kScale)));
+  }
+
+  // 重みを読み込む（ファイルがなければ、このモデルは使わない）
+  enabled_ = false;
+  std::FILE* fin = std::fopen("light_probability.bin", "rb");
+  if (fin == nullptr) {
+    return;
+  }
+  enabled_ = std::fread(weights_.begin(), sizeof(int16_t), kNumFeatures, fin) == size_t(kNumFeatures)
+          && std::fread(&quiet_bias_, sizeof(int), 1, fin) == 1;
+  std::fclose(fin);
+}
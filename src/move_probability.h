@@ -22,9 +22,9 @@
 
 #include <memory>
 #include <mutex>
-#include <unordered_map>
 #include <valarray>
 #include <vector>
+#include "movegen.h"
 #include "move_feature.h"
 class Position;
 
@@ -85,6 +85,12 @@ class ProbabilityCacheTable {
    */
   void Clear();
 
+  /**
+   * テーブル本体と、各エントリに保存されているデータの大きさの合計を、バイト単位で返します.
+   * 注意：探索中に呼ぶと、正確な値が得られない場合があります。
+   */
+  size_t memory_size() const;
+
   /**
     * 特定のキーを読み書きする場合に、排他制御を行うためのロックをします.
     */
@@ -131,11 +137,15 @@ struct MoveProbability {
 
   /**
    * 指し手が指される確率を計算します.
+   * @param legal_moves   合法手のリスト
+   * @param probabilities 各合法手の確率を保存する配列（legal_movesと同じ順番で、
+   *                      legal_moves.size()個の確率が保存されます）
    */
-  static std::unordered_map<uint32_t, float> ComputeProbabilities(
-      const Position& pos, const HistoryStats& history, const GainsStats& gains,
+  static void ComputeProbabilities(
+      const Position& pos, const SimpleMoveList<kAllMoves, true>& legal_moves,
+      const HistoryStats& history, const GainsStats& gains,
       const HistoryStats* countermoves_history,
-      const HistoryStats* followupmoves_history);
+      const HistoryStats* followupmoves_history, double* probabilities);
 
   /**
    * 指し手が指される確率を計算します（キャッシュ機能付き）.
@@ -169,6 +179,31 @@ struct MoveProbability {
     cache_table_.Clear();
   }
 
+  /**
+   * キャッシュテーブルが使用しているメモリの大きさを、バイト単位で返します.
+   */
+  static size_t cache_table_memory_size() {
+    return cache_table_.memory_size();
+  }
+
+  /**
+   * 確率の計算に用いる重みの大きさを、バイト単位で返します.
+   */
+  static size_t weights_memory_size();
+
+  /**
+   * 確率の計算に用いる重みを、NUMAノードの数だけ複製します（詳細は、numa.hを参照）.
+   * 各複製は、そのノードに固定したスレッド上で確保・コピーされます。
+   * @param num_replicas 複製の数（0の場合は、既存の複製を破棄します）
+   */
+  static void ReplicateWeights(int num_replicas);
+
+  /**
+   * 呼び出したスレッドで、確率の計算に用いる重みの複製を設定します.
+   * @param replica_id 複製の番号（負の場合や、複製が存在しない場合は、元の重みを用いる）
+   */
+  static void SetThreadWeights(int replica_id);
+
   /**
    * 指し手が指される確率を棋譜から学習します.
    *
@@ -184,6 +219,15 @@ struct MoveProbability {
    */
   static void Learn();
 
+  /**
+   * 通常の実現確率モデルから、軽量な実現確率モデル（LightMoveProbability）の重みを蒸留します.
+   *
+   * 棋譜の各局面の静かな手について、通常のモデルが与える確率（静かな手の中での条件付き確率）を
+   * 教師として、軽量モデルの重みをソフトマックスの交差エントロピー最小化により求めます。
+   * 学習結果は、light_probability.binに書き出されます。
+   */
+  static void DistillLightModel();
+
   /**
    * 確率を計算するために必要なテーブルの初期化処理を行います.
    */
@@ -196,4 +240,88 @@ struct MoveProbability {
   static ProbabilityCacheTable cache_table_;
 };
 
+/**
+ * 浅い探索でも使える、軽量な実現確率のモデルです.
+ *
+ * 通常の実現確率（MoveProbability）は計算コストが高いため、残り深さが大きいところでしか使えません。
+ * このモデルは、少数の量子化された特徴と整数の重みだけを用いて、静かな手の確率を見積もります。
+ * MovePickerが生成した静かな手のリストをそのまま使うので、別途指し手生成を行う必要もありません。
+ *
+ * 点数の単位は1/16ビット（log2の16倍）で、次のように確率を求めます。
+ *   p(move) = 2^((score(move) - log_partition + quiet_bias) / 16)
+ * ここで、log_partitionは静かな手全体の点数のlog-sum-exp、quiet_biasは静かな手全体の確率の対数です。
+ */
+struct LightMoveProbability {
+  /** このモデルを適用する残り深さの下限 */
+  static constexpr Depth kAppliedDepth = 3 * kOnePly;
+
+  /** 点数の単位（1ビットあたりの点数） */
+  static constexpr int kScale = 16;
+
+  /** 特徴のグループの数（１つの指し手から抽出される特徴の数） */
+  static constexpr int kNumFeatureGroups = 6;
+
+  /** 特徴の総数 */
+  static constexpr int kNumFeatures = 77;
+
+  typedef Array<uint8_t, kNumFeatureGroups> Features;
+
+  /**
+   * 指し手の特徴を抽出します.
+   * @param move          特徴を抽出する指し手（静かな手）
+   * @param history_score 指し手のヒストリー値（MovePickerが静かな手に付けた点数）
+   * @param pos           現局面
+   */
+  static Features ExtractFeatures(Move move, int history_score,
+                                  const Position& pos);
+
+  /**
+   * 指し手の点数を計算します.
+   */
+  static int ComputeScore(Move move, int history_score, const Position& pos) {
+    int score = 0;
+    for (uint8_t index : ExtractFeatures(move, history_score, pos)) {
+      score += weights_[index];
+    }
+    return score;
+  }
+
+  /**
+   * 静かな手全体の点数について、log-sum-expを計算します.
+   * @param begin 静かな手のリストの先頭（scoreには、ヒストリー値が入っていることを前提とします）
+   * @param end   静かな手のリストの末尾
+   */
+  static int ComputeLogPartition(const ExtMove* begin, const ExtMove* end,
+                                 const Position& pos);
+
+  /**
+   * 指し手の確率を計算します.
+   * 指し手の点数は、ComputeLogPartition()で計算したものを保存せずに、ここで計算し直します。
+   * （ExtMoveに点数を保存すると、すべての指し手リストが8バイトから12バイトに広がり、
+   *   深さ15までの探索時間が、このモデルを使う場合で約3%、使わない場合でも1〜3%遅くなったため。）
+   * @param log_partition ComputeLogPartition()で求めた値
+   */
+  static double ComputeProbability(Move move, int history_score,
+                                   const Position& pos, int log_partition);
+
+  /**
+   * 重みが読み込まれており、このモデルが利用可能であれば、trueを返します.
+   */
+  static bool enabled() {
+    return enabled_;
+  }
+
+  /**
+   * light_probability.binから重みを読み込みます.
+   * ファイルが存在しない場合は、このモデルは無効になります（探索では、従来通りLMRが用いられます）。
+   */
+  static void Init();
+
+ private:
+  friend struct MoveProbability;
+  static Array<int16_t, kNumFeatures> weights_;
+  static int quiet_bias_;
+  static bool enabled_;
+};
+
 #endif /* MOVE_PROBABILITY_H_ */
@@ -102,6 +102,9 @@ MovePicker::MovePicker(const Position& pos, const HistoryStats& history,
     stage_ = kEvasion;
   } else {
     stage_ = kMainSearch;
+    // 浅い探索では、利用可能であれば、軽量な実現確率のモデルを用いる
+    use_light_probability_ =  LightMoveProbability::enabled()
+                           && depth >= LightMoveProbability::kAppliedDepth;
   }
 
   // ハッシュ手をセットする
@@ -217,13 +220,18 @@ Move MovePicker::NextMove(double* const probability) {
             && move != hash_move_
             && pos_.MoveIsPseudoLegal(move)
             && move.is_quiet()) {
+          // キラー手等の確率は求めていないので、0を返す（探索ではLMRが用いられる）
+          if (probability != nullptr) {
+            *probability = 0.0;
+          }
           return move;
         }
         break;
 
       case kGoodQuiets1:
-      case kQuiets1:
-        move = (cur_++)->move;
+      case kQuiets1: {
+        const ExtMove* em = cur_++;
+        move = em->move;
         if (   move != hash_move_
             && move != killers_[0].move
             && move != killers_[1].move
@@ -231,9 +239,16 @@ Move MovePicker::NextMove(double* const probability) {
             && move != killers_[3].move
             && move != killers_[4].move
             && move != killers_[5].move) {
+          if (probability != nullptr) {
+            *probability = use_light_probability_
+                         ? LightMoveProbability::ComputeProbability(
+                               move, em->score, pos_, light_log_partition_)
+                         : 0.0;
+          }
           return move;
         }
         break;
+      }
 
       case kBadCaptures1:
         return (cur_--)->move;
@@ -384,6 +399,9 @@ void MovePicker::GenerateNext() {
       cur_ = moves_.begin();
       end_ = end_quiets_ = GenerateMoves<kQuiets>(pos_, cur_);
       ScoreMoves<kQuiets>();
+      if (use_light_probability_) {
+        light_log_partition_ = LightMoveProbability::ComputeLogPartition(cur_, end_, pos_);
+      }
       end_ = std::partition(cur_, end_, has_good_score);
       SortMoves(cur_, end_);
       return;
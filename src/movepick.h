@@ -88,6 +88,8 @@ class MovePicker {
   int stage_;
   Score capture_threshold_;
   Depth depth_;
+  bool use_light_probability_ = false;
+  int light_log_partition_ = 0;
   Move hash_move_ = kMoveNone;
   const Array<Move, 2> killermoves_;
   const Array<Move, 2> countermoves_;
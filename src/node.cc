@@ -46,6 +46,20 @@ void Node::Initialize() {
   assert((current-2)->continuous_checks == 0);
 }
 
+void Node::Reset(const Position& pos) {
+  Position::operator=(pos);
+  stack_.assign(3, Stack()); // (stack_.back() - 2)を参照可能にする
+  psq_list_ = PsqList(pos);
+  Initialize();
+}
+
+void Node::RecomputeEvaluation() {
+  auto current = stack_.end() - 1;
+  current->psq_control_list = extended_board().GetPsqControlList();
+  current->eval_detail = Evaluation::EvaluateAll(*this, psq_list_);
+  current->eval_is_updated = true;
+}
+
 bool Node::DetectRepetition(Score* score) const {
   assert(score != nullptr);
   assert(stack_.size() >= 3); // (stack_.end()-3)を参照するため
@@ -56,6 +56,13 @@ class Node : public Position {
     Initialize();
   }
 
+  /**
+   * 別の局面を用いて初期化し直します.
+   * 新たにNodeを作る場合と異なり、確保済みのメモリを再利用します。
+   * @param pos 初期化に用いる局面
+   */
+  void Reset(const Position& pos);
+
   /**
    * 千日手の検出を行います.
    *
@@ -116,6 +123,12 @@ class Node : public Position {
    */
   Score Evaluate(double* progress = nullptr);
 
+  /**
+   * 現局面の評価値を、差分計算を用いずに計算し直します.
+   * 探索を行うスレッドで使用する評価関数のパラメータを切り替えた後に呼んでください。
+   */
+  void RecomputeEvaluation();
+
   /**
    * 指定された指し手を用いて局面を１手先に進めます（簡易版）.
    * move_gives_check及びkey_after_moveを引数として渡す関数と比較して、若干実行速度が落ちます。
@@ -0,0 +1,190 @@
+/*
+ * 技巧 (Gikou), a USI shogi (Japanese chess) playing engine.
+ * Copyright (C) 2016-2017 Yosuke Demura
+ * except where otherwise indicated.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "numa.h"
+
+#if defined(__linux__)
+#  include <sched.h>
+#endif
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "evaluation.h"
+#include "move_probability.h"
+
+namespace {
+
+/**
+ * ノードごとの、CPU番号の一覧です（取得できなかった場合は、空のリストを１つだけ持ちます）.
+ */
+typedef std::vector<std::vector<int>> NodeCpus;
+
+bool g_bind_threads = false;
+int g_num_replicas = 0;
+
+/** 一度でもスレッドをノードに固定した場合は、true（固定を解除する必要があるかを判定するために使う） */
+std::atomic_bool g_any_thread_bound{false};
+
+#if defined(__linux__)
+
+/**
+ * "0-3,8-11"のような、sysfsのCPUリスト形式の文字列を読み取ります.
+ */
+std::vector<int> ParseCpuList(const char* str) {
+  std::vector<int> cpus;
+  const char* p = str;
+  while (*p >= '0' && *p <= '9') {
+    char* end;
+    int first = static_cast<int>(std::strtol(p, &end, 10));
+    int last = first;
+    if (*end == '-') {
+      last = static_cast<int>(std::strtol(end + 1, &end, 10));
+    }
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+    p = (*end == ',') ? end + 1 : end;
+  }
+  return cpus;
+}
+
+/**
+ * ファイルの１行目を読み、CPUリスト形式として解釈します.
+ */
+std::vector<int> ReadListFile(const char* path) {
+  std::FILE* fp = std::fopen(path, "r");
+  if (fp == nullptr) {
+    return std::vector<int>();
+  }
+  char line[4096] = "";
+  if (std::fgets(line, sizeof(line), fp) == nullptr) {
+    line[0] = '\0';
+  }
+  std::fclose(fp);
+  return ParseCpuList(line);
+}
+
+NodeCpus ReadTopology() {
+  // 起動時のCPUアフィニティ（tasksetなどで制限されている場合）の範囲内に限定する
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  const bool has_affinity = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+  NodeCpus node_cpus;
+  for (int node : ReadListFile("/sys/devices/system/node/online")) {
+    char path[128];
+    std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    std::vector<int> cpus;
+    for (int cpu : ReadListFile(path)) {
+      if (cpu < CPU_SETSIZE && (!has_affinity || CPU_ISSET(cpu, &allowed))) {
+        cpus.push_back(cpu);
+      }
+    }
+    // メモリのみのノードなど、使えるCPUを持たないノードは除外する
+    if (!cpus.empty()) {
+      node_cpus.push_back(cpus);
+    }
+  }
+  if (node_cpus.empty()) {
+    node_cpus.resize(1);
+  }
+  return node_cpus;
+}
+
+#else
+
+NodeCpus ReadTopology() {
+  return NodeCpus(1);
+}
+
+#endif // defined(__linux__)
+
+const NodeCpus& node_cpus() {
+  static const NodeCpus cpus = ReadTopology();
+  return cpus;
+}
+
+} // namespace
+
+int Numa::num_nodes() {
+  return static_cast<int>(node_cpus().size());
+}
+
+bool Numa::BindCurrentThread(const int node) {
+#if defined(__linux__)
+  const NodeCpus& nodes = node_cpus();
+  if (node >= static_cast<int>(nodes.size())) {
+    return false;
+  }
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    if (node < 0 || static_cast<int>(i) == node) {
+      for (int cpu : nodes[i]) {
+        CPU_SET(cpu, &cpu_set);
+      }
+    }
+  }
+  if (CPU_COUNT(&cpu_set) == 0) {
+    return false;
+  }
+  if (node >= 0) {
+    g_any_thread_bound = true;
+  }
+  return sched_setaffinity(0, sizeof(cpu_set), &cpu_set) == 0;
+#else
+  (void)node;
+  return false;
+#endif
+}
+
+void Numa::RunOnNode(const int node, const std::function<void()>& task) {
+  std::thread thread([&]() {
+    BindCurrentThread(node);
+    task();
+  });
+  thread.join();
+}
+
+void Numa::Configure(const bool bind_threads, const bool replicate_tables) {
+  g_bind_threads = bind_threads;
+  g_num_replicas = (bind_threads && replicate_tables) ? num_nodes() : 0;
+  Evaluation::ReplicateParameters(g_num_replicas);
+  MoveProbability::ReplicateWeights(g_num_replicas);
+}
+
+int Numa::num_replicas() {
+  return g_num_replicas;
+}
+
+int Numa::SetUpSearchThread(const size_t thread_id) {
+  const int node = g_bind_threads ? GetNodeOfThread(thread_id) : -1;
+
+  // ワーカースレッドは、生成元のスレッドのCPUアフィニティを引き継ぐので、固定しない場合も明示的に解除する
+  if (node >= 0 || g_any_thread_bound) {
+    BindCurrentThread(node);
+  }
+
+  const int replica = node < g_num_replicas ? node : -1;
+  Evaluation::SetThreadParameters(Evaluation::GetReplica(replica));
+  MoveProbability::SetThreadWeights(replica);
+  return node;
+}
@@ -0,0 +1,87 @@
+/*
+ * 技巧 (Gikou), a USI shogi (Japanese chess) playing engine.
+ * Copyright (C) 2016-2017 Yosuke Demura
+ * except where otherwise indicated.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUMA_H_
+#define NUMA_H_
+
+#include <cstddef>
+#include <functional>
+
+/**
+ * NUMA（Non-Uniform Memory Access）環境で、探索スレッドと読み込み専用テーブルの配置を管理するためのクラスです.
+ *
+ * 複数ソケットのマシンでは、評価パラメータや実現確率の重みのように、全探索スレッドから頻繁に読み出される
+ * テーブルが１つのノードにしか置かれていないと、他のノードのスレッドは、ソケット間の接続を経由して読み出すことになります。
+ * そこで、USIオプションの"NumaReplication"が有効な場合には、isreadyの時点でこれらのテーブルをノードごとに複製し、
+ * 各探索スレッドを１つのノードに固定したうえで、そのノード上の複製を参照させます。
+ *
+ * 複製は、そのノードに固定した一時スレッド上で確保・コピーするので、Linuxのファーストタッチ方式により、
+ * ノードのローカルメモリに配置されます。
+ * ノード構成の取得とスレッドの固定は、現在のところLinuxのみに対応しています（他のOSでは、ノード数を１として扱います）。
+ */
+class Numa {
+ public:
+  /**
+   * CPUを持つNUMAノードの数を返します（ノード構成が取得できない場合は、1）.
+   */
+  static int num_nodes();
+
+  /**
+   * 探索スレッドを割り当てるノードを返します（スレッドIDの順に、各ノードへ均等に割り当てます）.
+   */
+  static int GetNodeOfThread(size_t thread_id) {
+    return static_cast<int>(thread_id % num_nodes());
+  }
+
+  /**
+   * 呼び出したスレッドを、指定されたノードのCPUに固定します.
+   * @param node ノードの番号（負の場合は、固定を解除して、全ノードのCPUで実行できるようにします）
+   * @return 固定に成功した場合は、true
+   */
+  static bool BindCurrentThread(int node);
+
+  /**
+   * 指定されたノードに固定した一時スレッド上で、処理を実行し、その終了を待ちます.
+   * ノードのローカルメモリにテーブルを確保・初期化するために使用します。
+   */
+  static void RunOnNode(int node, const std::function<void()>& task);
+
+  /**
+   * 探索スレッドの固定と、テーブルの複製についての設定を行います.
+   * 複製を有効にした場合は、その時点の評価パラメータと実現確率の重みを、ノードの数だけ複製します。
+   * 複製後に元のテーブルを変更しても、複製には反映されないので、テーブルの読み込み後に呼んでください。
+   * @param bind_threads     探索スレッドをノードに固定する場合は、true
+   * @param replicate_tables テーブルをノードごとに複製する場合は、true（bind_threadsがtrueの場合のみ有効）
+   */
+  static void Configure(bool bind_threads, bool replicate_tables);
+
+  /**
+   * テーブルの複製の数を返します（複製が無効な場合は、0）.
+   */
+  static int num_replicas();
+
+  /**
+   * 探索の開始時に、探索スレッドから呼び出します.
+   * 設定に応じて、呼び出したスレッドをノードに固定し、そのノード上の複製を参照するようにします。
+   * @return 固定したノードの番号（固定しない場合は、-1）
+   */
+  static int SetUpSearchThread(size_t thread_id);
+};
+
+#endif /* NUMA_H_ */
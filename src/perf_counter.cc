@@ -0,0 +1,234 @@
+/*
+ * 技巧 (Gikou), a USI shogi (Japanese chess) playing engine.
+ * Copyright (C) 2016-2017 Yosuke Demura
+ * except where otherwise indicated.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "perf_counter.h"
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#if defined(__linux__)
+# include <linux/perf_event.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#endif
+
+namespace {
+
+struct Record {
+  std::string phase;
+  PerfCounter::Values values;
+  uint64_t num_operations;
+};
+
+std::atomic_bool g_enabled{false};
+std::atomic_int g_last_error{0};
+std::mutex g_records_mutex;
+std::vector<Record> g_records;
+
+const char* const kEventNames[PerfCounter::kNumEvents] = {
+    "cycles", "instructions", "L1d-misses", "LLC-misses", "dTLB-misses",
+    "branch-misses",
+};
+
+#if defined(__linux__)
+
+/**
+ * perf_event_open()に渡す、イベントの種類と設定値です.
+ */
+const struct {
+  uint32_t type;
+  uint64_t config;
+} kEventConfigs[PerfCounter::kNumEvents] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+                       | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                       | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL
+                       | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                       | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB
+                       | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                       | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+int OpenEvent(PerfCounter::Event event) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = kEventConfigs[event].type;
+  attr.config = kEventConfigs[event].config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  // カウンタの数が足りずに多重化された場合に備えて、有効時間と実行時間も読み込む
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  // pid=0, cpu=-1 で、呼び出し元のスレッドのみを計測する
+  int fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+  if (fd < 0) {
+    g_last_error = errno;
+  }
+  return fd;
+}
+
+#endif // defined(__linux__)
+
+} // namespace
+
+PerfCounter::Values& PerfCounter::Values::operator+=(const Values& rhs) {
+  for (int i = 0; i < kNumEvents; ++i) {
+    counts[i] += rhs.counts[i];
+    available[i] = available[i] || rhs.available[i];
+  }
+  return *this;
+}
+
+PerfCounter::PerfCounter() {
+  for (int i = 0; i < kNumEvents; ++i) {
+#if defined(__linux__)
+    file_descriptors_[i] = OpenEvent(static_cast<Event>(i));
+#else
+    file_descriptors_[i] = -1;
+    g_last_error = ENOSYS;
+#endif
+  }
+}
+
+PerfCounter::~PerfCounter() {
+#if defined(__linux__)
+  for (int fd : file_descriptors_) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+#endif
+}
+
+bool PerfCounter::is_available() const {
+  for (int fd : file_descriptors_) {
+    if (fd >= 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void PerfCounter::Start() {
+#if defined(__linux__)
+  for (int fd : file_descriptors_) {
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+#endif
+}
+
+void PerfCounter::Stop() {
+  values_ = Values();
+#if defined(__linux__)
+  for (int i = 0; i < kNumEvents; ++i) {
+    const int fd = file_descriptors_[i];
+    if (fd < 0) {
+      continue;
+    }
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+
+    // [0]: カウンタの値, [1]: 有効だった時間, [2]: 実際に計測していた時間
+    uint64_t data[3] = {0, 0, 0};
+    if (read(fd, data, sizeof(data)) != static_cast<ssize_t>(sizeof(data))
+        || data[2] == 0) {
+      continue;
+    }
+
+    // 多重化されていた場合は、有効だった時間全体に換算する
+    double scale = static_cast<double>(data[1]) / static_cast<double>(data[2]);
+    values_.counts[i] = static_cast<uint64_t>(static_cast<double>(data[0]) * scale);
+    values_.available[i] = true;
+  }
+#endif
+}
+
+void PerfCounter::Print(const Values& values, uint64_t num_operations) {
+  bool any_available = false;
+  for (int i = 0; i < kNumEvents; ++i) {
+    any_available = any_available || values.available[i];
+  }
+  if (!any_available) {
+    std::printf("PerfCounters: n/a (%s)\n", std::strerror(g_last_error));
+    return;
+  }
+
+  const double ops = static_cast<double>(std::max(num_operations, UINT64_C(1)));
+  std::printf("PerfCounters:");
+  for (int i = 0; i < kNumEvents; ++i) {
+    if (values.available[i]) {
+      std::printf(" %s=%" PRIu64 "(%.2f/op)", kEventNames[i], values.counts[i],
+                  values.counts[i] / ops);
+    } else {
+      std::printf(" %s=n/a", kEventNames[i]);
+    }
+  }
+  if (   values.available[kCycles] && values.available[kInstructions]
+      && values.counts[kCycles] > 0) {
+    std::printf(" IPC=%.2f", double(values.counts[kInstructions])
+                             / double(values.counts[kCycles]));
+  }
+  std::printf("\n");
+}
+
+void PerfCounter::Record(const std::string& phase, const Values& values,
+                         uint64_t num_operations) {
+  std::lock_guard<std::mutex> lock(g_records_mutex);
+  g_records.push_back(::Record{phase, values, num_operations});
+}
+
+void PerfCounter::PrintRecords() {
+  std::lock_guard<std::mutex> lock(g_records_mutex);
+  Values total;
+  uint64_t total_operations = 0;
+  for (const ::Record& record : g_records) {
+    std::printf("[%s] ops=%" PRIu64 " ", record.phase.c_str(),
+                record.num_operations);
+    Print(record.values, record.num_operations);
+    total += record.values;
+    total_operations += record.num_operations;
+  }
+  if (g_records.size() >= 2) {
+    std::printf("[total] ops=%" PRIu64 " ", total_operations);
+    Print(total, total_operations);
+  }
+  g_records.clear();
+}
+
+void PerfCounter::set_enabled(bool enabled) {
+  g_enabled = enabled;
+}
+
+bool PerfCounter::enabled() {
+  return g_enabled;
+}
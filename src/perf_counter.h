@@ -0,0 +1,133 @@
+/*
+ * 技巧 (Gikou), a USI shogi (Japanese chess) playing engine.
+ * Copyright (C) 2016-2017 Yosuke Demura
+ * except where otherwise indicated.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PERF_COUNTER_H_
+#define PERF_COUNTER_H_
+
+#include <cstdint>
+#include <string>
+#include "common/array.h"
+
+/**
+ * ハードウェア・パフォーマンス・カウンタを用いて、ベンチマークの計測を行うためのクラスです.
+ *
+ * Linuxのperf_event_open()システムコールを用いて、このクラスを作成したスレッドで発生した
+ * サイクル数・命令数・キャッシュミス数などを計測します。
+ * コンテナ内で実行している場合などで、カウンタを利用できない場合は、そのイベントは「n/a」と表示され、
+ * ベンチマーク自体はそのまま実行されます。
+ *
+ * 使用例：
+ * @code
+ * PerfCounter::set_enabled(true);
+ * PerfCounter counter;
+ * counter.Start();
+ * // 計測したい処理....
+ * counter.Stop();
+ * PerfCounter::Record("movegen", counter.values(), num_calls);
+ * PerfCounter::PrintRecords();
+ * @endcode
+ */
+class PerfCounter {
+ public:
+  /**
+   * 計測するイベントの種類です.
+   */
+  enum Event {
+    kCycles, kInstructions, kL1dMisses, kLlcMisses, kDtlbMisses, kBranchMisses,
+    kNumEvents
+  };
+
+  /**
+   * 計測結果です.
+   * カウンタを利用できなかったイベントについては、available[event]がfalseになります。
+   */
+  struct Values {
+    Values() {
+      counts.clear();
+      available.clear();
+    }
+    Values& operator+=(const Values& rhs);
+    Array<uint64_t, kNumEvents> counts;
+    Array<bool, kNumEvents> available;
+  };
+
+  /**
+   * 呼び出し元のスレッドについて、カウンタを準備します（計測はまだ開始しません）.
+   */
+  PerfCounter();
+
+  ~PerfCounter();
+
+  PerfCounter(const PerfCounter&) = delete;
+  PerfCounter& operator=(const PerfCounter&) = delete;
+
+  /**
+   * カウンタをリセットして、計測を開始します.
+   */
+  void Start();
+
+  /**
+   * 計測を停止して、カウンタの値を読み込みます.
+   */
+  void Stop();
+
+  /**
+   * Stop()で読み込んだ計測結果を返します.
+   */
+  const Values& values() const {
+    return values_;
+  }
+
+  /**
+   * 少なくとも１つのイベントを計測できる場合は、trueを返します.
+   */
+  bool is_available() const;
+
+  /**
+   * 計測結果を１行で表示します.
+   * @param values         計測結果
+   * @param num_operations 処理の回数（探索ノード数、関数の呼び出し回数など）。1回あたりの値を表示するのに使う。
+   */
+  static void Print(const Values& values, uint64_t num_operations);
+
+  /**
+   * 計測結果を、フェーズ名とともに記録します（スレッドセーフ）.
+   * 探索のように、複数のスレッドで計測を行う場合に利用します。
+   */
+  static void Record(const std::string& phase, const Values& values,
+                     uint64_t num_operations);
+
+  /**
+   * Record()で記録された計測結果を、記録された順に表示したうえで、記録を消去します.
+   */
+  static void PrintRecords();
+
+  /**
+   * 探索中の計測を有効にするか否かを設定します（ベンチマークコマンド用）.
+   */
+  static void set_enabled(bool enabled);
+
+  static bool enabled();
+
+ private:
+  Array<int, kNumEvents> file_descriptors_;
+  Values values_;
+};
+
+#endif /* PERF_COUNTER_H_ */
@@ -283,6 +283,61 @@ bool Position::MoveIsLegal(Move move) const {
     return on_line.test(move.to());
   }
 }
+bool Position::PawnDropIsMate(const Square to) const {
+  const Color stm = side_to_move_;
+  const Square ksq = king_square(~stm);
+  const ExtendedBoard& eb = extended_board();
+  assert(is_empty(to));
+  assert(step_attacks_bb(Piece(~stm, kPawn), ksq).test(to));
+
+  // 1. 打った歩に攻め方の利きがなければ、玉で歩を取ることができる
+  if (eb.num_controls(stm, to) == 0) {
+    return false;
+  }
+
+  // 2. 玉の逃げ道があれば、詰みではない
+  // 歩を打つ前の局面では、攻め方の飛び駒は受け方の玉に利いていないので、玉が移動しても利きは変化しない。
+  // ただし、打った歩が攻め方の飛び駒の利きを遮ることがあるので、利き数が１のマスは個別に確認する。
+  const Bitboard escape_bb = neighborhood8_bb(ksq).andnot(pieces(~stm) | square_bb(to));
+  const DirectionSet escapes = escape_bb.neighborhood8(ksq);
+  const EightNeighborhoods controls = eb.GetEightNeighborhoodControls(stm, ksq);
+  if ((escapes & ~controls.more_than(0)).any()) {
+    return false;
+  }
+  if ((escapes & ~controls.more_than(1)).any()) {
+    const Bitboard occ = pieces() | square_bb(to);
+    bool can_escape = false;
+    escape_bb.ForEach([&](Square sq) {
+      if (eb.num_controls(stm, sq) == 1 && AttackersTo(sq, occ, stm).none()) {
+        can_escape = true;
+      }
+    });
+    if (can_escape) {
+      return false;
+    }
+  }
+
+  // 3. 玉以外の駒で歩を取ることができれば、詰みではない（打った歩には、受け方の玉の利きが必ずある）
+  if (eb.num_controls(~stm, to) >= 2) {
+    const Bitboard capturers = AttackersTo(to, pieces(), ~stm).andnot(square_bb(ksq));
+    // ピンされている駒は、ピンの方向に沿って歩を取る場合のみ、取ることができる
+    const Bitboard pinned = discovered_check_candidates() & pieces(~stm);
+    if (capturers.andnot(pinned).any()) {
+      return false;
+    }
+    bool can_capture = false;
+    (capturers & pinned).ForEach([&](Square from) {
+      if (line_bb(ksq, from).test(to)) {
+        can_capture = true;
+      }
+    });
+    if (can_capture) {
+      return false;
+    }
+  }
+
+  return true;
+}
 bool Position::MoveGivesCheck(Move move) const {
   assert(move.IsOk());
   assert(move.is_real_move());
@@ -726,6 +781,52 @@ void Position::AddOneToHand(Color c, PieceType pt) {
   assert(IsOk());
 }
 
+void Position::SetUpPieces(const ArrayMap<Piece, Square>& board,
+                           const ArrayMap<Hand, Color>& hands) {
+  assert(occupied_bb_.none());
+  assert(hand_[kBlack] == Hand() && hand_[kWhite] == Hand());
+
+  // 1. 駒ごとのビットボードを、64ビット整数２つのまま組み立てる
+  //    （Bitboardの内部表現は、0〜62番目のマスが下位64ビット、63〜80番目のマスが上位64ビット）
+  ArrayMap<uint64_t, Piece> lower, upper;
+  lower.clear();
+  upper.clear();
+  for (Square s : Square::all_squares()) {
+    Piece p = board[s];
+    if (s < 63) lower[p] |= UINT64_C(1) << s;
+    else        upper[p] |= UINT64_C(1) << (s - 63);
+  }
+
+  // 2. 手番別・駒の種類別のビットボードを作る
+  for (Color c : {kBlack, kWhite}) {
+    for (PieceType pt : Piece::all_piece_types()) {
+      Piece p(c, pt);
+      if ((lower[p] | upper[p]) == 0) continue;
+      Bitboard bb(upper[p], lower[p]);
+      color_bb_[c] |= bb;
+      type_bb_[pt] |= bb;
+      num_unused_pieces_[p.original_type()] -= bb.count();
+    }
+  }
+  occupied_bb_ = color_bb_[kBlack] | color_bb_[kWhite];
+  piece_on_ = board;
+  for (Color c : {kBlack, kWhite}) {
+    Bitboard king_bb = type_bb_[kKing] & color_bb_[c];
+    king_square_[c] = king_bb.any() ? king_bb.first_one() : kSquareNone;
+  }
+
+  // 3. 持ち駒をセットする
+  hand_ = hands;
+  for (Color c : {kBlack, kWhite}) {
+    for (PieceType pt : Piece::all_hand_types()) {
+      num_unused_pieces_[pt] -= hand_[c].count(pt);
+    }
+  }
+
+  InitStateInfo();
+  assert(IsOk());
+}
+
 bool Position::WinDeclarationIsPossible(const bool is_csa_rule) const {
   assert(king_exists(side_to_move_));
 
@@ -331,6 +331,15 @@ class Position {
    */
   bool NonDropMoveIsLegal(Move move) const;
 
+  /**
+   * 指定された擬似合法手が、打ち歩詰めの反則であれば、trueを返します.
+   * 実際に手を指して受け方の合法手を生成する代わりに、ビットボードと利き数のみを用いて判定するので、
+   * MakeMove()の前に、高速に呼び出すことができます。
+   * @param move 擬似合法手
+   * @return 打ち歩詰めであれば、true（歩を打つ手でない場合は、常にfalse）
+   */
+  bool MoveIsPawnDropMate(Move move) const;
+
   /**
    * 指定された手が王手になっている場合は、trueを返します.
    */
@@ -389,6 +398,14 @@ class Position {
    */
   void AddOneToHand(Color c, PieceType pt);
 
+  /**
+   * 盤上の駒の配置と持ち駒をまとめてセットしてから、StateInfoを初期化します.
+   * 駒を１枚ずつ PutPiece() で配置するよりも高速なので、大量の局面を復元する場合
+   * （ハフマン符号の復号化など）に使います。
+   * 前提条件: 盤上にも持ち駒にも、駒が１枚も置かれていないこと
+   */
+  void SetUpPieces(const ArrayMap<Piece, Square>& board, const ArrayMap<Hand, Color>& hands);
+
   /**
    * 現局面において、宣言勝ちができる場合は、trueを返します.
    * @param is_csa_rule trueであればCSAルールを、falseであれば24点法を適用する
@@ -474,6 +491,9 @@ class Position {
     ExtendedBoard extended_board;
   };
 
+  // MoveIsPawnDropMate() の内部実装です（toは、相手玉の正面のマス）
+  bool PawnDropIsMate(Square to) const;
+
   // ComputePinnedPieces() / ComputeDiscoveredCheckCandidates() の内部実装です
   Bitboard ComputeObstructingPieces(Color king_color) const;
 
@@ -688,7 +708,19 @@ inline bool Position::PseudoLegalMoveIsLegal(Move move) const {
   assert(move.IsOk());
   assert(move.is_real_move());
   assert(MoveIsPseudoLegal(move));
-  return move.is_drop() || NonDropMoveIsLegal(move);
+  return move.is_drop() ? !MoveIsPawnDropMate(move) : NonDropMoveIsLegal(move);
+}
+
+inline bool Position::MoveIsPawnDropMate(Move move) const {
+  if (!move.is_pawn_drop() || !king_exists(~side_to_move_)) {
+    return false;
+  }
+  // 歩で王手をかけられるのは、相手玉の正面のマスに打った場合のみ
+  const Square ksq = king_square(~side_to_move_);
+  if (!step_attacks_bb(Piece(~side_to_move_, kPawn), ksq).test(move.to())) {
+    return false;
+  }
+  return PawnDropIsMate(move.to());
 }
 
 inline void Position::UnmakeNullMove() {
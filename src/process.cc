@@ -19,20 +19,99 @@
 
 #if !defined(MINIMUM)
 
+#include "process.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
 #include <signal.h>
 #include <sys/wait.h>
+#include <algorithm>
+#include <chrono>
+
+Process::ReadStatus Process::GetLine(std::string* const line,
+                                     const int timeout_milliseconds) {
+  assert(line != nullptr);
+
+  const auto deadline = std::chrono::steady_clock::now()
+                      + std::chrono::milliseconds(std::max(timeout_milliseconds, 0));
+  size_t scan_from = read_begin_;
+
+  while (true) {
+    // 1. まだ調べていない受信データの中から、改行を探す
+    const char* newline = static_cast<const char*>(
+        std::memchr(read_buffer_.data() + scan_from, '\n', read_end_ - scan_from));
+    if (newline != nullptr) {
+      const char* begin = read_buffer_.data() + read_begin_;
+      line->assign(begin, newline - begin); // lineの領域は使い回される
+      read_begin_ = (newline - read_buffer_.data()) + 1;
+      return kLineRead;
+    }
+    scan_from = read_end_;
+
+    // 2. 読み込み済みの部分を詰めて、次のread(2)のための空きを作る
+    if (read_begin_ > 0) {
+      std::memmove(read_buffer_.data(), read_buffer_.data() + read_begin_,
+                   read_end_ - read_begin_);
+      read_end_ -= read_begin_;
+      scan_from -= read_begin_;
+      read_begin_ = 0;
+    }
+    if (read_buffer_.size() - read_end_ < kReadChunkSize) {
+      read_buffer_.resize(read_end_ + kReadChunkSize);
+    }
 
-#include "process.h"
+    // 3. 時間制限がある場合は、データが届くまで待つ
+    if (timeout_milliseconds >= 0) {
+      auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - std::chrono::steady_clock::now());
+      pollfd poll_fd = {fd_from_child_, POLLIN, 0};
+      int result = poll(&poll_fd, 1, std::max(static_cast<int>(remaining.count()), 0));
+      if (result < 0 && errno == EINTR) {
+        continue;
+      } else if (result == 0) {
+        return kTimedOut;
+      }
+    }
 
-bool Process::GetLine(std::string* const line) {
-  line->clear();
-  for (char c; (c = std::fgetc(stream_from_child_)) != EOF;) {
-    // 改行コードが来たら終了する
-    if (c == '\n') return true;
-    // 末尾に一文字ずつ付け足していく
-    line->push_back(c);
+    // 4. まとめて読み込む
+    ssize_t num_bytes = read(fd_from_child_, read_buffer_.data() + read_end_,
+                             read_buffer_.size() - read_end_);
+    if (num_bytes < 0 && errno == EINTR) {
+      continue;
+    } else if (num_bytes <= 0) {
+      // EOFに達したら、改行のない最後の行を返す
+      line->assign(read_buffer_.data() + read_begin_, read_end_ - read_begin_);
+      read_begin_ = read_end_ = 0;
+      return kEndOfFile;
+    }
+    read_end_ += num_bytes;
+  }
+}
+
+void Process::Write(const char* const data, const size_t size) {
+  write_buffer_.append(data, size);
+  if (!write_buffer_.empty() && write_buffer_.back() == '\n') {
+    Flush();
+  }
+}
+
+void Process::Flush() {
+  size_t offset = 0;
+  while (offset < write_buffer_.size()) {
+    ssize_t num_bytes = write(fd_to_child_, write_buffer_.data() + offset,
+                              write_buffer_.size() - offset);
+    if (num_bytes < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::perror("write() failed.\n");
+      break;
+    }
+    offset += num_bytes;
   }
-  return false;
+  write_buffer_.clear(); // 確保した領域は使い回される
 }
 
 int Process::StartProcess(const char* const file, char* const argv[]) {
@@ -95,14 +174,15 @@ int Process::StartProcess(const char* const file, char* const argv[]) {
   // プロセスIDを記憶させる
   process_id_ = process_id;
 
-  // パイプをファイルストリームとして開く
-  stream_to_child_ = fdopen(pipe_to_child[kWrite], "w");
-  stream_from_child_ = fdopen(pipe_from_child[kRead], "r");
+  // 子->親のパイプの書き込み側を閉じる（閉じておかないと、子プロセスが終了してもEOFが届かない）
+  close(pipe_from_child[kWrite]);
 
-  // バッファリングをオフにする
-  // 注意：バッファリングをオフにしないと、外部プロセスとの通信が即時に行われない場合がある
-  std::setvbuf(stream_to_child_, NULL, _IONBF, 0);
-  std::setvbuf(stream_from_child_, NULL, _IONBF, 0);
+  // パイプのファイルディスクリプタを記憶させる
+  // （入出力は、GetLine()とFlush()でまとめて行うので、ファイルストリームは使わない）
+  fd_to_child_ = pipe_to_child[kWrite];
+  fd_from_child_ = pipe_from_child[kRead];
+  read_begin_ = read_end_ = 0;
+  write_buffer_.clear();
 
   return process_id;
 }
@@ -24,14 +24,31 @@
 
 #include <cstdio>
 #include <string>
+#include <vector>
 #include <unistd.h>
 
 /**
  * プロセス間通信を行うためのクラスです.
  * unistd.hヘッダを利用しているため、原則としてUNIX系OSでのみ使用可能です。
+ *
+ * 外部プロセスとの入出力は、１文字ずつではなく、read(2)/write(2)でまとめて行います。
+ *   - 受信：大きめのバッファに読み込んでから、バッファ内で改行を探して１行ずつ取り出す
+ *   - 送信：バッファに書き溜めておき、改行で終わった時点で（１行単位で）まとめて送る
  */
 class Process {
  public:
+  /**
+   * GetLine()の結果です.
+   */
+  enum ReadStatus {
+    kLineRead,  /**< １行読み込んだ */
+    kTimedOut,  /**< 指定時間内に１行分のデータが届かなかった */
+    kEndOfFile, /**< EOFに達した（改行のない最後の行があれば、それを返す） */
+  };
+
+  /** 一度のread(2)で読み込む最小のバイト数 */
+  static constexpr size_t kReadChunkSize = 64 * 1024;
+
   /**
    * 外部プロセスを起動します.
    * @param file 外部プロセスのファイル名
@@ -45,23 +62,51 @@ class Process {
    * @param line 外部プロセスの標準出力から読み込んだ行
    * @return EOFまで読み込んだときは、false。まだ残りの行があるときは、true。
    */
-  bool GetLine(std::string* line);
+  bool GetLine(std::string* line) {
+    return GetLine(line, -1) == kLineRead;
+  }
+
+  /**
+   * 外部プロセスの標準出力から、時間制限つきで１行読み込みます.
+   * タイムアウトした場合は、lineは変更されず、途中まで届いた行はバッファに残されて、
+   * 次回の呼び出しで続きから読み込まれます。
+   * @param line 外部プロセスの標準出力から読み込んだ行
+   * @param timeout_milliseconds 最大待ち時間（負の値なら無制限に待つ、0ならブロックしない）
+   */
+  ReadStatus GetLine(std::string* line, int timeout_milliseconds);
 
   /**
    * 外部プロセスの標準入力に対し、フォーマット指定して書き込みます.
+   * 書き込んだ内容が改行で終わっている場合は、そこまでを外部プロセスに送信します。
    */
   template<typename... Args>
   void Printf(const char* format, const Args&... args) {
-    std::fprintf(stream_to_child_, format, args...);
+    char buffer[1024];
+    int length = std::snprintf(buffer, sizeof(buffer), format, args...);
+    if (length < 0) {
+      return;
+    } else if (static_cast<size_t>(length) < sizeof(buffer)) {
+      Write(buffer, length);
+    } else {
+      // 長い行（position コマンドなど）は、必要な大きさを確保してから書き込む
+      std::string large_buffer(length + 1, '\0');
+      std::snprintf(&large_buffer[0], large_buffer.size(), format, args...);
+      Write(large_buffer.data(), length);
+    }
   }
 
   /**
    * 外部プロセスの標準入力に対し、１行書き込みます.
    */
   void PrintLine(const char* str) {
-    std::fprintf(stream_to_child_, "%s\n", str);
+    Printf("%s\n", str);
   }
 
+  /**
+   * 送信用バッファに溜まっているデータを、外部プロセスに送信します.
+   */
+  void Flush();
+
   /**
    * 外部プロセスが終了するまで待機します.
    * @return 正常終了した場合は0を、異常終了した場合は-1を返します。
@@ -76,14 +121,27 @@ class Process {
   }
 
  private:
+  /**
+   * 送信用バッファにデータを追加します（改行で終わっていれば、送信まで行います）.
+   */
+  void Write(const char* data, size_t size);
+
   /** 外部プロセスのプロセスID */
   pid_t process_id_;
 
-  /** 外部プロセスの標準入力につながれたストリーム（外部プロセスへの送信用） */
-  std::FILE* stream_to_child_;
+  /** 外部プロセスの標準入力につながれたファイルディスクリプタ（外部プロセスへの送信用） */
+  int fd_to_child_ = -1;
+
+  /** 外部プロセスの標準出力につながれたファイルディスクリプタ（外部プロセスからの受信用） */
+  int fd_from_child_ = -1;
+
+  /** 受信用バッファ（[read_begin_, read_end_)が、まだ行として取り出していないデータ） */
+  std::vector<char> read_buffer_;
+  size_t read_begin_ = 0;
+  size_t read_end_ = 0;
 
-  /** 外部プロセスの標準出力につながれたストリーム（外部プロセスからの受信用） */
-  std::FILE* stream_from_child_;
+  /** 送信用バッファ */
+  std::string write_buffer_;
 };
 
 #endif /* !defined(MINIMUM) */
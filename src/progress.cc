@@ -24,9 +24,12 @@
 #include <omp.h>
 #include "common/math.h"
 #include "gamedb.h"
+#include "large_page.h"
 #include "position.h"
 
-ArrayMap<int32_t, Square, PsqIndex> Progress::weights;
+ArrayMap<int32_t, Square, PsqIndex>& Progress::weights =
+    *MakeRequiredLargePageObject<ArrayMap<int32_t, Square, PsqIndex>>("Progress::weights")
+        .release();
 
 void Progress::ReadWeightsFromFile() {
   FILE* fp = std::fopen("progress.bin", "rb");
@@ -62,7 +62,7 @@ class Progress {
   /**
    * 進行度を推定するために使用される、重みベクトルです.
    */
-  static ArrayMap<int32_t, Square, PsqIndex> weights;
+  static ArrayMap<int32_t, Square, PsqIndex>& weights;
 };
 
 #endif /* PROGRESS_H_ */
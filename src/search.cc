@@ -27,18 +27,24 @@
 
 #include <cinttypes>
 #include <cmath>
+#include <memory>
+#include "book.h"
 #include "evaluation.h"
 #include "mate1ply.h"
 #include "mate3.h"
 #include "material.h"
+#include "memory_report.h"
 #include "move_probability.h"
 #include "movegen.h"
 #include "movepick.h"
+#include "numa.h"
+#include "perf_counter.h"
 #include "position.h"
 #include "synced_printf.h"
 #include "swap.h"
 #include "thread.h"
 #include "time_manager.h"
+#include "tracer.h"
 #include "usi.h"
 #include "zobrist.h"
 
@@ -53,6 +59,9 @@ Array<uint64_t, 64> g_cuts_by_move;
 
 Array<int16_t, 2, 2, 64, 64> g_reductions; // [pv][improving][depth][moveNumber]
 
+// 探索中に定跡DBを参照する、ルートからの最大手数
+constexpr int kBookProbeMaxPly = 4;
+
 const Array<std::vector<int>, 20> g_half_density = {
     {0, 1},
     {1, 0},
@@ -178,6 +187,20 @@ void Search::PrepareForNextSearch() {
   }
 }
 
+void Search::ReportMemoryUsage(size_t num_threads, MemoryReport* report) {
+  assert(report != nullptr);
+  const size_t others = sizeof(Search) - sizeof(stack_) - sizeof(pv_table_)
+                      - sizeof(history_) - sizeof(countermoves_)
+                      - sizeof(followupmoves_) - sizeof(gains_);
+  report->Add("Search::stack_ (per thread)", sizeof(stack_), num_threads);
+  report->Add("Search::pv_table_ (per thread)", sizeof(pv_table_), num_threads);
+  report->Add("Search::history_ (per thread)", sizeof(history_), num_threads);
+  report->Add("Search::countermoves_ (per thread)", sizeof(countermoves_), num_threads);
+  report->Add("Search::followupmoves_ (per thread)", sizeof(followupmoves_), num_threads);
+  report->Add("Search::gains_ (per thread)", sizeof(gains_), num_threads);
+  report->Add("Search (others, per thread)", others, num_threads);
+}
+
 Score Search::AlphaBetaSearch(Node& node, Score alpha, Score beta,
                               Depth depth) {
   assert(alpha < beta);
@@ -310,6 +333,29 @@ void Search::IterativeDeepening(Node& node, ThreadManager& thread_manager) {
 
   TimeManager& time_manager = thread_manager.time_manager();
 
+  // トレースの表示用に、スレッド名を設定する
+  if (Tracer::enabled()) {
+    Tracer::SetThreadName("search thread", static_cast<int>(thread_id_));
+  }
+
+  // ベンチマーク時は、このスレッドのハードウェア・パフォーマンス・カウンタを計測する
+  std::unique_ptr<PerfCounter> perf_counter;
+  if (PerfCounter::enabled()) {
+    perf_counter.reset(new PerfCounter);
+    perf_counter->Start();
+  }
+
+  // NUMAノードの固定が有効な場合は、このスレッドをノードに固定し、ノード上のテーブルの複製を参照する
+  Numa::SetUpSearchThread(thread_id_);
+
+  // 合議用に別の評価関数のパラメータが指定されている場合は、このスレッドで使用するパラメータを切り替える
+  // （SEEや指し手の順序付けに用いる駒の価値も、そのパラメータの駒割りに合わせる）
+  Material::SetThreadTables(shared_.material_tables);
+  if (shared_.eval_params != nullptr) {
+    Evaluation::SetThreadParameters(shared_.eval_params);
+    node.RecomputeEvaluation();
+  }
+
   // スタックの初期化を行う
   ResetSearchStack();
 
@@ -330,6 +376,9 @@ void Search::IterativeDeepening(Node& node, ThreadManager& thread_manager) {
       }
     }
 
+    // このイテレーションの開始から終了までをトレースに記録する
+    Tracer::Scope iteration_scope("iteration", iteration);
+
     // αβウィンドウをセットする
     Score alpha = -kScoreInfinite, beta = kScoreInfinite;
 
@@ -374,6 +423,7 @@ void Search::IterativeDeepening(Node& node, ThreadManager& thread_manager) {
           // fail-low
           alpha = std::max(alpha - half_window, -kScoreInfinite);
           beta = (alpha + beta) / 2;
+          Tracer::Instant("fail-low re-search", iteration);
           // パニックモードに変更して、思考時間を延長する
           if (is_master_thread()) {
             time_manager.set_panic_mode(true);
@@ -382,6 +432,7 @@ void Search::IterativeDeepening(Node& node, ThreadManager& thread_manager) {
           // fail-high
           alpha = (alpha + beta) / 2;
           beta = std::min(beta + half_window, kScoreInfinite);
+          Tracer::Instant("fail-high re-search", iteration);
         } else {
           break;
         }
@@ -448,11 +499,18 @@ void Search::IterativeDeepening(Node& node, ThreadManager& thread_manager) {
 
       // 次のイテレーションを回す時間が無い場合は、ここで探索を終了する
       if (!time_manager.EnoughTimeIsAvailableForNextIteration()) {
+        Tracer::Instant("time manager: no time for next iteration", iteration);
         shared_.signals.stop = true; // ワーカースレッドを停止する
         break;
       }
     }
   }
+
+  if (perf_counter) {
+    perf_counter->Stop();
+    PerfCounter::Record("thread " + std::to_string(thread_id_),
+                        perf_counter->values(), num_nodes_searched_);
+  }
 }
 
 std::vector<RootMove> Search::CreateRootMoves(const Position& root_position,
@@ -553,6 +611,26 @@ Score Search::MainSearch(Node& node, Score alpha, Score beta, const Depth depth,
   excluded_move = ss->excluded_move;
   pos_key = excluded_move != kMoveNone ? node.exclusion_key() : node.key();
   entry = shared_.hash_table.LookUp(pos_key);
+
+  // 浅い局面で、置換表にまだ探索結果がなければ、定跡DBで評価値が最も高い手をハッシュ手として登録しておく
+  // （定跡を外れた直後の探索でも、定跡DBの手を最初に調べられるようにするため）
+  // 定跡DBの評価値は、現在の評価関数による探索で確かめたものではないので、置換表には保存しない。
+  // 評価値を持たないエントリとして保存するので、Hash Cutが起きることはない。
+  if (   shared_.book != nullptr
+      && ply <= kBookProbeMaxPly
+      && excluded_move == kMoveNone
+      && (entry == nullptr || (entry->move() == kMoveNone && entry->bound() == kBoundNone))) {
+    Move book_move;
+    Score book_score;
+    if (shared_.book->ProbeBestScoredMove(node, &book_move, &book_score)) {
+      // 静的評価値がすでに保存されている場合は、それを残す
+      const Score stored_eval = entry ? entry->eval() : kScoreNone;
+      shared_.hash_table.Save(pos_key, book_move, kScoreNone, kDepthNone, kBoundNone,
+                              stored_eval, false);
+      entry = shared_.hash_table.LookUp(pos_key);
+    }
+  }
+
   hash_score = entry ? ScoreFromTt(entry->score(), ply) : kScoreNone;
   hash_move = entry ? entry->move() : kMoveNone;
   ss->hash_move = hash_move;
@@ -884,7 +962,9 @@ moves_loop: // 王手がかかっている場合は、ここからスタート
     // 実現確率 及び LMR（Late Move Reduction）
     // 一定以上の残り深さがあれば実現確率を、そうでなければLMRを用いる。
     // 本当はすべて実現確率にしたいところだが、実現確率の計算コストが高いため、残り深さが大きい
-    // ところに限って実現確率を用いている
+    // ところに限って実現確率を用いている。
+    // ただし、軽量な実現確率のモデル（LightMoveProbability）が利用可能な場合は、残り深さが3手以上8手未満の
+    // ところでもMovePickerが静かな手に確率を付けるので（probability > 0）、その確率に基づいて深さを減らす。
     if (   depth >= 3 * kOnePly
         && (move_is_quiet || depth >= MoveProbability::kAppliedDepth)
         && move_count >= 2
@@ -892,7 +972,7 @@ moves_loop: // 王手がかかっている場合は、ここからスタート
         && move != ss->killers[1]) {
 
       // 実現確率
-      if (depth >= MoveProbability::kAppliedDepth) {
+      if (depth >= MoveProbability::kAppliedDepth || probability > 0.0) {
         // 指し手の確率に基づいて、何手減らすかを決定する
         const double kPvFactor = kIsPv ? 0.75 : 1.0;
         double consumption = kPvFactor * -std::log(probability) / std::log(2.0);
@@ -904,6 +984,16 @@ moves_loop: // 王手がかかっている場合は、ここからスタート
           ss->reduction = static_cast<Depth>(reduction * double(kOnePly));
         }
 
+        // 軽量なモデルの確率は、同じ局面の静かな手同士の相対的な値にすぎないので、
+        // ノードの種類（cut node）とヒストリー値の符号による補正は、LMRと同様に加える
+        if (depth < MoveProbability::kAppliedDepth) {
+          if (!kIsPv && cut_node) {
+            ss->reduction += kOnePly;
+          } else if (history_.HasNegativeScore(move)) {
+            ss->reduction += kOnePly / 2;
+          }
+        }
+
       // LMR
       } else {
         assert(move.is_quiet());
@@ -1310,6 +1400,24 @@ void Search::SendUsiInfo(const Node& node, int depth, int64_t time,
   // ゼロ除算を防止するため、最低１ミリ秒は経過したことにする
   time = std::max(time, INT64_C(1));
 
+  // コールバック関数が設定されている場合は、文字列に変換せずに、そのまま渡す
+  if (shared_.info_callback) {
+    for (int pv_index = multipv_ - 1; pv_index >= 0; --pv_index) {
+      SearchInfo info;
+      info.depth = depth;
+      info.seldepth = max_reach_ply_ + 1;
+      info.time = time;
+      info.nodes = nodes;
+      info.hashfull = shared_.hash_table.hashfull();
+      info.multipv = pv_index + 1;
+      info.score = root_moves_.at(pv_index).score;
+      info.bound = bound;
+      info.pv = root_moves_.at(pv_index).pv;
+      shared_.info_callback(info);
+    }
+    return;
+  }
+
   // infoコマンドを一時的に貯めておくためのバッファ
   std::string buf;
 
@@ -1367,4 +1475,5 @@ void Search::SendUsiInfo(const Node& node, int depth, int64_t time,
 
   // infoコマンドをまとめて標準出力へ出力する
   SYNCED_PRINTF("%s", buf.c_str());
+  Tracer::Instant("usi output: info", depth);
 }
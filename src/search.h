@@ -37,6 +37,7 @@
 #include "shared_data.h"
 #include "stats.h"
 
+class MemoryReport;
 class ThreadManager;
 
 /**
@@ -148,6 +149,13 @@ class Search {
 
   void PrepareForNextSearch();
 
+  /**
+   * 探索スレッドごとに確保される、Searchオブジェクトのメモリ使用量の内訳をレポートに追加します.
+   * @param num_threads 探索スレッドの数
+   * @param report      メモリ使用量を追加するレポート
+   */
+  static void ReportMemoryUsage(size_t num_threads, MemoryReport* report);
+
  private:
   static constexpr int kStackSize = kMaxPly + 6;
 
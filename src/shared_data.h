@@ -20,10 +20,16 @@
 #ifndef SHARED_DATA_H_
 #define SHARED_DATA_H_
 
+#include <functional>
+#include <vector>
 #include "hash_table.h"
 #include "signals.h"
 #include "stats.h"
 
+class Book;
+struct EvalParameters;
+struct MaterialTables;
+
 /**
  * ルート局面における指し手の情報を保存するためのクラスです。
  */
@@ -53,6 +59,21 @@ class RootMove {
   std::vector<Move> pv;
 };
 
+/**
+ * 探索の途中経過です（USIのinfoコマンドで出力される情報に相当します）.
+ */
+struct SearchInfo {
+  int depth = 0;
+  int seldepth = 0;
+  int64_t time = 0;
+  uint64_t nodes = 0;
+  int hashfull = 0;
+  int multipv = 1;
+  Score score = kScoreNone;
+  Bound bound = kBoundExact;
+  std::vector<Move> pv;
+};
+
 /**
  * 複数の探索スレッドで共有するデータをひとまとめにしたクラスです。
  */
@@ -71,6 +92,30 @@ struct SharedData {
 
   /** 探索停止等の指示を出すシグナル */
   Signals signals;
+
+  /**
+   * 探索の途中経過を受け取るコールバック関数です.
+   * 設定されている場合は、USIのinfoコマンドを標準出力に出力する代わりに、この関数が呼ばれます。
+   */
+  std::function<void(const SearchInfo&)> info_callback;
+
+  /**
+   * この探索で使用する評価関数のパラメータです.
+   * nullptrの場合は、グローバルなパラメータ（g_eval_params）が使用されます。
+   */
+  const EvalParameters* eval_params = nullptr;
+
+  /**
+   * eval_paramsの駒割りから作成した、駒の価値のテーブルです.
+   * nullptrの場合は、Materialクラスが保持する共有のテーブルが使用されます。
+   */
+  const MaterialTables* material_tables = nullptr;
+
+  /**
+   * 探索の浅い局面で参照する定跡データベースです.
+   * nullptrの場合は、探索中に定跡を参照しません。探索中は読み込み専用として扱います。
+   */
+  const Book* book = nullptr;
 };
 
 #endif /* SHARED_DATA_H_ */
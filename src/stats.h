@@ -24,6 +24,7 @@
 #include <memory>
 #include "common/array.h"
 #include "common/arraymap.h"
+#include "large_page.h"
 #include "move.h"
 
 /**
@@ -94,7 +95,8 @@ class HistoryStats {
 class CountermovesHistoryStats {
  public:
   CountermovesHistoryStats()
-      : table_(new ArrayMap<HistoryStats, Square, Piece>()) {
+      : table_(MakeRequiredLargePageObject<ArrayMap<HistoryStats, Square, Piece>>(
+                   "CountermovesHistoryStats")) {
     Clear();
   }
 
@@ -105,6 +107,7 @@ class CountermovesHistoryStats {
 
   HistoryStats* operator[](Move move) {
     assert(move.is_real_move());
+    touched_[move.to()][move.piece()] = true;
     return &(*table_)[move.to()][move.piece()];
   }
 
@@ -114,10 +117,34 @@ class CountermovesHistoryStats {
         (*table_)[s][p].Clear();
       }
     }
+    touched_.clear();
+  }
+
+  /**
+   * 前回のクリア以降に、書き込み可能な形で参照されたエントリだけをクリアします.
+   * 短い探索を何度も繰り返す学習では、探索のたびにテーブル全体（約13MB）をクリアするよりも高速です。
+   */
+  void ClearTouchedEntries() {
+    for (Square s : Square::all_squares()) {
+      for (Piece p : Piece::all_pieces()) {
+        if (touched_[s][p]) {
+          (*table_)[s][p].Clear();
+        }
+      }
+    }
+    touched_.clear();
+  }
+
+  /**
+   * ヒープ上に確保しているテーブルの大きさを、バイト単位で返します.
+   */
+  static constexpr size_t memory_size() {
+    return sizeof(ArrayMap<HistoryStats, Square, Piece>);
   }
 
  private:
-  std::unique_ptr<ArrayMap<HistoryStats, Square, Piece>> table_;
+  LargePagePtr<ArrayMap<HistoryStats, Square, Piece>> table_;
+  ArrayMap<bool, Square, Piece> touched_;
 };
 
 /**
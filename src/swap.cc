@@ -184,6 +184,171 @@ class MinimumPos : public ExtendedBoard {
   Color side_to_move_;
 };
 
+/**
+ * Global SEEで用いる駒の価値です（玉は、どの駒よりも価値が高いものとして扱います）.
+ */
+inline int GetSwapValue(PieceType pt) {
+  return pt == kKing ? 9999 : Material::exchange_value(pt);
+}
+
+/**
+ * 与えられた駒のうち、最も価値の高い駒（kMost == true）又は最も価値の低い駒を探します.
+ * 価値が同じ駒が複数ある場合は、MinimumPos::FindPiece()と同じく、先に見つかった駒を返します。
+ * @param type_on 各マスにある駒の種類を返す関数
+ */
+template<bool kMost, typename TypeOn>
+Square FindSwapPiece(Bitboard pieces, TypeOn type_on) {
+  assert(pieces.any());
+  Square best_square = kSquareNone;
+  int best_value = kMost ? -kScoreInfinite : kScoreInfinite;
+  pieces.ForEach([&](Square sq) {
+    int value = GetSwapValue(type_on(sq));
+    if (kMost ? (value > best_value) : (value < best_value)) {
+      best_square = sq;
+      best_value = value;
+    }
+  });
+  return best_square;
+}
+
+/**
+ * ThreatMapを用いて、Swap::EvaluateGlobalSwap(move, pos, 3)と同じ値を計算します.
+ * 局面をコピーせずに、指し手とその応手による駒の増減だけを、局面の利きの情報に反映させます。
+ */
+template<Color kUs>
+Score EvaluateGlobalSwap3(const Move move, const ThreatMap& threat_map) {
+  constexpr Color kThem = ~kUs;
+  const Position& pos = threat_map.position();
+  const Square to = move.to();
+  const Bitboard from_bb = move.is_drop() ? Bitboard() : square_bb(move.from());
+  const Bitboard to_bb = square_bb(to);
+  const PieceType moved_type = move.piece_type_after_move();
+
+  auto get_material_gain = [](PieceType captured, Piece attacker, bool promotion) -> Score {
+    Score gain = Material::exchange_value(captured);
+    if (promotion) {
+      gain += Material::promotion_value(attacker.type());
+    }
+    return gain;
+  };
+
+  // 飛び駒の利きを、与えられた盤面の占有状態で計算し直す
+  auto get_slider_controls = [&](Bitboard sliders, Bitboard occ) {
+    Bitboard controls;
+    sliders.ForEach([&](Square sq) {
+      controls |= AttacksFrom(pos.piece_on(sq), sq, occ);
+    });
+    return controls;
+  };
+
+  // 飛び駒以外の駒であれば、その駒の利きを返す（取り除く駒の利きの計算に用いる）
+  auto get_step_attacks = [&](Color c, Square sq, Piece piece) {
+    return threat_map.sliders(c).test(square_bb(sq))
+         ? Bitboard()
+         : AttacksFrom(piece, sq, pos.pieces());
+  };
+
+  // 最初の１手について、駒割りの増分を求める
+  const Score gain0 = get_material_gain(move.captured_piece_type(), move.piece(),
+                                        move.is_promotion());
+
+  //
+  // Step 1. 指し手を指した後の局面で、相手が最も高い駒を最も安い駒で取る
+  //
+  const Bitboard occ1 = (pos.pieces() | to_bb).andnot(from_bb);
+  const Bitboard own1 = (pos.pieces(kUs) | to_bb).andnot(from_bb);
+  const Bitboard opp1 = pos.pieces(kThem).andnot(to_bb);
+  auto type_on1 = [&](Square sq) {
+    return sq == to ? moved_type : pos.piece_on(sq).type();
+  };
+
+  // 取られた駒の利きを除いた、相手の利き
+  const Bitboard captured_attacks = move.is_capture()
+                                  ? get_step_attacks(kThem, to, pos.piece_on(to))
+                                  : Bitboard();
+  const Bitboard opp_controls1 =
+        threat_map.StepControlsWithout(kThem, captured_attacks, Bitboard())
+      | get_slider_controls(threat_map.sliders(kThem).andnot(to_bb), occ1);
+
+  // 取れる駒がなければ、最初の１手の駒割りの増分が、そのままGlobal SEE値になる
+  const Bitboard targets1 = own1 & opp_controls1;
+  if (targets1.none()) {
+    return gain0;
+  }
+
+  const Square victim1_sq = FindSwapPiece<true>(targets1, type_on1);
+  const PieceType victim1 = type_on1(victim1_sq);
+  if (victim1 == kKing) {
+    return std::min(-static_cast<Score>(9999), gain0);
+  }
+
+  const Bitboard attackers1 = pos.AttackersTo<kThem>(victim1_sq, occ1) & opp1;
+  assert(attackers1.any());
+  const Square attacker1_sq = FindSwapPiece<false>(attackers1, type_on1);
+  const Piece attacker1 = pos.piece_on(attacker1_sq);
+  const bool promotion1 =   attacker1.can_promote()
+                         && promotion_zone_bb(kThem).test(square_bb(attacker1_sq) | square_bb(victim1_sq));
+  const PieceType attacker1_after = promotion1 ? attacker1.promoted_piece().type()
+                                               : attacker1.type();
+  const Score gain1 = get_material_gain(victim1, attacker1, promotion1) - gain0;
+
+  //
+  // Step 2. 相手が取った後の局面で、こちらが最も高い駒を最も安い駒で取り返す
+  //
+  const Bitboard victim1_bb = square_bb(victim1_sq);
+  const Bitboard occ2 = occ1.andnot(square_bb(attacker1_sq));
+  const Bitboard own2 = own1.andnot(victim1_bb);
+  const Bitboard opp2 = opp1.andnot(square_bb(attacker1_sq)) | victim1_bb;
+  auto type_on2 = [&](Square sq) {
+    return sq == victim1_sq ? attacker1_after : type_on1(sq);
+  };
+
+  // 指し手で動かした駒は、局面データ上は移動元にあるため、利きを別途計算する
+  const Bitboard moved_piece_attacks = own2.test(to_bb)
+                                     ? AttacksFrom(Piece(kUs, moved_type), to, occ2)
+                                     : Bitboard();
+
+  // 動かした駒の移動元での利きと、取られた駒の利きを除いた、こちらの利き
+  const Bitboard moved_from_attacks = move.is_drop()
+                                    ? Bitboard()
+                                    : get_step_attacks(kUs, move.from(), move.piece());
+  const Bitboard victim1_attacks = victim1_sq == to
+                                 ? Bitboard()
+                                 : get_step_attacks(kUs, victim1_sq, pos.piece_on(victim1_sq));
+  const Bitboard our_sliders2 = threat_map.sliders(kUs).andnot(from_bb | victim1_bb);
+  const Bitboard our_controls2 =
+        threat_map.StepControlsWithout(kUs, moved_from_attacks, victim1_attacks)
+      | get_slider_controls(our_sliders2, occ2)
+      | moved_piece_attacks;
+
+  // 取り返せる駒がなければ、相手が取った時点でミニマックス計算を行う
+  const Bitboard targets2 = opp2 & our_controls2;
+  if (targets2.none()) {
+    return std::min(-gain1, gain0);
+  }
+
+  const Square victim2_sq = FindSwapPiece<true>(targets2, type_on2);
+  const PieceType victim2 = type_on2(victim2_sq);
+  Score gain2;
+  if (victim2 == kKing) {
+    gain2 = static_cast<Score>(9999);
+  } else {
+    Bitboard attackers2 = pos.AttackersTo<kUs>(victim2_sq, occ2) & own2.andnot(to_bb);
+    if (moved_piece_attacks.test(square_bb(victim2_sq))) {
+      attackers2.set(to);
+    }
+    assert(attackers2.any());
+    const Square attacker2_sq = FindSwapPiece<false>(attackers2, type_on2);
+    const Piece attacker2(kUs, type_on2(attacker2_sq));
+    const bool promotion2 =   attacker2.can_promote()
+                           && promotion_zone_bb(kUs).test(square_bb(attacker2_sq) | square_bb(victim2_sq));
+    gain2 = get_material_gain(victim2, attacker2, promotion2) - gain1;
+  }
+
+  // ミニマックス計算をして、 盤面全体の駒交換の損得（Global SEE値）を求める
+  return std::min(-std::min(-gain2, gain1), gain0);
+}
+
 } // namespace
 
 Score Swap::Evaluate(const Move move, const Position& pos) {
@@ -351,3 +516,29 @@ Score Swap::EvaluateGlobalSwap(const Move move, const Position& pos,
 
   return gain[0];
 }
+
+ThreatMap::ThreatMap(const Position& pos)
+    : pos_(pos) {
+  const Bitboard sliders = pos.pieces(kLance, kBishop, kRook, kHorse, kDragon);
+  for (Color c : {kBlack, kWhite}) {
+    sliders_[c] = sliders & pos.pieces(c);
+
+    // 飛び駒以外の駒の利きを、マスごとに3枚まで数える
+    Array<Bitboard, 3>& counts = step_controls_[c];
+    counts[0] = counts[1] = counts[2] = Bitboard();
+    pos.pieces(c).andnot(sliders).ForEach([&](Square sq) {
+      Bitboard attacks = AttacksFrom(pos.piece_on(sq), sq, pos.pieces());
+      counts[2] |= counts[1] & attacks;
+      counts[1] |= counts[0] & attacks;
+      counts[0] |= attacks;
+    });
+  }
+}
+
+Score Swap::EvaluateGlobalSwap(const Move move, const ThreatMap& threat_map) {
+  const Position& pos = threat_map.position();
+  assert(pos.MoveIsPseudoLegal(move));
+  return pos.side_to_move() == kBlack
+       ? EvaluateGlobalSwap3<kBlack>(move, threat_map)
+       : EvaluateGlobalSwap3<kWhite>(move, threat_map);
+}
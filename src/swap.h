@@ -20,9 +20,52 @@
 #ifndef SWAP_H_
 #define SWAP_H_
 
+#include "common/array.h"
+#include "common/arraymap.h"
+#include "bitboard.h"
 #include "move.h"
 class Position;
 
+/**
+ * 同じ局面の複数の指し手について、Global SEE値をまとめて計算するための、局面の利きの情報です.
+ *
+ * 飛び駒（香・角・飛・馬・龍）以外の駒の利きは、駒を動かしても移動元と移動先の周囲しか変わらないので、
+ * 局面ごとに一度だけ、利いている駒の枚数（3枚まで）をマスごとに求めておきます。
+ * 飛び駒の利きは、枚数が少ないので、指し手ごとに盤面の変化を反映して計算し直します。
+ */
+class ThreatMap {
+ public:
+  explicit ThreatMap(const Position& pos);
+
+  const Position& position() const {
+    return pos_;
+  }
+
+  /**
+   * 手番cの飛び駒があるマスを返します.
+   */
+  Bitboard sliders(Color c) const {
+    return sliders_[c];
+  }
+
+  /**
+   * 手番cの飛び駒以外の駒の利きのうち、removed1とremoved2の利きを取り除いても残る利きを返します.
+   * @param removed1 取り除く駒の利き（取り除く駒がなければ、空のビットボード）
+   * @param removed2 取り除く駒の利き（同上）
+   */
+  Bitboard StepControlsWithout(Color c, Bitboard removed1, Bitboard removed2) const {
+    return   step_controls_[c][0].andnot(removed1 | removed2)
+           | (step_controls_[c][1] & (removed1 ^ removed2))
+           | (step_controls_[c][2] & removed1 & removed2);
+  }
+
+ private:
+  const Position& pos_;
+  ArrayMap<Bitboard, Color> sliders_;
+  /** step_controls_[c][n]は、手番cの飛び駒以外の駒がn+1枚以上利いているマス */
+  ArrayMap<Array<Bitboard, 3>, Color> step_controls_;
+};
+
 /**
  * 駒交換の評価（Static Exchange Evaluation）を行います.
  */
@@ -47,6 +90,12 @@ class Swap {
    * 盤全体での駒交換の損得を計算します.
    */
   static Score EvaluateGlobalSwap(Move move, const Position& pos, int depth_limit);
+
+  /**
+   * 盤全体での駒交換の損得を、局面の利きの情報を使って計算します.
+   * EvaluateGlobalSwap(move, pos, 3)と同じ値を返しますが、局面のコピーや利きの再計算を行わないぶん高速です。
+   */
+  static Score EvaluateGlobalSwap(Move move, const ThreatMap& threat_map);
 };
 
 #endif /* SWAP_H_ */
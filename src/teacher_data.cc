@@ -21,12 +21,16 @@
 
 #include "teacher_data.h"
 
+#include <algorithm>
 #include <fstream>
+#include <numeric>
 #include <random>
 #include <omp.h>
 #include "common/progress_timer.h"
+#include "common/simple_timer.h"
 #include "position.h"
 #include "mate3.h"
+#include "memory_report.h"
 #include "movegen.h"
 #include "move_probability.h"
 #include "search.h"
@@ -58,60 +62,53 @@ class TimerThread : public TaskThread {
   int time_limit_ = 100;
 };
 
-/**
- * ランダムに局面を作成します.
- *
- * ランダム局面の生成方法は、(1)実戦における出現可能性と、(2)局面の多様性の両方を担保するため、
- *   1. 初期局面から(ply - 1)手目までは、実現確率に従って指し手を決める
- *   2. 最後の１手については、一様乱数で指してを決める
- * という方式を採用しています（idea from AlphaGo）。
- *
- * （参考文献）
- *   - David Silver, et al.: Mastering the game of Go with deep neural networks
- *     and tree search, Nature 529, pp.484-489, 2016.
- *
- * @param ply 初期局面から数えて何手目の局面を生成するか
- * @param rng 乱数生成器（Random Number Generator）
- * @return ランダムな局面
- */
-Position GenerateRandomPosition(const int ply, std::mt19937& rng) {
+} // namespace
+
+Position TeacherData::GenerateRandomPosition(const int ply, std::mt19937& rng) {
   assert(ply >= 0);
 
   HistoryStats history;
   GainsStats gains;
+  history.Clear();
+  gains.Clear();
   Position pos;
 
+  // 実現確率と、その累積和を保存する配列（手ごとに確保し直さないよう、使い回す）
+  Array<double, Move::kMaxLegalMoves> probabilities;
+  Array<double, Move::kMaxLegalMoves> cumulative_probabilities;
+
 restart:
   pos = Position::CreateStartPosition();
 
   // Step 1. 初期局面から(ply - 1)手目までは、実現確率に従って指し手を決める
   for (int i = 0; i < (ply - 1); ++i) {
     // 合法手がなくなってしまった場合は、もう１度最初から始める
-    if (SimpleMoveList<kAllMoves, true>(pos).empty()) {
+    SimpleMoveList<kAllMoves, true> legal_moves(pos);
+    if (legal_moves.empty()) {
       goto restart;
     }
 
-    // 各指し手の実現確率を計算する
+    // 各指し手の実現確率を計算する（確率は、合法手と同じ順番で並ぶ）
     HistoryStats* cmh = nullptr;
     HistoryStats* fmh = nullptr;
-    auto probabilities = MoveProbability::ComputeProbabilities(pos, history, gains, cmh, fmh);
+    MoveProbability::ComputeProbabilities(pos, legal_moves, history, gains,
+                                          cmh, fmh, probabilities.begin());
 
     // 実現確率に従って、ランダムに１手選ぶ
-    Move selected_move = Move::FromUint32(probabilities.begin()->first);
-    float sum = 0.0;
-    float threashold = std::uniform_real_distribution<float>(0.0f, 1.0f)(rng);
-    for (const std::pair<uint32_t, float>& pair : probabilities) {
-      Move move = Move::FromUint32(pair.first);
-      float probability = pair.second;
-      sum += probability;
-      if (sum >= threashold) {
-        selected_move = move;
-        break;
-      }
-    }
+    // （１局面につき１回しか抽選しないので、エイリアス法よりも、累積和の二分探索の方が速い）
+    const size_t num_moves = legal_moves.size();
+    std::partial_sum(probabilities.begin(), probabilities.begin() + num_moves,
+                     cumulative_probabilities.begin());
+    double total = cumulative_probabilities[num_moves - 1];
+    double threshold = std::uniform_real_distribution<double>(0.0, total)(rng);
+    const double* selected = std::upper_bound(cumulative_probabilities.begin(),
+                                              cumulative_probabilities.begin() + num_moves,
+                                              threshold);
+    size_t move_id = std::min(size_t(selected - cumulative_probabilities.begin()),
+                              num_moves - 1);
 
     // 選択された指し手に従って、局面を進める
-    pos.MakeMove(selected_move);
+    pos.MakeMove(legal_moves[move_id].move);
   }
 
   // Step 2. 最後の１手は、一様乱数を用いてランダムに選ぶ
@@ -132,8 +129,6 @@ restart:
   return pos;
 }
 
-} // namespace
-
 bool TeacherPv::ReadFromFile(std::FILE* stream) {
   std::fread(&huffman_code, sizeof(huffman_code), 1, stream);
   std::fread(&progress, sizeof(progress), 1, stream);
@@ -365,36 +360,49 @@ void TeacherData::GenerateTeacherPvs() {
   omp_set_num_threads(num_threads);
   std::printf("Set num_threads = %d\n", num_threads);
 
-  // データベースから棋譜を読み込む（学習用と、交差検定用の2つがある）
-  std::printf("Extract the games from the database.\n");
-  std::vector<Game> games;
+  // 棋譜データベースを開く
+  // （棋譜は、あらかじめ全部読み込むのではなく、各スレッドが必要になった時点で１局ずつ読み込む）
   std::ifstream db_file(GameDatabase::kDefaultDatabaseFile);
   GameDatabase game_db(db_file);
   game_db.set_title_matches_only(true);
-  for (Game game; game_db.ReadOneGame(&game); ) {
-    games.push_back(game);
-    if (games.size() >= kNumGames) break;
-  }
+  int num_games_read = 0;
 
-  // 乱数生成器をスレッドの数だけ準備する
+  // 乱数生成器と置換表を、スレッドの数だけ準備する
+  // （置換表は対局ごとに確保し直さず、使い回す。前の対局のエントリは、探索ごとに世代を進めることで
+  //   置き換え対象になる。同じ評価関数なので、同一局面のエントリが残っていても問題はない。）
   std::random_device random_device;
   std::vector<std::mt19937> random_number_generators;
+  std::vector<SharedData> shared_datas(num_threads);
   for (int i = 0; i < num_threads; ++i) {
     random_number_generators.emplace_back(random_device());
+    shared_datas.at(i).hash_table.SetSize(128);
   }
 
   // PVを保存するファイルを開く
   std::FILE* pv_data_file = std::fopen("pv_data.bin", "wb");
 
-  ProgressTimer progress_timer(games.size());
+  ProgressTimer progress_timer(kNumGames);
+  SimpleTimer timer;
 
   // 対局を１つずつ調べていく
-#pragma omp parallel for schedule(dynamic)
-  for (size_t game_id = 0; game_id < games.size(); ++game_id) {
-    const Game& game = games.at(game_id);
+#pragma omp parallel
+  for (;;) {
+    // 次の対局を読み込む
+    Game game;
+    bool game_is_read;
+#pragma omp critical (read_game)
+    {
+      game_is_read = num_games_read < kNumGames && game_db.ReadOneGame(&game);
+      num_games_read += game_is_read;
+    }
+    if (!game_is_read) {
+      break;
+    }
+
     Node node(Position::CreateStartPosition());
-    SharedData shared_data;
-    shared_data.hash_table.SetSize(128);
+    SharedData& shared_data = shared_datas.at(omp_get_thread_num());
+    shared_data.countermoves_history.Clear();
+    Search search(shared_data);
     std::vector<TeacherPv> teacher_pvs;
 
     // 棋譜中の局面を１つずつ調べていく
@@ -422,7 +430,6 @@ void TeacherData::GenerateTeacherPvs() {
       std::iter_swap(moves.begin(), iter);
 
       // 探索の準備をする
-      Search search(shared_data);
       search.PrepareForNextSearch();
       std::mt19937& rng = random_number_generators.at(omp_get_thread_num());
 
@@ -483,6 +490,12 @@ void TeacherData::GenerateTeacherPvs() {
   }
 
   std::fclose(pv_data_file);
+
+  // 処理速度とメモリ使用量を表示する
+  double elapsed = std::max(timer.GetElapsedSeconds(), 0.001);
+  std::printf("\nGames=%d, Time=%.1fsec, Speed=%.3fgames/sec, PeakRSS=%.1fMB\n",
+              num_games_read, elapsed, num_games_read / elapsed,
+              MemoryReport::GetPeakResidentSetSize() / (1024.0 * 1024.0));
 }
 
 #endif // !defined(MINIMUM)
@@ -23,10 +23,12 @@
 #if !defined(MINIMUM)
 
 #include <cstdio>
+#include <random>
 #include <vector>
 #include "gamedb.h"
 #include "huffman_code.h"
 #include "move.h"
+#include "position.h"
 
 /**
  * 教師局面のデータです.
@@ -103,6 +105,24 @@ class TeacherData {
    * 教師となるPVデータを生成します.
    */
   static void GenerateTeacherPvs();
+
+  /**
+   * ランダムに局面を作成します.
+   *
+   * ランダム局面の生成方法は、(1)実戦における出現可能性と、(2)局面の多様性の両方を担保するため、
+   *   1. 初期局面から(ply - 1)手目までは、実現確率に従って指し手を決める
+   *   2. 最後の１手については、一様乱数で指してを決める
+   * という方式を採用しています（idea from AlphaGo）。
+   *
+   * （参考文献）
+   *   - David Silver, et al.: Mastering the game of Go with deep neural networks
+   *     and tree search, Nature 529, pp.484-489, 2016.
+   *
+   * @param ply 初期局面から数えて何手目の局面を生成するか
+   * @param rng 乱数生成器（Random Number Generator）
+   * @return ランダムな局面
+   */
+  static Position GenerateRandomPosition(int ply, std::mt19937& rng);
 };
 
 #endif // !defined(MINIMUM)
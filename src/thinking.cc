@@ -19,27 +19,69 @@
 
 #include "thinking.h"
 
+#include <algorithm>
 #include "book.h"
+#include "evaluation.h"
+#include "memory_report.h"
 #include "move_probability.h"
 #include "movegen.h"
 #include "node.h"
+#include "numa.h"
+#include "progress.h"
 #include "search.h"
 #include "synced_printf.h"
 #include "thread.h"
+#include "tracer.h"
 #include "usi.h"
 #include "usi_protocol.h"
 
 Thinking::Thinking(const UsiOptions& usi_options)
     : usi_options_(usi_options),
       time_manager_(usi_options, &shared_data_.signals),
-      thread_manager_(shared_data_, time_manager_) {
+      thread_manager_(shared_data_, time_manager_),
+      consultation_(usi_options) {
 }
 
 void Thinking::Initialize() {
   book_.ReadFromFile(usi_options_["BookFile"].string().c_str());
-  shared_data_.hash_table.SetSize(usi_options_["USI_Hash"]);
+  consultation_.Initialize();
+  // プロセス内合議を行う場合は、各投票者が置換表を持つので、ここでは最小サイズの置換表のみ確保する
+  const size_t hash_size = consultation_.num_voters() >= 2 ? 1 : int(usi_options_["USI_Hash"]);
+  if (!shared_data_.hash_table.SetSize(hash_size)) {
+    SYNCED_PRINTF("info string Failed to allocate %zu MB for the hash table. Using %.2f MB instead.\n",
+                  hash_size, shared_data_.hash_table.memory_size() / (1024.0 * 1024.0));
+  }
   shared_data_.countermoves_history.Clear();
-  MoveProbability::SetCacheTableSize(ProbabilityCacheTable::kDefaultSize * usi_options_["Threads"]);
+  const size_t num_voters = std::max<size_t>(consultation_.num_voters(), 1);
+  MoveProbability::SetCacheTableSize(usi_options_["ProbabilityCacheSize"] * usi_options_["Threads"] * num_voters);
+}
+
+void Thinking::ReportMemoryUsage(MemoryReport* const report) const {
+  assert(report != nullptr);
+  const size_t num_threads = usi_options_["Threads"];
+
+  // 1. 全スレッドで共有されるテーブル
+  report->Add("HashTable", shared_data_.hash_table.memory_size());
+  report->Add("CountermovesHistoryStats", CountermovesHistoryStats::memory_size());
+  report->Add("ProbabilityCacheTable", MoveProbability::cache_table_memory_size());
+  report->Add("Book", book_.memory_size());
+
+  // 2. 読み込み専用の、静的なテーブル
+  report->Add("EvalParameters (g_eval_params)", sizeof(EvalParameters));
+  report->Add("Progress::weights", sizeof(Progress::weights));
+  report->Add("MoveProbability weights", MoveProbability::weights_memory_size());
+  if (Numa::num_replicas() > 0) {
+    report->Add("EvalParameters (NUMA replicas)", sizeof(EvalParameters), Numa::num_replicas());
+    report->Add("MoveProbability weights (NUMA replicas)", MoveProbability::weights_memory_size(),
+                Numa::num_replicas());
+  }
+
+  // 3. 探索スレッドごとに確保されるオブジェクト
+  const size_t num_voters = std::max<size_t>(consultation_.num_voters(), 1);
+  Search::ReportMemoryUsage(num_threads * num_voters, report);
+
+  // 4. プロセス内合議の投票者ごとに確保されるテーブル
+  consultation_.ReportMemoryUsage(report);
 }
 
 void Thinking::StartNewGame() {
@@ -48,38 +90,81 @@ void Thinking::StartNewGame() {
 
 void Thinking::ResetSignals() {
   shared_data_.signals.Reset();
+  consultation_.ResetSignals();
 }
 
 void Thinking::StartThinking(const Node& root_node,
                              const UsiGoOptions& go_options) {
-  bool win_declaration_is_possible = false;
-  Move best_move = kMoveNone;
-  Move ponder_move = kMoveNone;
+  // 1. 最善手を求める
+  const ThinkingResult result = Think(root_node, go_options);
+
+  // 2. 必要であれば、最善手を送る前に待機する
+  //    USIプロトコルにおいては、go infiniteか、go ponderで始まった場合は、
+  //    stopかponderhitが来ない限り、bestmoveを返してはいけないことになっているため。
+  //    http://www.geocities.jp/shogidokoro/usi.html
+  if (go_options.infinite || go_options.ponder) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    sleep_condition_.wait(lock, [&](){
+      return shared_data_.signals.stop || shared_data_.signals.ponderhit;
+    });
+  }
+
+  // 3. 最善手を送る
+  if (result.win_declaration) {
+    // a. 入玉宣言勝ちができる場合は、勝ち宣言を行う
+    SYNCED_PRINTF("bestmove win\n");
+  } else if (result.best_move == kMoveNone) {
+    // b. 最善手がなければ投了する
+    SYNCED_PRINTF("bestmove resign\n");
+  } else if (usi_options_["USI_Ponder"] && result.ponder_move != kMoveNone) {
+    // c. 最善手と、予測読みの手を送る
+    SYNCED_PRINTF("bestmove %s ponder %s\n",
+                  result.best_move.ToSfen().c_str(),
+                  result.ponder_move.ToSfen().c_str());
+  } else {
+    // d. 最善手のみを送る
+    SYNCED_PRINTF("bestmove %s\n", result.best_move.ToSfen().c_str());
+  }
+  Tracer::Instant("usi output: bestmove");
+}
+
+ThinkingResult Thinking::Think(const Node& root_node,
+                               const UsiGoOptions& go_options) {
+  ThinkingResult result;
+  Move& best_move = result.best_move;
+  Move& ponder_move = result.ponder_move;
   SimpleMoveList<kAllMoves, true> all_legal_moves(root_node);
 
+  // コールバック関数が設定されている場合は、標準出力には何も出力しない
+  const bool quiet = static_cast<bool>(shared_data_.info_callback);
+
   // searchmovesオプション、ignoremovesオプションを考慮して、探索すべき手を確定する
   const std::vector<RootMove> root_moves = Search::CreateRootMoves(
       root_node, go_options.searchmoves, go_options.ignoremoves);
 
   // 1. 入玉宣言勝ち
   if (root_node.WinDeclarationIsPossible(true)) {
-    win_declaration_is_possible = true;
-    SYNCED_PRINTF("info depth 1 nodes 0 time 0 score mate + string Nyugyoku\n");
-    goto send_best_move;
+    result.win_declaration = true;
+    if (!quiet) {
+      SYNCED_PRINTF("info depth 1 nodes 0 time 0 score mate + string Nyugyoku\n");
+    }
+    return result;
   }
 
   // 2. 合法手が存在しなければ、投了する
   if (all_legal_moves.size() == 0) {
-    SYNCED_PRINTF("info depth 0 nodes 0 time 0 string No legal moves.\n");
-    best_move = kMoveNone;
-    goto send_best_move;
+    if (!quiet) {
+      SYNCED_PRINTF("info depth 0 nodes 0 time 0 string No legal moves.\n");
+    }
+    return result;
   }
 
   // 3. 全ての指し手を無視するように指示されていたら、探索をスキップする
   if (root_moves.empty()) {
-    SYNCED_PRINTF("info depth 0 nodes 0 time 0 string All moves are ignored.\n");
-    best_move = kMoveNone;
-    goto send_best_move;
+    if (!quiet) {
+      SYNCED_PRINTF("info depth 0 nodes 0 time 0 string All moves are ignored.\n");
+    }
+    return result;
   }
 
   // 4. 時間制限が存在する場合は、定跡を使う
@@ -89,17 +174,44 @@ void Thinking::StartThinking(const Node& root_node,
       && go_options.ignoremoves.empty()
       && usi_options_["OwnBook"]
       && root_node.game_ply() + 1 <= usi_options_["BookMaxPly"]) {
-    // 定跡DBから１手取得する
-    Move book_move = book_.GetOneBookMove(root_node, usi_options_);
+    // 定跡DBから１手取得する（標準出力に出力しない場合は、定跡手の一覧も表示しない）
+    Move book_move = quiet
+                   ? book_.GetBookMoves(root_node, usi_options_).PickRandom()
+                   : book_.GetOneBookMove(root_node, usi_options_);
 
     // 定跡存在するときは、通常探索をスキップする
     if (book_move != kMoveNone) {
       best_move = book_move;
-      goto send_best_move;
+      return result;
     }
   }
 
-  // 5. 通常探索を行う
+  // 5. プロセス内合議を行う（投票者が２人以上いる場合）
+  if (!go_options.mate && consultation_.num_voters() >= 2) {
+    Score draw_score = Score(int(usi_options_["DrawScore"]));
+    int depth_limit = (go_options.depth != kMaxPly) ? go_options.depth : int(usi_options_["DepthLimit"]);
+    const RootMove best_root_move = consultation_.Search(root_node, go_options,
+                                                         root_moves,
+                                                         draw_score,
+                                                         usi_options_["MultiPV"],
+                                                         depth_limit,
+                                                         go_options.nodes,
+                                                         quiet);
+    const std::vector<Move>& pv = best_root_move.pv;
+    best_move   = pv.size() >= 1U ? pv.at(0) : kMoveNone;
+    ponder_move = pv.size() >= 2U ? pv.at(1) : kMoveNone;
+    result.score = best_root_move.score;
+    result.pv = pv;
+    if (ponder_move == kMoveNone) {
+      ponder_move = consultation_.GetPonderMove(root_node, best_move);
+    }
+    if (best_root_move.score < Score(int(usi_options_["ResignScore"]))) {
+      best_move = kMoveNone;
+    }
+    return result;
+  }
+
+  // 6. 通常探索を行う
   if (!go_options.mate) {
     // a. 時間管理を開始する
     time_manager_.StartTimeManagement(root_node, go_options);
@@ -109,6 +221,11 @@ void Thinking::StartThinking(const Node& root_node,
     Score draw_score = Score(int(usi_options_["DrawScore"]));
     thread_manager_.SetNumSearchThreads(usi_options_["Threads"]);
 
+    // 定跡を用いる最大手数（BookMaxPly）以内の局面では、探索の浅い局面で定跡DBを参照する
+    bool book_in_search = usi_options_["BookInSearch"]
+                       && root_node.game_ply() + 1 <= usi_options_["BookMaxPly"];
+    shared_data_.book = book_in_search ? &book_ : nullptr;
+
     // c. 探索を開始する
     // 読みの深さ制限機能については、USIオプションよりも、goコマンドのオプションを優先する
     int depth_limit = (go_options.depth != kMaxPly) ? go_options.depth : int(usi_options_["DepthLimit"]);
@@ -127,6 +244,8 @@ void Thinking::StartThinking(const Node& root_node,
     const std::vector<Move>& pv = best_root_move.pv;
     best_move   = pv.size() >= 1U ? pv.at(0) : kMoveNone;
     ponder_move = pv.size() >= 2U ? pv.at(1) : kMoveNone;
+    result.score = best_root_move.score;
+    result.pv = pv;
 
     // f. 相手の予想手が取得できない場合は、ハッシュテーブルからの取得を試みる
     if (ponder_move == kMoveNone) {
@@ -143,40 +262,13 @@ void Thinking::StartThinking(const Node& root_node,
     }
   }
 
-send_best_move:
-
-  // 6. 必要であれば、最善手を送る前に待機する
-  //    USIプロトコルにおいては、go infiniteか、go ponderで始まった場合は、
-  //    stopかponderhitが来ない限り、bestmoveを返してはいけないことになっているため。
-  //    http://www.geocities.jp/shogidokoro/usi.html
-  if (go_options.infinite || go_options.ponder) {
-    std::unique_lock<std::mutex> lock(mutex_);
-    sleep_condition_.wait(lock, [&](){
-      return shared_data_.signals.stop || shared_data_.signals.ponderhit;
-    });
-  }
-
-  // 7. 最善手を送る
-  if (win_declaration_is_possible) {
-    // a. 入玉宣言勝ちができる場合は、勝ち宣言を行う
-    SYNCED_PRINTF("bestmove win\n");
-  } else if (best_move == kMoveNone) {
-    // b. 最善手がなければ投了する
-    SYNCED_PRINTF("bestmove resign\n");
-  } else if (usi_options_["USI_Ponder"] && ponder_move != kMoveNone) {
-    // c. 最善手と、予測読みの手を送る
-    SYNCED_PRINTF("bestmove %s ponder %s\n",
-                  best_move.ToSfen().c_str(),
-                  ponder_move.ToSfen().c_str());
-  } else {
-    // d. 最善手のみを送る
-    SYNCED_PRINTF("bestmove %s\n", best_move.ToSfen().c_str());
-  }
+  return result;
 }
 
 void Thinking::StopThinking() {
   mutex_.lock();
   shared_data_.signals.stop = true;
+  consultation_.Stop();
   mutex_.unlock();
 
   sleep_condition_.notify_one();
@@ -184,6 +276,7 @@ void Thinking::StopThinking() {
 
 void Thinking::Ponderhit() {
   time_manager_.RecordPonderhitTime();
+  consultation_.Ponderhit();
 
   mutex_.lock();
   shared_data_.signals.ponderhit = true;
@@ -22,33 +22,40 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <functional>
 #include <mutex>
 #include <vector>
 #include "common/arraymap.h"
 #include "book.h"
+#include "local_consultation.h"
 #include "shared_data.h"
 #include "signals.h"
 #include "thread.h"
 #include "time_manager.h"
 
+class MemoryReport;
 class Node;
 class UsiGoOptions;
 class UsiOptions;
 
 /**
- * マシン１台構成の場合に使用される、シンプルなタイムマネージャです.
+ * エンジンが考えた結果です.
  */
-class SimpleTimeManager : public TimeManager {
- public:
-  SimpleTimeManager(const UsiOptions& usi_options, Signals* signals)
-      : TimeManager(usi_options),
-        signals_(signals) {
-  }
-  void HandleTimeUpEvent() {
-    signals_->stop = true;
-  }
- private:
-  Signals* const signals_;
+struct ThinkingResult {
+  /** 最善手（投了する場合は、kMoveNone） */
+  Move best_move = kMoveNone;
+
+  /** 相手の予想手 */
+  Move ponder_move = kMoveNone;
+
+  /** 最善手の評価値（定跡手を選んだ場合など、探索を行わなかった場合は、kScoreNone） */
+  Score score = kScoreNone;
+
+  /** 最善手の読み筋 */
+  std::vector<Move> pv;
+
+  /** 入玉宣言勝ちができる場合は、true */
+  bool win_declaration = false;
 };
 
 /**
@@ -64,6 +71,12 @@ class Thinking {
    */
   void Initialize();
 
+  /**
+   * 思考部が使用している各テーブルのメモリ使用量を、レポートに追加します.
+   * スレッドごとに確保されるテーブルについては、USIオプションのスレッド数を用いて見積もります。
+   */
+  void ReportMemoryUsage(MemoryReport* report) const;
+
   /**
    * 新しい対局を行うために必要な処理（置換表の初期化など）を行います.
    */
@@ -75,10 +88,25 @@ class Thinking {
   void ResetSignals();
 
   /**
-   * 特定の局面での最善手を求めるためにエンジンに考えさせます.
+   * 特定の局面での最善手を求めるためにエンジンに考えさせ、bestmoveコマンドを出力します.
    */
   void StartThinking(const Node& root_node, const UsiGoOptions& go_options);
 
+  /**
+   * 特定の局面での最善手を求めます.
+   * StartThinking()とは異なり、bestmoveコマンドの出力や、go infinite時のstop待ちは行いません。
+   */
+  ThinkingResult Think(const Node& root_node, const UsiGoOptions& go_options);
+
+  /**
+   * 探索の途中経過を受け取るコールバック関数を設定します.
+   * 設定されている間は、infoコマンドなどを標準出力に出力しません。
+   */
+  void set_info_callback(const std::function<void(const SearchInfo&)>& callback) {
+    shared_data_.info_callback = callback;
+    consultation_.set_info_callback(callback);
+  }
+
   /**
    * 思考中のエンジンに対して思考を停止するよう指示します.
    */
@@ -89,6 +117,22 @@ class Thinking {
    */
   void Ponderhit();
 
+  /**
+   * 直前の通常探索で、全スレッドが探索したノード数の合計を返します（ベンチマーク用）.
+   */
+  uint64_t last_num_nodes_searched() const {
+    return consultation_.num_voters() >= 2
+         ? consultation_.last_num_nodes_searched()
+         : thread_manager_.last_num_nodes_searched();
+  }
+
+  /**
+   * 直前の通常探索で、各スレッドが探索したノード数を返します（ベンチマーク用。プロセス内合議の場合は対象外）.
+   */
+  const std::vector<uint64_t>& last_num_nodes_by_thread() const {
+    return thread_manager_.last_num_nodes_by_thread();
+  }
+
  private:
   const UsiOptions& usi_options_;
   std::mutex mutex_;
@@ -97,6 +141,7 @@ class Thinking {
   SharedData shared_data_;
   SimpleTimeManager time_manager_;
   ThreadManager thread_manager_;
+  LocalConsultation consultation_;
 };
 
 #endif /* THINKING_H_ */
@@ -153,6 +153,14 @@ RootMove ThreadManager::ParallelSearch(Node& node, const Score draw_score,
     worker->WaitUntilSearchIsFinished();
   }
 
+  // 探索ノード数を記録しておく
+  last_num_nodes_searched_ = master_search.num_nodes_searched()
+                           + CountNodesSearchedByWorkerThreads();
+  last_num_nodes_by_thread_.assign(1, master_search.num_nodes_searched());
+  for (const std::unique_ptr<SearchThread>& worker : worker_threads_) {
+    last_num_nodes_by_thread_.push_back(worker->search_.num_nodes_searched());
+  }
+
   // 最善手と、相手の予想手を取得する
   const RootMove& best_root_move = master_search.GetBestRootMove();
   return best_root_move;
@@ -71,9 +71,26 @@ class ThreadManager {
   RootMove ParallelSearch(Node& node, Score draw_score,
                           const std::vector<RootMove>& root_moves,
                           int multipv, int depth_limit, uint64_t nodes_limit);
+
+  /**
+   * 直前のParallelSearch()で、全スレッドが探索したノード数の合計を返します.
+   */
+  uint64_t last_num_nodes_searched() const {
+    return last_num_nodes_searched_;
+  }
+
+  /**
+   * 直前のParallelSearch()で、各スレッドが探索したノード数を返します（添字はスレッドID。0はマスタースレッド）.
+   */
+  const std::vector<uint64_t>& last_num_nodes_by_thread() const {
+    return last_num_nodes_by_thread_;
+  }
+
  private:
   SharedData& shared_data_;
   TimeManager& time_manager_;
+  uint64_t last_num_nodes_searched_ = 0;
+  std::vector<uint64_t> last_num_nodes_by_thread_;
   std::vector<std::unique_ptr<SearchThread>> worker_threads_;
 };
 
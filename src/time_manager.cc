@@ -19,11 +19,14 @@
 
 #include "time_manager.h"
 
+#include <cstdio>
 #include "signals.h"
+#include "tracer.h"
 #include "usi_protocol.h"
 
 TimeManager::TimeManager(const UsiOptions& usi_options)
     : usi_options_(usi_options) {
+  overshoot_stats_.Reset();
   TaskThread::StartNewThread();
 }
 
@@ -65,6 +68,7 @@ void TimeManager::StartTimeManagement(const Position& pos,
   }
 
   // 別スレッドでの時間制御を開始する
+  Tracer::Instant("time manager: start", time_control_->target_time());
   stop_ = false;
   TaskThread::ExecuteTask();
 }
@@ -76,8 +80,18 @@ void TimeManager::StopTimeManagement() {
 }
 
 void TimeManager::RecordPonderhitTime() {
+  std::unique_lock<std::mutex> lock(mutex_);
   ponderhit_time_ = std::chrono::steady_clock::now();
   ponderhit_ = true;
+  // 消費時間のカウントが始まるので、期限を計算し直させる
+  deadline_changed_ = true;
+  sleep_condition_.notify_one();
+}
+
+void TimeManager::NotifyDeadlineChanged() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  deadline_changed_ = true;
+  sleep_condition_.notify_one();
 }
 
 int64_t TimeManager::elapsed_time() const {
@@ -104,6 +118,9 @@ void TimeManager::RecordNodesSearched(int iteration, uint64_t nodes_searched) {
   } else {
     num_nodes_searched_.push_back(nodes_searched); // 新規保存
   }
+
+  // 探索ノード数と一緒に統計データも更新されているので、目標思考時間を計算し直させる
+  NotifyDeadlineChanged();
 }
 
 bool TimeManager::EnoughTimeIsAvailableForNextIteration() const {
@@ -145,32 +162,98 @@ bool TimeManager::EnoughTimeIsAvailableForNextIteration() const {
 }
 
 void TimeManager::Run() {
+  if (Tracer::enabled()) {
+    Tracer::SetThreadName("time manager");
+  }
+
+  // 一度にスリープする時間の上限（時間無制限の場合にオーバーフローしないようにするため）
+  const int64_t kMaxSleepTime = INT64_C(24) * 60 * 60 * 1000;
+
+  // 基準時刻にミリ秒を加えた時刻を返す
+  auto add = [&](Clock::time_point base, int64_t ms) {
+    return base + std::chrono::milliseconds(std::min(ms, kMaxSleepTime));
+  };
+
+  std::unique_lock<std::mutex> lock(mutex_);
+
   while (!stop_) {
-    // Step 1. 最小思考時間を下回っているときは、打ち切りを行わない
-    if (expended_time() < time_control_->minimum_time()) {
-      goto sleep;
-    }
+    deadline_changed_ = false;
 
-    // Step 2. 消費時間ベースの打ち切り
-    // 消費時間が最大思考時間を上回ったら思考を直ちに終了する（切れ負けを防ぐ）
-    if (expended_time() >= time_control_->maximum_time()) {
-      HandleTimeUpEvent();
-      break;
+    // Step 1. 先読み中は消費時間が増えないので、ponderhitなどで起こされるまで待機する
+    if (ponder_ && !ponderhit_) {
+      sleep_condition_.wait(lock, [this](){ return stop_ || deadline_changed_; });
+      continue;
     }
 
-    // Step 3. 経過時間ベースの打ち切り
-    // 経過時間が、目標時間を上回ったら思考を終了する（fail-low時を除く）
-    if (   !panic_mode_
-        && elapsed_time() >= time_control_->target_time()) {
+    // Step 2. 各期限の時刻を求める
+    // 最小思考時間を下回っているときは打ち切りを行わないので、各期限は最小思考時間以降になる
+    const Clock::time_point now = Clock::now();
+    const Clock::time_point minimum = add(ponderhit_time_, time_control_->minimum_time());
+    const Clock::time_point maximum = std::max(
+        add(ponderhit_time_, time_control_->maximum_time()), minimum);
+    const Clock::time_point target = panic_mode_
+        ? maximum
+        : std::min(std::max(add(start_time_, time_control_->target_time()), minimum),
+                   maximum);
+
+    // Step 3. 期限を過ぎていれば、思考を終了する
+    // 消費時間が最大思考時間を上回った場合（切れ負けを防ぐ）か、
+    // 経過時間が目標時間を上回った場合（fail-low時を除く）に、思考を直ちに終了する
+    if (now >= target) {
+      int64_t overshoot = std::chrono::duration_cast<std::chrono::microseconds>(
+          now - target).count();
+      overshoot_stats_.Add(overshoot);
+      if (target == maximum) {
+        Tracer::Instant("time manager: maximum time", expended_time());
+      } else {
+        Tracer::Instant("time manager: target time", elapsed_time());
+      }
+      Tracer::Instant("time manager: overshoot", overshoot);
+      // 時間切れ処理の中でStopTimeManagement()が呼ばれることがあるので、ロックを外しておく
+      lock.unlock();
       HandleTimeUpEvent();
       break;
     }
 
-sleep:
-    // 一定時間スリープしてから、再度時間をチェックする
-    std::unique_lock<std::mutex> lock(mutex_);
-    if (!stop_) {
-      sleep_condition_.wait_for(lock, std::chrono::milliseconds(5));
+    // Step 4. 次の期限までスリープする（期限が変化した場合は、途中で起こされる）
+    sleep_condition_.wait_until(lock, target, [this](){
+      return stop_ || deadline_changed_;
+    });
+  }
+}
+
+void TimeManager::OvershootStats::Reset() {
+  count = 0;
+  sum_us = 0;
+  max_us = 0;
+  histogram.clear();
+}
+
+void TimeManager::OvershootStats::Add(int64_t overshoot_us) {
+  int bin = 0;
+  while (bin < kNumBins - 1 && (INT64_C(1) << bin) <= overshoot_us) {
+    ++bin;
+  }
+  count += 1;
+  sum_us += overshoot_us;
+  max_us = std::max(max_us, overshoot_us);
+  histogram[bin] += 1;
+}
+
+void TimeManager::OvershootStats::Print() const {
+  if (count == 0) {
+    std::printf("Overshoot: no samples\n");
+    return;
+  }
+  std::printf("Overshoot: samples=%" PRIu64 " average=%.1fus max=%" PRId64 "us\n",
+              count, double(sum_us) / count, max_us);
+  uint64_t cumulative = 0;
+  for (int i = 0; i < kNumBins; ++i) {
+    if (histogram[i] == 0) {
+      continue;
     }
+    cumulative += histogram[i];
+    std::printf("  < %8" PRId64 "us: %8" PRIu64 " (%5.1f%%)\n",
+                INT64_C(1) << i, histogram[i], 100.0 * cumulative / count);
   }
 }
@@ -23,6 +23,8 @@
 #include <chrono>
 #include <memory>
 #include <vector>
+#include "common/array.h"
+#include "signals.h"
 #include "task_thread.h"
 #include "time_control.h"
 
@@ -32,9 +34,31 @@ class UsiGoOptions;
  * USIエンジンが対局する際に、残り時間を管理するためのクラスです.
  *
  * 時計合わせの影響を受けないように、std::chrono::steady_clockを使って実装されています。
+ * 時間管理用スレッドは、一定間隔でポーリングするのではなく、次に判断が必要になる時刻
+ * （最小思考時間・目標思考時間・最大思考時間のいずれか）までスリープします。
+ * 目標思考時間などが変化しうるタイミング（統計データの更新、ponderhit等）では、
+ * スレッドを起こして期限を計算し直します。
  */
 class TimeManager : public TaskThread {
  public:
+  /**
+   * 期限を過ぎてから、実際に時間切れを検出するまでの遅れ（オーバーシュート）の統計です.
+   * 秒読みのマージンを詰める際の目安に使います。
+   */
+  struct OvershootStats {
+    /** ヒストグラムのビンの数（i番目のビンは、[2^(i-1), 2^i)マイクロ秒の遅れを数える） */
+    static constexpr int kNumBins = 24;
+
+    void Reset();
+    void Add(int64_t overshoot_us);
+    void Print() const;
+
+    uint64_t count = 0;
+    int64_t sum_us = 0;
+    int64_t max_us = 0;
+    Array<uint64_t, kNumBins> histogram;
+  };
+
   TimeManager(const UsiOptions& usi_options);
 
   /**
@@ -85,14 +109,35 @@ class TimeManager : public TaskThread {
    * fail-lowした場合には、このパニックモードをオンにすることで、思考時間を延長します.
    */
   void set_panic_mode(bool panic_mode) {
-    panic_mode_ = panic_mode;
+    if (panic_mode_ != panic_mode) {
+      panic_mode_ = panic_mode;
+      NotifyDeadlineChanged();
+    }
   }
 
+  /**
+   * 時間管理用の統計データを返します.
+   * 統計データを更新した後は、NotifyDeadlineChanged()を呼んで、期限を再計算させてください。
+   */
   TimeControl::Stats& stats() {
     return time_control_->stats;
   }
 
+  /**
+   * 目標思考時間などの期限が変化した可能性があることを、時間管理用スレッドに知らせます.
+   */
+  void NotifyDeadlineChanged();
+
+  /**
+   * これまでに時間切れを検出した際の、オーバーシュートの統計を返します.
+   * 注意：時間管理用スレッドの実行中に読むと、値が更新途中である可能性があります。
+   */
+  const OvershootStats& overshoot_stats() const {
+    return overshoot_stats_;
+  }
+
  private:
+  typedef std::chrono::steady_clock Clock;
   void Run();
   const UsiOptions& usi_options_;
   bool ponder_ = false;
@@ -104,7 +149,25 @@ class TimeManager : public TaskThread {
   std::chrono::time_point<std::chrono::steady_clock> ponderhit_time_;
   std::mutex mutex_;
   std::condition_variable sleep_condition_;
+  bool deadline_changed_ = false;
   std::vector<uint64_t> num_nodes_searched_;
+  OvershootStats overshoot_stats_;
+};
+
+/**
+ * マシン１台構成の場合に使用される、シンプルなタイムマネージャです.
+ */
+class SimpleTimeManager : public TimeManager {
+ public:
+  SimpleTimeManager(const UsiOptions& usi_options, Signals* signals)
+      : TimeManager(usi_options),
+        signals_(signals) {
+  }
+  void HandleTimeUpEvent() {
+    signals_->stop = true;
+  }
+ private:
+  Signals* const signals_;
 };
 
 #endif /* TIME_MANAGER_H_ */
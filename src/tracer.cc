@@ -0,0 +1,176 @@
+/*
+ * 技巧 (Gikou), a USI shogi (Japanese chess) playing engine.
+ * Copyright (C) 2016-2017 Yosuke Demura
+ * except where otherwise indicated.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tracer.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ * トレースに記録される１つのイベントです.
+ */
+struct Event {
+  int64_t timestamp; // 単位はマイクロ秒
+  int64_t value;
+  const char* name;
+  char phase;
+  char detail[Tracer::kDetailLength];
+};
+
+/**
+ * スレッドごとに用意されるリングバッファです.
+ * 書き込みは、バッファを所有するスレッドのみが行います。
+ */
+struct RingBuffer {
+  RingBuffer(int tid)
+      : thread_id(tid),
+        events(Tracer::kBufferSize) {
+  }
+  const int thread_id;
+  std::string thread_name;
+  std::atomic<uint64_t> num_written{0};
+  std::vector<Event> events;
+};
+
+/** トレースの時刻の基準点 */
+const auto g_start_time = std::chrono::steady_clock::now();
+
+/** 全スレッドのリングバッファ（バッファの登録時と、書き出し時のみ、排他制御を行う） */
+std::mutex g_buffers_mutex;
+std::vector<std::unique_ptr<RingBuffer>> g_buffers;
+
+thread_local RingBuffer* t_buffer = nullptr;
+
+RingBuffer* GetThreadLocalBuffer() {
+  if (t_buffer == nullptr) {
+    std::lock_guard<std::mutex> lock(g_buffers_mutex);
+    g_buffers.emplace_back(new RingBuffer(static_cast<int>(g_buffers.size())));
+    t_buffer = g_buffers.back().get();
+  }
+  return t_buffer;
+}
+
+/**
+ * JSON文字列として出力するために、特殊文字をエスケープします.
+ */
+std::string EscapeJson(const char* str) {
+  std::string escaped;
+  for (const char* p = str; *p != '\0'; ++p) {
+    if (*p == '"' || *p == '\\') {
+      escaped += '\\';
+      escaped += *p;
+    } else if (static_cast<unsigned char>(*p) < 0x20) {
+      escaped += ' ';
+    } else {
+      escaped += *p;
+    }
+  }
+  return escaped;
+}
+
+} // namespace
+
+std::atomic_bool Tracer::enabled_{false};
+
+void Tracer::SetThreadName(const char* name, int id) {
+  RingBuffer* buffer = GetThreadLocalBuffer();
+  std::lock_guard<std::mutex> lock(g_buffers_mutex);
+  buffer->thread_name = id >= 0 ? std::string(name) + " " + std::to_string(id)
+                                : std::string(name);
+}
+
+void Tracer::Record(char phase, const char* name, int64_t value,
+                    const char* detail) {
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+
+  RingBuffer* buffer = GetThreadLocalBuffer();
+  uint64_t index = buffer->num_written.load(std::memory_order_relaxed);
+  Event& event = buffer->events[index % kBufferSize];
+  auto elapsed = std::chrono::steady_clock::now() - g_start_time;
+  event.timestamp = duration_cast<microseconds>(elapsed).count();
+  event.value = value;
+  event.name = name;
+  event.phase = phase;
+  if (detail != nullptr) {
+    std::strncpy(event.detail, detail, kDetailLength - 1);
+    event.detail[kDetailLength - 1] = '\0';
+  } else {
+    event.detail[0] = '\0';
+  }
+  buffer->num_written.store(index + 1, std::memory_order_release);
+}
+
+void Tracer::Clear() {
+  std::lock_guard<std::mutex> lock(g_buffers_mutex);
+  for (std::unique_ptr<RingBuffer>& buffer : g_buffers) {
+    buffer->num_written.store(0, std::memory_order_release);
+  }
+}
+
+bool Tracer::DumpToFile(const char* file_name) {
+  std::FILE* file = std::fopen(file_name, "w");
+  if (file == nullptr) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(g_buffers_mutex);
+  std::fprintf(file, "{\"traceEvents\":[\n");
+  bool first = true;
+  for (const std::unique_ptr<RingBuffer>& buffer : g_buffers) {
+    const int tid = buffer->thread_id;
+
+    // スレッド名をメタデータとして出力する
+    if (!buffer->thread_name.empty()) {
+      std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                   "\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                   first ? "" : ",\n", tid,
+                   EscapeJson(buffer->thread_name.c_str()).c_str());
+      first = false;
+    }
+
+    // リングバッファに残っているイベントを、古い順に出力する
+    const uint64_t end = buffer->num_written.load(std::memory_order_acquire);
+    const uint64_t begin = end > kBufferSize ? end - kBufferSize : 0;
+    for (uint64_t i = begin; i < end; ++i) {
+      const Event& event = buffer->events[i % kBufferSize];
+      std::fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%" PRId64 ","
+                   "\"pid\":1,\"tid\":%d,",
+                   first ? "" : ",\n", EscapeJson(event.name).c_str(),
+                   event.phase, event.timestamp, tid);
+      if (event.phase == 'i') {
+        std::fprintf(file, "\"s\":\"t\",");
+      }
+      std::fprintf(file, "\"args\":{\"value\":%" PRId64 ",\"detail\":\"%s\"}}",
+                   event.value, EscapeJson(event.detail).c_str());
+      first = false;
+    }
+  }
+  std::fprintf(file, "\n]}\n");
+  std::fclose(file);
+  return true;
+}
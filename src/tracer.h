@@ -0,0 +1,146 @@
+/*
+ * 技巧 (Gikou), a USI shogi (Japanese chess) playing engine.
+ * Copyright (C) 2016-2017 Yosuke Demura
+ * except where otherwise indicated.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRACER_H_
+#define TRACER_H_
+
+#include <cstdint>
+#include <atomic>
+
+/**
+ * スレッドごとのリングバッファにイベントを記録する、軽量なトレーサーです.
+ *
+ * 記録されたイベントは、Chrome（chrome://tracing）やPerfettoで表示可能なJSON形式で
+ * ファイルに書き出すことができます。
+ * 記録時はロックを取らず、呼び出し元のスレッド専用のバッファに書き込むだけです。
+ * また、トレースが無効になっているときは、atomic変数を１つ読むだけで処理を終えます。
+ *
+ * 使用例：
+ * @code
+ * Tracer::set_enabled(true);
+ * {
+ *   Tracer::Scope scope("iteration", depth); // スコープを抜けるまでの区間が記録される
+ *   // 何らかの処理....
+ * }
+ * Tracer::Instant("stop");
+ * Tracer::DumpToFile("trace.json");
+ * @endcode
+ *
+ * 注意：イベント名には、文字列リテラルのように、プログラム終了まで有効な文字列を渡してください。
+ */
+class Tracer {
+ public:
+  /**
+   * 各スレッドのリングバッファに保存できるイベントの数です.
+   * これを超えた場合は、古いイベントから上書きされます。
+   */
+  static constexpr uint32_t kBufferSize = 1 << 14;
+
+  /**
+   * イベントに付加できる文字列の最大長（終端文字を含む）です.
+   */
+  static constexpr int kDetailLength = 24;
+
+  /**
+   * トレースを有効にするか否かを設定します.
+   */
+  static void set_enabled(bool enabled) {
+    enabled_.store(enabled, std::memory_order_relaxed);
+  }
+
+  static bool enabled() {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * 呼び出し元のスレッドの名前を設定します（トレースの表示に使われます）.
+   */
+  static void SetThreadName(const char* name, int id = -1);
+
+  /**
+   * 区間の開始を記録します.
+   */
+  static void Begin(const char* name, int64_t value = 0) {
+    if (enabled()) {
+      Record('B', name, value, nullptr);
+    }
+  }
+
+  /**
+   * 区間の終了を記録します.
+   */
+  static void End(const char* name, int64_t value = 0) {
+    if (enabled()) {
+      Record('E', name, value, nullptr);
+    }
+  }
+
+  /**
+   * 一瞬のイベントを記録します.
+   * @param detail イベントに付加する文字列（kDetailLength - 1 文字を超えた部分は切り捨てられる）
+   */
+  static void Instant(const char* name, int64_t value = 0,
+                      const char* detail = nullptr) {
+    if (enabled()) {
+      Record('i', name, value, detail);
+    }
+  }
+
+  /**
+   * 記録されたイベントを、すべて消去します.
+   * 注意：他のスレッドがイベントを記録していないときに呼んでください。
+   */
+  static void Clear();
+
+  /**
+   * 記録されたイベントを、Chrome Trace Event形式のJSONファイルに書き出します.
+   * 注意：他のスレッドがイベントを記録していないときに呼んでください。
+   * @return 書き出しに成功した場合は、true
+   */
+  static bool DumpToFile(const char* file_name);
+
+  /**
+   * コンストラクタからデストラクタまでを１つの区間として記録するためのクラスです.
+   */
+  class Scope {
+   public:
+    explicit Scope(const char* name, int64_t value = 0)
+        : name_(enabled() ? name : nullptr) {
+      if (name_ != nullptr) {
+        Record('B', name_, value, nullptr);
+      }
+    }
+    ~Scope() {
+      if (name_ != nullptr) {
+        Record('E', name_, 0, nullptr);
+      }
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+   private:
+    const char* const name_;
+  };
+
+ private:
+  static void Record(char phase, const char* name, int64_t value,
+                     const char* detail);
+  static std::atomic_bool enabled_;
+};
+
+#endif /* TRACER_H_ */
@@ -28,11 +28,18 @@
 #include <sstream>
 #include <thread>
 #include <vector>
+#include "evaluation.h"
+#include "large_page.h"
+#include "material.h"
+#include "memory_report.h"
+#include "move_probability.h"
 #include "movegen.h"
 #include "node.h"
+#include "numa.h"
 #include "search.h"
 #include "synced_printf.h"
 #include "thinking.h"
+#include "tracer.h"
 #include "usi_protocol.h"
 
 namespace {
@@ -92,6 +99,12 @@ void ReceiveCommands(CommandQueue* const queue, Thinking* const thinking) {
       command = "quit";
     }
 
+    // コマンドの受信時刻をトレースに記録する
+    if (Tracer::enabled()) {
+      Tracer::SetThreadName("usi receiver");
+      Tracer::Instant("usi receive", 0, command.c_str());
+    }
+
     std::istringstream is(command);
     std::string type;
     is >> type;
@@ -218,6 +231,26 @@ void ExecuteCommand(const std::string& command, Node* const node,
   } else if (type == "isready") {
     thinking->Initialize();
     Evaluation::ReadParametersFromFile("params.bin");
+    const std::string& ensemble_params = (*usi_options)["EnsembleParams"].string();
+    if (!ensemble_params.empty()) {
+      EvalEnsembleWeights weights;
+      weights.opening_component = (*usi_options)["EnsembleOpeningComponentWeight"];
+      weights.middle_game_component = (*usi_options)["EnsembleMiddleGameComponentWeight"];
+      weights.end_game_component = (*usi_options)["EnsembleEndGameComponentWeight"];
+      if (Evaluation::BlendParametersFromFile(ensemble_params.c_str(), weights)) {
+        SYNCED_PRINTF("info string Blended %s into params.bin (%d%%/%d%%/%d%%).\n",
+                      ensemble_params.c_str(), weights.opening_component,
+                      weights.middle_game_component, weights.end_game_component);
+      }
+    }
+    Material::UpdateTables();
+    // 評価パラメータ等の読み込みが終わってから、NUMAノードごとに複製する
+    const bool numa_replication = (*usi_options)["NumaReplication"];
+    Numa::Configure(numa_replication, numa_replication);
+    MemoryReport memory_report;
+    thinking->ReportMemoryUsage(&memory_report);
+    memory_report.Print("info string ");
+    LargePageAllocator::Print("info string ");
     SYNCED_PRINTF("readyok\n");
 
   } else if (type == "setoption") {
@@ -249,6 +282,26 @@ void ExecuteCommand(const std::string& command, Node* const node,
       sfen_moves += ext_move.move.ToSfen() + " ";
     }
     SYNCED_PRINTF("%s\n", sfen_moves.c_str());
+
+  } else if (type == "trace") {
+    // イベントトレースの操作（trace on / trace off / trace clear / trace dump [ファイル名]）
+    std::string operation, file_name = "trace.json";
+    is >> operation >> file_name;
+    if (operation == "on") {
+      Tracer::set_enabled(true);
+    } else if (operation == "off") {
+      Tracer::set_enabled(false);
+    } else if (operation == "clear") {
+      Tracer::Clear();
+    } else if (operation == "dump") {
+      if (Tracer::DumpToFile(file_name.c_str())) {
+        SYNCED_PRINTF("info string Trace is written to %s.\n", file_name.c_str());
+      } else {
+        SYNCED_PRINTF("info string Failed to open %s.\n", file_name.c_str());
+      }
+    } else {
+      SYNCED_PRINTF("info string Unsupported Trace Operation: %s\n", operation.c_str());
+    }
 #endif
 
   } else {
@@ -303,6 +356,27 @@ UsiOptions::UsiOptions() {
   // 探索に用いるスレッド数
   map_.emplace("Threads", UsiOption(std::thread::hardware_concurrency(), 1, kMaxSearchThreads));
 
+  // 探索スレッドをNUMAノードに固定し、評価パラメータと実現確率の重みをノードごとに複製する場合はtrue
+  map_.emplace("NumaReplication", UsiOption(false));
+
+  // プロセス内合議に参加する投票者の数（２以上の場合、各投票者がThreadsの数だけスレッドを使って探索する）
+  map_.emplace("ConsultationVoters", UsiOption(1, 1, 16));
+
+  // プロセス内合議の各投票者が用いる評価関数のパラメータファイル（セミコロン区切り。空欄の場合はparams.bin）
+  map_.emplace("ConsultationParams", UsiOption(""));
+
+  // 評価パラメータに混合する、２つ目の評価パラメータのファイル（空欄の場合は、混合しない）
+  map_.emplace("EnsembleParams", UsiOption(""));
+
+  // ２つ目の評価パラメータを混合する比率（評価パラメータの序盤・中盤・終盤の成分ごと。単位はパーセント）
+  // 成分ごとに混合するので、進行度に応じて評価値を混合するのとは異なる。中盤の比率は、KP・手番・駒割りにのみ用いられる
+  map_.emplace("EnsembleOpeningComponentWeight", UsiOption(50, 0, 100));
+  map_.emplace("EnsembleMiddleGameComponentWeight", UsiOption(50, 0, 100));
+  map_.emplace("EnsembleEndGameComponentWeight", UsiOption(50, 0, 100));
+
+  // 実現確率のキャッシュテーブルの、１スレッドあたりの要素数（２の累乗に切り下げられる）
+  map_.emplace("ProbabilityCacheSize", UsiOption(int(ProbabilityCacheTable::kDefaultSize), 1024, 1 << 20));
+
   // USI出力するPVの数
   map_.emplace("MultiPV", UsiOption(1, 1, Move::kMaxLegalMoves));
 
@@ -330,6 +404,9 @@ UsiOptions::UsiOptions() {
   // 定跡を用いる最大手数
   map_.emplace("BookMaxPly", UsiOption(20, 0, 50));
 
+  // 定跡を外れた後の探索中にも、浅い局面で定跡DBの評価値が最も高い手を最初に調べるか否か
+  map_.emplace("BookInSearch", UsiOption(false));
+
 #if 0
   // 定跡手の評価値のしきい値（先手番）（先手番側から見た評価値がこの値未満の定跡手は選択しない）
   map_.emplace("MinBookScoreForBlack", UsiOption(-300, -500, 500));